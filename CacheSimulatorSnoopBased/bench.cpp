@@ -0,0 +1,343 @@
+// Microbenchmarks for the simulator core
+//
+// Usage: bench [--filter SUBSTRING] [--min-time SECONDS] [--out FILE]
+// Results are written as JSON (to stdout, or to FILE) in the layout used by
+// Google Benchmark, so the same tooling can compare runs of different versions.
+// A one line summary per benchmark goes to stderr.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ctime>
+#include <unistd.h>
+#include "cacheset.h"
+#include "config.h"
+#include "protocol.h"
+#include "simulator.h"
+#include "trace.h"
+#include "workload.h"
+using namespace std;
+
+// Keeps results alive so the compiler cannot drop the measured work
+static volatile unsigned long long sink;
+
+// Passed to a benchmark: it runs its loop iterations times and reports the items processed
+// Setup done before startTiming is not measured
+class BenchState {
+	public:
+		unsigned long long iterations;
+		unsigned long long items;
+		chrono::steady_clock::time_point start;
+
+		BenchState(unsigned long long _iterations) {
+			iterations = _iterations;
+			items = 0;
+			start = chrono::steady_clock::now();
+		}
+
+		void startTiming() {
+			start = chrono::steady_clock::now();
+		}
+};
+
+typedef void (*BenchFunction)(BenchState& state);
+
+class Benchmark {
+	public:
+		string name;
+		BenchFunction function;
+};
+
+class BenchResult {
+	public:
+		string name;
+		unsigned long long iterations;
+		double seconds;
+		double items_per_second;
+};
+
+// Synthetic accesses with a controlled mix, from the uniform workload
+// Each core has a private working set; a shared_ratio fraction of accesses go to a
+// working set shared by all cores instead, and a write_ratio fraction are writes
+static vector<TraceRecord> syntheticTrace(unsigned long long length, int cores, unsigned long long working_set_blocks, double shared_ratio, double write_ratio, int block_size) {
+	WorkloadSpec spec;
+	spec.pattern = WorkloadPattern::Uniform;
+	spec.accesses = length;
+	spec.seed = 12345;
+	spec.cores = cores;
+	spec.block_size = block_size;
+	spec.working_set = working_set_blocks;
+	spec.shared_ratio = shared_ratio;
+	spec.write_ratio = write_ratio;
+	vector<TraceRecord> trace(length);
+	WorkloadGenerator generator(spec);
+	generator.fill(trace.data(), trace.size());
+	return trace;
+}
+
+// CacheSet kernels on a single 8-way set
+
+// Tags cycle through twice the associativity, so half the lookups miss
+static void BM_CacheSet_lookup(BenchState& state) {
+	const int ways = 8;
+	unsigned long long tags[ways];
+	CacheBlockState states[ways];
+	unsigned char ranks[ways];
+	CacheSet set(tags, states, ranks, ways);
+	for (int i=0; i < ways; i++) {
+		set.insertCacheBlock(CacheBlock(i, CacheBlockState::Shared));
+	}
+	state.startTiming();
+	unsigned long long hits = 0;
+	for (unsigned long long i=0; i < state.iterations; i++) {
+		hits += set.getState(i & (2 * ways - 1)) != CacheBlockState::Invalid;
+	}
+	sink = hits;
+	state.items = state.iterations;
+}
+
+static void BM_CacheSet_insert(BenchState& state) {
+	const int ways = 8;
+	unsigned long long tags[ways];
+	CacheBlockState states[ways];
+	unsigned char ranks[ways];
+	CacheSet set(tags, states, ranks, ways);
+	state.startTiming();
+	unsigned long long evicted = 0;
+	for (unsigned long long i=0; i < state.iterations; i++) {
+		evicted += set.insertCacheBlock(CacheBlock(i, CacheBlockState::Shared)).tag;
+	}
+	sink = evicted;
+	state.items = state.iterations;
+}
+
+static void BM_CacheSet_moveToMRU(BenchState& state) {
+	const int ways = 8;
+	unsigned long long tags[ways];
+	CacheBlockState states[ways];
+	unsigned char ranks[ways];
+	CacheSet set(tags, states, ranks, ways);
+	for (int i=0; i < ways; i++) {
+		set.insertCacheBlock(CacheBlock(i, CacheBlockState::Shared));
+	}
+	state.startTiming();
+	for (unsigned long long i=0; i < state.iterations; i++) {
+		set.moveToMRU(i % ways);
+	}
+	sink = ranks[0];
+	state.items = state.iterations;
+}
+
+// Bus fan-out: a BusRd for a block that no cache holds, as seen on every cold miss
+static void busFanout(BenchState& state, int cores, bool snoop_filter) {
+	SimConfig config;
+	config.cores = cores;
+	config.snoop_filter = snoop_filter;
+	Simulator sim(Protocol::MESI, config.geometry, config);
+	state.startTiming();
+	for (unsigned long long i=0; i < state.iterations; i++) {
+		sim.bus->sendMessage(BusRequest::BusRd, i, 0);
+	}
+	sink = sim.bus->num_busrd;
+	state.items = state.iterations;
+}
+
+static void BM_Bus_sendMessage_16cores(BenchState& state) {
+	busFanout(state, 16, false);
+}
+
+static void BM_Bus_sendMessage_64cores(BenchState& state) {
+	busFanout(state, 64, false);
+}
+
+static void BM_Bus_sendMessage_64cores_snoopfilter(BenchState& state) {
+	busFanout(state, 64, true);
+}
+
+// End to end: handleProcRequest over a synthetic trace on a 16 core system with
+// 64 sets x 8 ways; the trace is replayed as many times as needed
+static void endToEnd(BenchState& state, Protocol protocol, double shared_ratio, double write_ratio, unsigned long long working_set_blocks) {
+	SimConfig config;
+	config.geometry = CacheGeometry(6, 8, DEFAULT_CACHE_OFFSET_BITS);
+	vector<TraceRecord> trace = syntheticTrace(1 << 16, config.cores, working_set_blocks, shared_ratio, write_ratio, config.geometry.blockSize());
+	Simulator sim(protocol, config.geometry, config);
+	state.startTiming();
+	size_t next = 0;
+	for (unsigned long long i=0; i < state.iterations; i++) {
+		const TraceRecord& record = trace[next];
+		sim.access(record.core, (ProcRequest) record.op, record.address);
+		if (++next == trace.size()) {
+			next = 0;
+		}
+	}
+	sink = sim.totalStats(CacheStats::Reads);
+	state.items = state.iterations;
+}
+
+// One end to end benchmark per protocol and workload mix
+#define END_TO_END(protocol, mix, shared, write, blocks) \
+	static void BM_EndToEnd_##protocol##_##mix(BenchState& state) { \
+		endToEnd(state, Protocol::protocol, shared, write, blocks); \
+	}
+#define END_TO_END_MIXES(protocol) \
+	END_TO_END(protocol, private_fits, 0.05, 0.3, 256) \
+	END_TO_END(protocol, shared_readmostly, 0.5, 0.05, 256) \
+	END_TO_END(protocol, shared_writeheavy, 0.5, 0.5, 256) \
+	END_TO_END(protocol, private_thrashing, 0.05, 0.3, 4096)
+
+END_TO_END_MIXES(MSI)
+END_TO_END_MIXES(MESI)
+END_TO_END_MIXES(MESIF)
+END_TO_END_MIXES(MOESI)
+END_TO_END_MIXES(FESI)
+
+// Generation rate of a workload pattern, without simulating the accesses
+static void workloadGeneration(BenchState& state, WorkloadPattern pattern) {
+	WorkloadSpec spec;
+	spec.pattern = pattern;
+	spec.accesses = state.iterations;
+	spec.cores = 16;
+	spec.working_set = 1 << 16;
+	WorkloadGenerator generator(spec);
+	vector<TraceRecord> batch(1024);
+	state.startTiming();
+	unsigned long long addresses = 0;
+	size_t count;
+	while ((count = generator.fill(batch.data(), batch.size())) > 0) {
+		addresses += batch[count - 1].address;
+	}
+	sink = addresses;
+	state.items = state.iterations;
+}
+
+static void BM_Workload_uniform(BenchState& state) {
+	workloadGeneration(state, WorkloadPattern::Uniform);
+}
+
+static void BM_Workload_zipfian(BenchState& state) {
+	workloadGeneration(state, WorkloadPattern::Zipfian);
+}
+
+#define REGISTER(function) {#function, function}
+#define REGISTER_MIXES(protocol) \
+	REGISTER(BM_EndToEnd_##protocol##_private_fits), \
+	REGISTER(BM_EndToEnd_##protocol##_shared_readmostly), \
+	REGISTER(BM_EndToEnd_##protocol##_shared_writeheavy), \
+	REGISTER(BM_EndToEnd_##protocol##_private_thrashing)
+
+static const Benchmark benchmarks[] = {
+	REGISTER(BM_CacheSet_lookup),
+	REGISTER(BM_CacheSet_insert),
+	REGISTER(BM_CacheSet_moveToMRU),
+	REGISTER(BM_Bus_sendMessage_16cores),
+	REGISTER(BM_Bus_sendMessage_64cores),
+	REGISTER(BM_Bus_sendMessage_64cores_snoopfilter),
+	REGISTER(BM_Workload_uniform),
+	REGISTER(BM_Workload_zipfian),
+	REGISTER_MIXES(MSI),
+	REGISTER_MIXES(MESI),
+	REGISTER_MIXES(MESIF),
+	REGISTER_MIXES(MOESI),
+	REGISTER_MIXES(FESI)
+};
+
+// Runs the benchmark with a growing number of iterations until it takes min_time
+static BenchResult runBenchmark(const Benchmark& benchmark, double min_time) {
+	unsigned long long iterations = 1000;
+	while (true) {
+		BenchState state(iterations);
+		benchmark.function(state);
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - state.start).count();
+		if (seconds >= min_time || iterations >= (1ULL << 40)) {
+			BenchResult result;
+			result.name = benchmark.name;
+			result.iterations = iterations;
+			result.seconds = seconds;
+			result.items_per_second = state.items / seconds;
+			return result;
+		}
+		// Aim a little past min_time, growing at most 10x per round
+		double scale = (seconds > 0) ? 1.4 * min_time / seconds : 10.0;
+		if (scale > 10.0) {
+			scale = 10.0;
+		}
+		if (scale < 2.0) {
+			scale = 2.0;
+		}
+		iterations = iterations * scale;
+	}
+}
+
+static void writeJson(ostream& out, const vector<BenchResult>& results) {
+	char host[256] = "";
+	gethostname(host, sizeof(host) - 1);
+	time_t now = time(NULL);
+	char date[64];
+	strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+	out << "{\n";
+	out << "  \"context\": {\n";
+	out << "    \"date\": \"" << date << "\",\n";
+	out << "    \"host_name\": \"" << host << "\",\n";
+	out << "    \"executable\": \"bench\",\n";
+	out << "    \"num_cpus\": " << sysconf(_SC_NPROCESSORS_ONLN) << "\n";
+	out << "  },\n";
+	out << "  \"benchmarks\": [\n";
+	for (size_t i=0; i < results.size(); i++) {
+		const BenchResult& result = results[i];
+		double ns_per_iteration = 1e9 * result.seconds / result.iterations;
+		out << "    {\n";
+		out << "      \"name\": \"" << result.name << "\",\n";
+		out << "      \"run_type\": \"iteration\",\n";
+		out << "      \"iterations\": " << result.iterations << ",\n";
+		out << "      \"real_time\": " << setprecision(6) << ns_per_iteration << ",\n";
+		out << "      \"cpu_time\": " << ns_per_iteration << ",\n";
+		out << "      \"time_unit\": \"ns\",\n";
+		out << "      \"items_per_second\": " << setprecision(10) << result.items_per_second << "\n";
+		out << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ]\n";
+	out << "}\n";
+}
+
+int main(int argc, char* argv[]) {
+	string filter;
+	string out_path;
+	double min_time = 0.5;
+	for (int i=1; i < argc; i++) {
+		string arg = argv[i];
+		if (arg == "--filter" && i + 1 < argc) {
+			filter = argv[++i];
+		} else if (arg == "--min-time" && i + 1 < argc) {
+			min_time = atof(argv[++i]);
+		} else if (arg == "--out" && i + 1 < argc) {
+			out_path = argv[++i];
+		} else {
+			cerr << "Usage: " << argv[0] << " [--filter SUBSTRING] [--min-time SECONDS] [--out FILE]" << endl;
+			return 1;
+		}
+	}
+
+	vector<BenchResult> results;
+	for (size_t i=0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+		if (benchmarks[i].name.find(filter) == string::npos) {
+			continue;
+		}
+		BenchResult result = runBenchmark(benchmarks[i], min_time);
+		cerr << left << setw(48) << result.name << right << setw(14) << fixed << setprecision(1)
+			<< result.items_per_second / 1e6 << " M accesses/s" << endl;
+		results.push_back(result);
+	}
+
+	if (out_path.empty()) {
+		writeJson(cout, results);
+	} else {
+		ofstream out(out_path);
+		writeJson(out, results);
+	}
+	return 0;
+}
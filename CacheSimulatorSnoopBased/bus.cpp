@@ -1,13 +1,35 @@
 #include <iostream>
+#include <iomanip>
 #include <vector>
+#include <algorithm>
 #include "bus.h"
 #include "cache.h"
+#include "stats.h"
 
-Bus::Bus(std::vector<Cache*>& _caches) {
-	caches = _caches;
-
+BusBank::BusBank() {
 	shared_line = false;
 	supplied = false;
+	num_busrd = 0;
+	num_busrdx = 0;
+	num_flushes = 0;
+	num_flush_primes = 0;
+	num_busupgr = 0;
+	num_setF = 0;
+	num_shared = 0;
+}
+
+unsigned long long BusBank::load() {
+	return num_busrd + num_busrdx + num_flushes + num_flush_primes + num_busupgr + num_setF;
+}
+
+Bus::Bus(std::vector<Cache*>& _caches, int num_banks) {
+	caches = _caches;
+
+	banks.resize(num_banks);
+	bank_mask = num_banks - 1;
+	snoop_filter = NULL;
+	llc = NULL;
+	outcome.reset();
 
 	num_busrd = 0;
 	num_busrdx = 0;
@@ -17,58 +39,99 @@ Bus::Bus(std::vector<Cache*>& _caches) {
 	num_setF = 0;
 }
 
-bool Bus::getSharedLine(){
-	return shared_line;
+bool Bus::getSharedLine(unsigned long long block_address){
+	return banks[bankIndex(block_address)].shared_line;
+}
+
+void Bus::setSharedLine(unsigned long long block_address){
+	BusBank& bank = banks[bankIndex(block_address)];
+	bank.shared_line = true;
+	bank.num_shared++;
 }
 
-void Bus::setSharedLine(){
-	shared_line = true;
+bool Bus::getSupplied(unsigned long long block_address){
+	return banks[bankIndex(block_address)].supplied;
 }
 
-bool Bus::getSupplied(){
-	return supplied;
+void Bus::setSupplied(unsigned long long block_address){
+	banks[bankIndex(block_address)].supplied = true;
 }
 
-void Bus::setSupplied(){
-	supplied = true;
+void Bus::setSnoopFilter(SnoopFilter* _snoop_filter) {
+	snoop_filter = _snoop_filter;
+	sharers.resize(snoop_filter->words);
 }
 
 void Bus::sendMessage(BusRequest request, unsigned long long block_address, int sender_cache_id) {
 	// This function invokes handleBusRequest with the given request on
 	// all core's caches except the one that sent the request
+	BusBank& bank = banks[bankIndex(block_address)];
 
 	switch (request) {
 		case BusRequest::BusRd:
 			num_busrd++;
+			bank.num_busrd++;
 			break;
 		case BusRequest::BusRdX:
 			num_busrdx++;
+			bank.num_busrdx++;
 			break;
 		case BusRequest::Flush:
 			num_flushes++;
+			bank.num_flushes++;
 			break;
 		case BusRequest::Flush_prime:
 			num_flush_primes++;
+			bank.num_flush_primes++;
 			break;
 		case BusRequest::BusUpgr:
 			num_busupgr++;
+			bank.num_busupgr++;
 			break;
 		case BusRequest::setF:
 			num_setF++;
+			bank.num_setF++;
 			break;
 	}
+	if (request == BusRequest::Flush && llc != NULL) {
+		llc->writeback(block_address);
+	}
 	if (request == BusRequest::Flush || request == BusRequest::Flush_prime) {
-		// We just simulate writing back to memory
+		// Without an LLC model, we just simulate writing back to memory
 		// Since cache to cache sharing is disabled, there is no need to invoke 
 		// handleBusRequest for a Flush request
 		return;
 	}
 
 	// Unset shared and supplied line before sending Bus request to all other cores
-	shared_line = false;
-	supplied = false;
+	bank.shared_line = false;
+	bank.supplied = false;
 	// forwarded_line = -1; NO LONGER USED
 
+	if (snoop_filter != NULL) {
+		// Caches that do not hold the block ignore every request, so only the holders are snooped,
+		// in the same (ascending id) order as the full broadcast.
+		// The mask is copied first because the snooped caches update the filter as they change state;
+		// snoops only ever send Flush or Flush_prime, which return above, so the copy is not reentered.
+		int visited = 0;
+		if (snoop_filter->getSharers(block_address, sharers.data())) {
+			for (int w=0; w < snoop_filter->words; w++) {
+				uint64_t bits = sharers[w];
+				while (bits != 0) {
+					int i = w * 64 + __builtin_ctzll(bits);
+					bits &= bits - 1;
+					if (i != sender_cache_id) {
+						caches[i]->handleBusRequest(request, block_address);
+						visited++;
+					}
+				}
+			}
+		}
+		snoop_filter->num_snoops_sent += visited;
+		snoop_filter->num_snoops_filtered += caches.size() - 1 - visited;
+		return;
+	}
+
 	for (int i=0; i<caches.size(); i++) {
 		if (caches[i]->getId() != sender_cache_id) {
 			caches[i]->handleBusRequest(request, block_address);
@@ -77,11 +140,54 @@ void Bus::sendMessage(BusRequest request, unsigned long long block_address, int
 }
 
 void Bus::printStats() {
-	std::cout << ">> Bus stats" << std::endl;
-	std::cout << "Number of BusRd        : " << num_busrd << std::endl;
-	std::cout << "Number of BusRdX       : " << num_busrdx << std::endl;
-	std::cout << "Number of BusUpgr      : " << num_busupgr << std::endl;
-	std::cout << "Number of Flushes      : " << num_flushes << std::endl;
-	std::cout << "Number of Flush Primes : " << num_flush_primes << std::endl;
-	std::cout << "Number of setF         : " << num_setF << std::endl;
+	std::cout << ">> Bus stats\n";
+	std::cout << "Number of BusRd        : " << num_busrd << '\n';
+	std::cout << "Number of BusRdX       : " << num_busrdx << '\n';
+	std::cout << "Number of BusUpgr      : " << num_busupgr << '\n';
+	std::cout << "Number of Flushes      : " << num_flushes << '\n';
+	std::cout << "Number of Flush Primes : " << num_flush_primes << '\n';
+	std::cout << "Number of setF         : " << num_setF << '\n';
+}
+
+void Bus::printBankStats() {
+	unsigned long long total = 0, busiest = 0;
+	for (size_t i=0; i < banks.size(); i++) {
+		total += banks[i].load();
+		busiest = std::max(busiest, banks[i].load());
+	}
+	double mean = (double) total / banks.size();
+	std::cout << std::dec << std::fixed << std::setprecision(2);
+	std::cout << ">> Bus bank stats (" << banks.size() << " banks)\n";
+	for (size_t i=0; i < banks.size(); i++) {
+		const BusBank& bank = banks[i];
+		std::cout << "Bank " << std::setw(4) << std::left << i << std::right << ": "
+			<< "BusRd " << bank.num_busrd << ", BusRdX " << bank.num_busrdx << ", BusUpgr " << bank.num_busupgr
+			<< ", Flush " << bank.num_flushes << ", Flush Prime " << bank.num_flush_primes << ", setF " << bank.num_setF
+			<< ", shared line raised " << bank.num_shared << '\n';
+	}
+	std::cout << "Busiest bank load  : " << busiest << " messages, mean " << mean << '\n';
+	std::cout << "Load imbalance     : " << (mean > 0 ? busiest / mean : 0.0) << " (busiest / mean)\n";
+}
+
+void Bus::registerStats(StatsRegistry& stats) {
+	stats.add("bus", "busrd", &num_busrd);
+	stats.add("bus", "busrdx", &num_busrdx);
+	stats.add("bus", "busupgr", &num_busupgr);
+	stats.add("bus", "flushes", &num_flushes);
+	stats.add("bus", "flush_primes", &num_flush_primes);
+	stats.add("bus", "setf", &num_setF);
+	if (banks.size() == 1) {
+		return;
+	}
+	for (size_t i=0; i < banks.size(); i++) {
+		std::string group = "bus_bank" + std::to_string(i);
+		BusBank& bank = banks[i];
+		stats.add(group, "busrd", &bank.num_busrd);
+		stats.add(group, "busrdx", &bank.num_busrdx);
+		stats.add(group, "busupgr", &bank.num_busupgr);
+		stats.add(group, "flushes", &bank.num_flushes);
+		stats.add(group, "flush_primes", &bank.num_flush_primes);
+		stats.add(group, "setf", &bank.num_setF);
+		stats.add(group, "shared", &bank.num_shared);
+	}
 }
@@ -1,34 +1,90 @@
 #pragma once
 #include <vector>
 #include "cache.h"
+#include "snoopfilter.h"
+#include "latency.h"
+#include "llc.h"
 
-class Bus {
+// Most banks the bus can be split into
+#define MAX_BUS_BANKS 1024
+
+// One address-interleaved slice of the bus, with its own shared and supplied lines
+// A transaction only involves the bank its block address hashes to
+class BusBank {
 	public:
-		std::vector<Cache*> caches;
 		bool shared_line;
 		bool supplied;
 
-		// Counters for different request types
-		int num_busrd, num_busrdx, num_flushes, num_flush_primes, num_busupgr, num_setF;
+		// Counters for different request types, and for raises of the shared line
+		unsigned long long num_busrd, num_busrdx, num_flushes, num_flush_primes, num_busupgr, num_setF, num_shared;
+
+		BusBank();
+
+		// Returns the number of messages the bank carried
+		unsigned long long load();
+};
+
+class Bus {
+	public:
+		std::vector<Cache*> caches;
+
+		// Banks, a power of two of them; block addresses are hashed to a bank with bank_mask
+		std::vector<BusBank> banks;
+		unsigned long long bank_mask;
+
+		// Optional snoop filter; when set only caches holding the block are snooped
+		SnoopFilter* snoop_filter;
+		std::vector<uint64_t> sharers;
+
+		// Optional LLC model; when set, Flush writes back into it
+		LLC* llc;
+
+		// What the processor access being handled did; reset by the cache that handles it
+		AccessOutcome outcome;
+
+		// Counters for different request types, over all banks
+		unsigned long long num_busrd, num_busrdx, num_flushes, num_flush_primes, num_busupgr, num_setF;
 
-		Bus(std::vector<Cache*>& _caches);
+		Bus(std::vector<Cache*>& _caches, int num_banks);
 
-		// Returns the value of the shared line
-		bool getSharedLine();
+		// Returns the bank that carries the transactions for the block
+		int bankIndex(unsigned long long block_address) {
+			return (block_address ^ (block_address >> 16) ^ (block_address >> 32)) & bank_mask;
+		}
 
-		// Sets the value of the shared line to true
-		void setSharedLine();
+		// Returns the value of the shared line of the block's bank
+		bool getSharedLine(unsigned long long block_address);
 
-		// Returns the value whether block has already been supplied (or
-		bool getSupplied();
+		// Sets the value of the shared line of the block's bank to true
+		void setSharedLine(unsigned long long block_address);
+
+		// Returns the value whether block has already been supplied (or allocated)
+		bool getSupplied(unsigned long long block_address);
 
 		// Sets the value whether block has already been supplied (or allocated)
-		void setSupplied();
+		void setSupplied(unsigned long long block_address);
+
+		// Attaches a snoop filter, which must be done before the caches are connected with setBus
+		void setSnoopFilter(SnoopFilter* _snoop_filter);
 
 		// Invokes handleBusRequest on all other caches except the one that sent the request
+		// (with a snoop filter, on the other caches that hold the block)
 		// Flush requests are only counted and will not be forwarded to other caches
 		void sendMessage(BusRequest request, unsigned long long block_address, int sender_cache_id);
 
+		// Functional warming version of sendMessage: the other caches only change state,
+		// and nothing is counted
+		// Instantiated per protocol in coherence.cpp, next to the cache handlers it calls
+		template <Protocol P>
+		void warmMessage(BusRequest request, unsigned long long block_address, int sender_cache_id);
+
 		// Prints the counts
 		void printStats();
+
+		// Prints the load of every bank and how evenly it is spread
+		void printBankStats();
+
+		// Registers the counters under "bus", and those of every bank under "bus_bank<i>"
+		// when there are several
+		void registerStats(StatsRegistry& stats);
 };
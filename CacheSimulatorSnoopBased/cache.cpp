@@ -1,11 +1,35 @@
 #include <iostream>
 #include "cache.h"
+#include "bus.h"
+#include "stats.h"
+#include "l1cache.h"
+#include "prefetcher.h"
 
-Cache::Cache(int _id, Protocol _protocol) {
+Cache::Cache(int _id, Protocol _protocol, CacheGeometry _geometry, ReplacementPolicy _replacement)
+	: Cache(_id, _protocol, _geometry, _replacement, 0, 0) {
+}
+
+Cache::Cache(int _id, Protocol _protocol, CacheGeometry _geometry, ReplacementPolicy _replacement, int _shard_bits, int shard) {
 	id = _id;
 	protocol = _protocol;
-	for (int i=0; i < NUMBER_OF_SETS; i++) {
-		sets.push_back(CacheSet());
+	geometry = _geometry;
+	replacement = _replacement;
+	bus = NULL;
+	snoop_filter = NULL;
+	directory = NULL;
+	l1 = NULL;
+	prefetcher = NULL;
+	bindProtocol();
+
+	shard_bits = _shard_bits;
+	int ways = geometry.associativity;
+	int num_sets = geometry.numSets() >> shard_bits;
+	tag_store.resize(num_sets * ways);
+	state_store.resize(num_sets * ways);
+	repl_store.resize(num_sets * ways);
+	for (int i=0; i < num_sets; i++) {
+		sets.push_back(CacheSet(&tag_store[i * ways], &state_store[i * ways], &repl_store[i * ways], ways, replacement,
+			&replacement_state, (i << shard_bits) + shard));
 	}
 	num_reads = 0;
 	num_read_misses = 0;
@@ -16,10 +40,25 @@ Cache::Cache(int _id, Protocol _protocol) {
 	num_provided = 0;
 	num_fromLLC = 0;
 	num_random = 0;
+	num_cycles = 0;
 }
 
 void Cache::setBus(Bus* _bus) {
 	bus = _bus;
+	snoop_filter = bus->snoop_filter;
+}
+
+void Cache::setDirectory(Directory* _directory) {
+	directory = _directory;
+	proc_handler = &Cache::directoryProcRequest;
+}
+
+void Cache::setL1(L1Cache* _l1) {
+	l1 = _l1;
+	level2_proc_handler = proc_handler;
+	level2_bus_handler = bus_handler;
+	proc_handler = &Cache::hierarchyProcRequest;
+	bus_handler = &Cache::hierarchyBusRequest;
 }
 
 int Cache::getId() {
@@ -31,49 +70,119 @@ Protocol Cache::getProtocol() {
 }
 
 CacheBlockState Cache::getState(unsigned long long block_address) {
-	int set = block_address & ((1 << SET_BITS) - 1);
-	unsigned long long tag = block_address >> SET_BITS;
-	return sets[set].getState(tag);
+	int set = geometry.setIndex(block_address);
+	unsigned long long tag = geometry.tag(block_address);
+	return sets[set >> shard_bits].getState(tag);
 }
 
 void Cache::moveToMRU(unsigned long long block_address) {
-	int set = block_address & ((1 << SET_BITS) - 1);
-	unsigned long long tag = block_address >> SET_BITS;
-	sets[set].moveToMRU(tag);
+	int set = geometry.setIndex(block_address);
+	unsigned long long tag = geometry.tag(block_address);
+	sets[set >> shard_bits].moveToMRU(tag);
 }
 
 CacheBlock Cache::insertCacheBlock(unsigned long long block_address, CacheBlockState state) {
-	int set = block_address & ((1 << SET_BITS) - 1);
-	unsigned long long tag = block_address >> SET_BITS;
-	CacheBlock evicted_block = sets[set].insertCacheBlock(CacheBlock(tag, state));
+	int set = geometry.setIndex(block_address);
+	unsigned long long tag = geometry.tag(block_address);
+	CacheBlock evicted_block = sets[set >> shard_bits].insertCacheBlock(CacheBlock(tag, state));
+	if (snoop_filter != NULL) {
+		if (evicted_block.state != CacheBlockState::Invalid) {
+			snoop_filter->removeSharer(geometry.blockAddress(evicted_block.tag, set), id);
+		}
+		snoop_filter->addSharer(block_address, id);
+	}
+	if (l1 != NULL && evicted_block.state != CacheBlockState::Invalid) {
+		l1->update(geometry.blockAddress(evicted_block.tag, set), CacheBlockState::Invalid);
+	}
+	if (prefetcher != NULL && evicted_block.state != CacheBlockState::Invalid) {
+		prefetcher->removed(geometry.blockAddress(evicted_block.tag, set), false);
+	}
 	return evicted_block;
 }
 
+void Cache::applyState(unsigned long long block_address, CacheBlockState state) {
+	int set = geometry.setIndex(block_address);
+	unsigned long long tag = geometry.tag(block_address);
+	sets[set >> shard_bits].setState(tag, state);
+	if (snoop_filter != NULL && state == CacheBlockState::Invalid) {
+		snoop_filter->removeSharer(block_address, id);
+	}
+	if (l1 != NULL) {
+		l1->update(block_address, state);
+	}
+}
+
 void Cache::setState(unsigned long long block_address, CacheBlockState state) {
-	int set = block_address & ((1 << SET_BITS) - 1);
-	unsigned long long tag = block_address >> SET_BITS;
-	sets[set].setState(tag, state);
-}
-
-void Cache::printStats() {
-	std::cout << ">> Cache " << id << " stats"<< std::endl;
-	std::cout << "Reads           : " << num_reads << std::endl;
-	std::cout << "Read misses     : " << num_read_misses << std::endl;
-	std::cout << "Writes          : " << num_writes << std::endl;
-	std::cout << "Write misses    : " << num_write_misses << std::endl;
-	std::cout << "Writebacks      : " << num_writebacks << std::endl;
-	std::cout << "Invalidations   : " << num_invalidations << std::endl;
-	std::cout << "Provided        : " << num_provided << std::endl;
-	std::cout << "From LLC        : " << num_fromLLC << std::endl;
-	std::cout << "Randomly Chosen : " << num_random << std::endl;
-	std::cout << "Cache blocks present :" << std::endl;
-	for (int set=0; set < NUMBER_OF_SETS; set++) {
+	applyState(block_address, state);
+	// Snoops and the directory invalidate a block for the core that writes it
+	if (prefetcher != NULL && state == CacheBlockState::Invalid) {
+		prefetcher->removed(block_address, true);
+	}
+}
+
+void Cache::backInvalidate(unsigned long long block_address) {
+	applyState(block_address, CacheBlockState::Invalid);
+	// An LLC eviction: the prefetch was useless, but cost no writer an invalidation
+	if (prefetcher != NULL) {
+		prefetcher->removed(block_address, false);
+	}
+}
+
+void Cache::printStats(bool block_dump) {
+	std::cout << ">> Cache " << id << " stats\n";
+	std::cout << "Reads           : " << num_reads << '\n';
+	std::cout << "Read misses     : " << num_read_misses << '\n';
+	std::cout << "Writes          : " << num_writes << '\n';
+	std::cout << "Write misses    : " << num_write_misses << '\n';
+	std::cout << "Writebacks      : " << num_writebacks << '\n';
+	std::cout << "Invalidations   : " << num_invalidations << '\n';
+	std::cout << "Provided        : " << num_provided << '\n';
+	std::cout << "From LLC        : " << num_fromLLC << '\n';
+	std::cout << "Randomly Chosen : " << num_random << '\n';
+	if (l1 != NULL) {
+		l1->printStats();
+	}
+	if (prefetcher != NULL) {
+		prefetcher->printStats();
+	}
+	if (!block_dump) {
+		return;
+	}
+	std::cout << "Cache blocks present :\n";
+	for (int set=0; set < geometry.numSets(); set++) {
 		std::cout << "Set " << set << " => ";
 		sets[set].print();
 	}
 }
 
-int Cache::returnStats(CacheStats stat) {
+void Cache::registerStats(StatsRegistry& stats) {
+	std::string group = "core" + std::to_string(id);
+	stats.add(group, "reads", &num_reads);
+	stats.add(group, "read_misses", &num_read_misses);
+	stats.add(group, "writes", &num_writes);
+	stats.add(group, "write_misses", &num_write_misses);
+	stats.add(group, "writebacks", &num_writebacks);
+	stats.add(group, "invalidations", &num_invalidations);
+	stats.add(group, "provided", &num_provided);
+	stats.add(group, "from_llc", &num_fromLLC);
+	stats.add(group, "random", &num_random);
+	stats.add(group, "cycles", &num_cycles);
+	if (l1 != NULL) {
+		l1->registerStats(stats, group + "_l1");
+	}
+	if (prefetcher != NULL) {
+		prefetcher->registerStats(stats, group + "_prefetch");
+	}
+}
+
+unsigned long long Cache::numAccesses() {
+	if (l1 != NULL) {
+		return l1->num_reads + l1->num_writes;
+	}
+	return num_reads + num_writes;
+}
+
+unsigned long long Cache::returnStats(CacheStats stat) {
 		switch (stat)
 		{
 			case CacheStats::Reads:
@@ -95,6 +204,6 @@ int Cache::returnStats(CacheStats stat) {
 			case CacheStats::Random:
 				return num_random;
 			default:
-				return -1;
+				return 0;
 		}
 }
@@ -1,41 +1,96 @@
 #pragma once
 #include <vector>
-#include <list>
 #include "request.h"
+#include "geometry.h"
 #include "cacheset.h"
 
 class Bus;
-
-#define NUMBER_OF_CORES 16
-#define SET_BITS 2
-#define NUMBER_OF_SETS (1<<SET_BITS)
-#define ASSOCIATIVITY_BITS 2
-#define ASSOCIATIVITY (1<<ASSOCIATIVITY_BITS)
-#define CACHE_OFFSET_BITS 6
-#define CACHE_BLOCK_SIZE (1<<CACHE_OFFSET_BITS)
+class SnoopFilter;
+class StatsRegistry;
+class Directory;
+class L1Cache;
+class Prefetcher;
 
 class Cache {
 	public:
 		// Cache ID, used when sending request on the Bus
 		int id;
 
-		// Protocol used: MSI or MESI
+		// Protocol used: MSI, MESI, MESIF, MOESI or FESI
 		Protocol protocol;
 
-		// CacheSets
+		// Number of sets, associativity and block size
+		CacheGeometry geometry;
+
+		// CacheSets, each pointing into the flat per-way arrays below
+		// A shard of a cache (see runSharded) only holds the sets whose index ends in the
+		// shard number, in its last shard_bits bits: the set index is sets[set >> shard_bits]
 		std::vector<CacheSet> sets;
+		int shard_bits;
+		std::vector<unsigned long long> tag_store;
+		std::vector<CacheBlockState> state_store;
+		std::vector<unsigned char> repl_store;
+
+		// Replacement policy of every set, and the state the sets share
+		ReplacementPolicy replacement;
+		ReplacementState replacement_state;
 
 		// Pointer to the shared Bus
 		Bus* bus;
 
+		// Snoop filter of the Bus, kept up to date on inserts, evictions and invalidations
+		// NULL when the Bus has none
+		SnoopFilter* snoop_filter;
+
+		// Directory backend, which handles the misses and upgrades in place of the Bus
+		// NULL when the caches snoop the Bus
+		Directory* directory;
+
+		// Private L1 in front of this cache, which is then the L2 of its core (see L1Cache)
+		// NULL without one
+		L1Cache* l1;
+
+		// Prefetcher of the core, told when a block leaves the cache (see Prefetcher)
+		// NULL without one
+		Prefetcher* prefetcher;
+
+		// Handlers for the protocol of this cache, chosen once by bindProtocol
+		void (Cache::*proc_handler)(ProcRequest, unsigned long long);
+		void (Cache::*bus_handler)(BusRequest, unsigned long long);
+
+		// Functional warming handler: the same state changes, without counters
+		void (Cache::*warm_proc_handler)(ProcRequest, unsigned long long);
+
+		// Prefetch handler: a read miss with no counters of the cache but the writebacks
+		bool (Cache::*prefetch_handler)(unsigned long long);
+
+		// The handlers of the cache itself, which proc_handler and bus_handler wrap with an L1
+		void (Cache::*level2_proc_handler)(ProcRequest, unsigned long long);
+		void (Cache::*level2_bus_handler)(BusRequest, unsigned long long);
+
 		// Counters
-		int num_reads, num_read_misses, num_writes, num_write_misses, num_writebacks, num_invalidations, num_provided, num_fromLLC, num_random;
+		unsigned long long num_reads, num_read_misses, num_writes, num_write_misses, num_writebacks, num_invalidations, num_provided, num_fromLLC, num_random;
+
+		// Cycles spent on this core's accesses, under the LatencyModel of the Simulator
+		unsigned long long num_cycles;
+
+		Cache(int _id, Protocol protocol, CacheGeometry _geometry, ReplacementPolicy _replacement);
 
-		Cache(int _id, Protocol protocol);
+		// A shard of the cache, with the sets shard, shard + 2^shard_bits, shard + 2 * 2^shard_bits...
+		Cache(int _id, Protocol protocol, CacheGeometry _geometry, ReplacementPolicy _replacement, int _shard_bits, int shard);
 		void setBus(Bus* _bus);
 
+		// Switches the cache to the directory backend (FESI only)
+		void setDirectory(Directory* _directory);
+
+		// Puts an L1 in front of the cache; done last, as it wraps the handlers chosen before
+		void setL1(L1Cache* _l1);
+
+		// Sets proc_handler and bus_handler for the protocol
+		void bindProtocol();
+
 		// Inserts a new block with the block_address in the state that is provided
-		// The new block will be in the MRU position in its set
+		// The new block will be in the MRU position in its set (under LRU)
 		CacheBlock insertCacheBlock(unsigned long long block_address, CacheBlockState state);
 
 		// Returns the state of a cache block
@@ -44,8 +99,15 @@ class Cache {
 
 		// Sets the state of a block with the address block_address to state provided
 		// This WILL NOT move the block to MRU position
+		// Invalid here means that another core took the block (see backInvalidate)
 		void setState(unsigned long long block_address, CacheBlockState state);
 
+		// Invalidates the block because an inclusive LLC evicted it, not for another core
+		void backInvalidate(unsigned long long block_address);
+
+		// What setState and backInvalidate have in common: the block, the snoop filter and the L1
+		void applyState(unsigned long long block_address, CacheBlockState state);
+
 		// Moves the cache block with address block_address to the MRU position in its set
 		void moveToMRU(unsigned long long block_address);
 
@@ -56,15 +118,66 @@ class Cache {
 		Protocol getProtocol();
 
 		// This function will handle the Bus requests to the block_address
-		void handleBusRequest(BusRequest request, unsigned long long block_address);
+		void handleBusRequest(BusRequest request, unsigned long long block_address) {
+			(this->*bus_handler)(request, block_address);
+		}
 
 		// This function will handle the Processor requests to the address
 		// Note that this address include the cache offset
-		void handleProcRequest(ProcRequest request, unsigned long long address);
-
-		// Prints the cache statistics
-		void printStats();
+		void handleProcRequest(ProcRequest request, unsigned long long address) {
+			(this->*proc_handler)(request, address);
+		}
+
+		// Same as handleProcRequest, but only the cache, bus line and LLC state is updated:
+		// no counter, bus statistic or AccessOutcome changes (see Sampler)
+		void handleWarmProcRequest(ProcRequest request, unsigned long long address) {
+			(this->*warm_proc_handler)(request, address);
+		}
+
+		// Reads the block ahead of the processor with BusRd, unless the cache already holds it
+		// Returns true if the prefetch was sent; bus->outcome then tells what it did
+		bool handlePrefetch(unsigned long long block_address) {
+			return (this->*prefetch_handler)(block_address);
+		}
+
+		// Returns true if the processor request has to use the bus: a miss, or a hit that must upgrade
+		bool needsBus(ProcRequest request, unsigned long long address);
+
+		// The request handlers, instantiated per protocol in coherence.cpp
+		template <Protocol P>
+		void busRequest(BusRequest request, unsigned long long block_address);
+		template <Protocol P>
+		void procRequest(ProcRequest request, unsigned long long address);
+		template <Protocol P>
+		void warmBusRequest(BusRequest request, unsigned long long block_address, CacheBlockState state);
+		template <Protocol P>
+		void warmProcRequest(ProcRequest request, unsigned long long address);
+		template <Protocol P>
+		bool prefetchRequest(unsigned long long block_address);
+
+		// The miss path of the handlers above: sends request (BusRd or BusRdX), fills the block
+		// in the state the protocol picks and evicts the victim; Warm uses the warming messages
+		// and counts nothing. Returns whether another cache supplied the block
+		template <Protocol P, bool Warm>
+		bool missRequest(BusRequest request, unsigned long long block_address);
+
+		// The handlers with an L1 in front of the cache, in l1cache.cpp
+		void hierarchyProcRequest(ProcRequest request, unsigned long long address);
+		void hierarchyBusRequest(BusRequest request, unsigned long long block_address);
+
+		// The processor request handler of the directory backend, in directory.cpp
+		void directoryProcRequest(ProcRequest request, unsigned long long address);
+
+		// Prints the cache statistics (and those of the L1), and the blocks of every set if block_dump is set
+		void printStats(bool block_dump);
+
+		// Registers the counters under "core<id>"
+		void registerStats(StatsRegistry& stats);
 
 		// Returns the requested cache statistics
-		int returnStats(CacheStats stat);
+		unsigned long long returnStats(CacheStats stat);
+
+		// Returns the accesses the core made: those to the L1 when there is one, as the
+		// reads and writes of the cache only count the accesses that reached it
+		unsigned long long numAccesses();
 };
@@ -1,68 +1,430 @@
 #include <iostream>
-#include <list>
 #include "cacheset.h"
 #include "cache.h"
 
-CacheBlock::CacheBlock(int _tag, CacheBlockState _state) {
+CacheBlock::CacheBlock(unsigned long long _tag, CacheBlockState _state) {
 	tag = _tag;
 	state = _state;
 }
 
-CacheSet::CacheSet() {
-	for (int i=0; i < ASSOCIATIVITY; i++) {
-		blocks.push_back(CacheBlock(0, CacheBlockState::Invalid));
+CacheSet::CacheSet(unsigned long long* _tags, CacheBlockState* _states, unsigned char* _repl, int _ways)
+	: CacheSet(_tags, _states, _repl, _ways, ReplacementPolicy::LRU, NULL, 0) {
+}
+
+CacheSet::CacheSet(unsigned long long* _tags, CacheBlockState* _states, unsigned char* _repl, int _ways,
+	ReplacementPolicy _policy, ReplacementState* _shared, int set_index) {
+	tags = _tags;
+	states = _states;
+	repl = _repl;
+	ways = _ways;
+	policy = _policy;
+	shared = _shared;
+	role = ReplacementState::roleOf(set_index);
+	for (int w=0; w < MAX_ASSOCIATIVITY / 64; w++) {
+		invalid[w] = 0;
+	}
+	for (int i=0; i < ways; i++) {
+		invalid[i >> 6] |= 1ULL << (i & 63);
+		tags[i] = 0;
+		states[i] = CacheBlockState::Invalid;
+		switch (policy) {
+			case ReplacementPolicy::LRU:
+			case ReplacementPolicy::CoherenceLRU:
+				repl[i] = i;
+				break;
+			case ReplacementPolicy::SRRIP:
+			case ReplacementPolicy::BRRIP:
+			case ReplacementPolicy::DRRIP:
+				repl[i] = RRPV_MAX;
+				break;
+			default:
+				repl[i] = 0;
+		}
 	}
 }
 
-CacheBlockState CacheSet::getState(unsigned long long tag) {
-	for (std::list<CacheBlock>::iterator iter=blocks.begin(); iter != blocks.end() ; iter++) {
-		if (iter->state != CacheBlockState::Invalid && iter->tag == tag) {
-			return iter->state;
+// Lookup and LRU update for a set with a fixed number of ways
+// The common associativities are instantiated so the loops are fully unrolled
+template <int Ways>
+static int findWayFixed(const unsigned long long* tags, const CacheBlockState* states, unsigned long long tag) {
+	int found = -1;
+	for (int way=0; way < Ways; way++) {
+		if (states[way] != CacheBlockState::Invalid && tags[way] == tag) {
+			found = way;
 		}
 	}
-	return CacheBlockState::Invalid;
+	return found;
 }
 
-void CacheSet::moveToMRU(unsigned long long tag) {
-	for (std::list<CacheBlock>::iterator iter=blocks.begin(); iter != blocks.end() ; iter++) {
-		if (iter->state != CacheBlockState::Invalid && iter->tag == tag) {
-			// Move to MRU position
-			CacheBlock cb = *iter;
-			blocks.erase(iter);
-			blocks.push_back(cb);
+template <int Ways>
+static void touchFixed(unsigned char* lru_rank, int way) {
+	unsigned char rank = lru_rank[way];
+	for (int i=0; i < Ways; i++) {
+		lru_rank[i] -= (lru_rank[i] > rank);
+	}
+	lru_rank[way] = Ways - 1;
+}
+
+
+// The RRIP victim search, unrolled the same way
+template <int Ways>
+static int maxRRPVFixed(const unsigned char* rrpv) {
+	int victim = 0;
+	for (int way=1; way < Ways; way++) {
+		victim = (rrpv[way] > rrpv[victim]) ? way : victim;
+	}
+	return victim;
+}
+
+int CacheSet::findWay(unsigned long long tag) {
+	switch (ways) {
+		case 1:
+			return findWayFixed<1>(tags, states, tag);
+		case 2:
+			return findWayFixed<2>(tags, states, tag);
+		case 4:
+			return findWayFixed<4>(tags, states, tag);
+		case 8:
+			return findWayFixed<8>(tags, states, tag);
+		case 16:
+			return findWayFixed<16>(tags, states, tag);
+	}
+	for (int way=0; way < ways; way++) {
+		if (states[way] != CacheBlockState::Invalid && tags[way] == tag) {
+			return way;
 		}
 	}
+	return -1;
 }
 
-CacheBlock CacheSet::insertCacheBlock(CacheBlock new_block) {
-	CacheBlock evicted_block = blocks.front();
-	blocks.pop_front();
-	blocks.push_back(new_block);
+void CacheSet::touch(int way) {
+	switch (ways) {
+		case 1:
+			return;
+		case 2:
+			return touchFixed<2>(repl, way);
+		case 4:
+			return touchFixed<4>(repl, way);
+		case 8:
+			return touchFixed<8>(repl, way);
+		case 16:
+			return touchFixed<16>(repl, way);
+	}
+	unsigned char rank = repl[way];
+	for (int i=0; i < ways; i++) {
+		if (repl[i] > rank) {
+			repl[i]--;
+		}
+	}
+	repl[way] = ways - 1;
+}
+
+void CacheSet::demote(int way) {
+	unsigned char rank = repl[way];
+	for (int i=0; i < ways; i++) {
+		if (repl[i] < rank) {
+			repl[i]++;
+		}
+	}
+	repl[way] = 0;
+}
+
+int CacheSet::invalidWay() {
+	for (int w=0; w < (ways + 63) / 64; w++) {
+		if (invalid[w] != 0) {
+			return w * 64 + __builtin_ctzll(invalid[w]);
+		}
+	}
+	return -1;
+}
+
+void CacheSet::rebuild() {
+	for (int w=0; w < MAX_ASSOCIATIVITY / 64; w++) {
+		invalid[w] = 0;
+	}
+	for (int way=0; way < ways; way++) {
+		if (states[way] == CacheBlockState::Invalid) {
+			invalid[way >> 6] |= 1ULL << (way & 63);
+		}
+	}
+}
+
+// Tree nodes are numbered from 1 at the root, the children of node n being 2n and 2n+1
+// A node bit of 1 means the pseudo-LRU way is in its right half
+static inline bool plruBit(const unsigned char* bits, int node) {
+	return (bits[node >> 3] >> (node & 7)) & 1;
+}
+
+static inline void setPlruBit(unsigned char* bits, int node, bool value) {
+	bits[node >> 3] = (bits[node >> 3] & ~(1 << (node & 7))) | (value << (node & 7));
+}
+
+static inline int plruLeaves(int ways) {
+	int leaves = 1;
+	while (leaves < ways) {
+		leaves <<= 1;
+	}
+	return leaves;
+}
+
+int CacheSet::plruVictim() {
+	int node = 1;
+	int first = 0;
+	for (int half = plruLeaves(ways) >> 1; half > 0; half >>= 1) {
+		if (plruBit(repl, node) && first + half < ways) {
+			node = 2 * node + 1;
+			first += half;
+		} else {
+			node = 2 * node;
+		}
+	}
+	return first;
+}
+
+void CacheSet::plruTouch(int way) {
+	// Every node on the path is pointed away from way
+	int node = 1;
+	int first = 0;
+	for (int half = plruLeaves(ways) >> 1; half > 0; half >>= 1) {
+		bool right = way >= first + half;
+		setPlruBit(repl, node, !right);
+		node = 2 * node + right;
+		first += right ? half : 0;
+	}
+}
+
+int CacheSet::rripVictim() {
+	int victim;
+	switch (ways) {
+		case 2:
+			victim = maxRRPVFixed<2>(repl);
+			break;
+		case 4:
+			victim = maxRRPVFixed<4>(repl);
+			break;
+		case 8:
+			victim = maxRRPVFixed<8>(repl);
+			break;
+		case 16:
+			victim = maxRRPVFixed<16>(repl);
+			break;
+		default:
+			victim = 0;
+			for (int way=1; way < ways; way++) {
+				if (repl[way] > repl[victim]) {
+					victim = way;
+				}
+			}
+	}
+	// Aging the whole set at once does what repeatedly incrementing every RRPV until one is RRPV_MAX would
+	unsigned char age = RRPV_MAX - repl[victim];
+	if (age > 0) {
+		for (int way=0; way < ways; way++) {
+			repl[way] += age;
+		}
+	}
+	return victim;
+}
+
+template <ReplacementPolicy R>
+int CacheSet::rripInsertion() {
+	ReplacementPolicy insertion = R;
+	if (R == ReplacementPolicy::DRRIP) {
+		// A fill is a miss; misses in the leader sets move the selector
+		switch (role) {
+			case DuelRole::SRRIPLeader:
+				shared->psel += (shared->psel < (1 << PSEL_BITS) - 1);
+				insertion = ReplacementPolicy::SRRIP;
+				break;
+			case DuelRole::BRRIPLeader:
+				shared->psel -= (shared->psel > 0);
+				insertion = ReplacementPolicy::BRRIP;
+				break;
+			case DuelRole::Follower:
+				insertion = (shared->psel >= (1 << (PSEL_BITS - 1))) ? ReplacementPolicy::BRRIP : ReplacementPolicy::SRRIP;
+				break;
+		}
+	}
+	if (insertion == ReplacementPolicy::BRRIP) {
+		return (++shared->brrip_inserts % BRRIP_LONG_INTERVAL == 0) ? RRPV_MAX - 1 : RRPV_MAX;
+	}
+	return RRPV_MAX - 1;
+}
+
+template <ReplacementPolicy R>
+int CacheSet::victimWay() {
+	switch (R) {
+		case ReplacementPolicy::LRU:
+			// Invalid blocks are ranked lowest, so the LRU way is the first invalid one if any
+			for (int way=0; way < ways; way++) {
+				if (repl[way] == 0) {
+					return way;
+				}
+			}
+			return 0;
+		case ReplacementPolicy::CoherenceLRU:
+		{
+			// The lowest ranked of the invalid and Shared ways, since dropping a Shared block
+			// costs neither a writeback nor the only copy on chip; the LRU way if there is none
+			int victim = -1;
+			int lru = 0;
+			for (int way=0; way < ways; way++) {
+				CacheBlockState state = states[way];
+				if ((state == CacheBlockState::Invalid || state == CacheBlockState::Shared)
+					&& (victim < 0 || repl[way] < repl[victim])) {
+					victim = way;
+				}
+				if (repl[way] == 0) {
+					lru = way;
+				}
+			}
+			return (victim < 0) ? lru : victim;
+		}
+		default:
+			break;
+	}
+	int way = invalidWay();
+	if (way >= 0) {
+		return way;
+	}
+	switch (R) {
+		case ReplacementPolicy::TreePLRU:
+			return plruVictim();
+		case ReplacementPolicy::RandomVictim:
+			return (int) (((unsigned __int128) shared->nextRandom() * ways) >> 64);
+		default:
+			return rripVictim();
+	}
+}
+
+template <ReplacementPolicy R>
+void CacheSet::hit(int way) {
+	switch (R) {
+		case ReplacementPolicy::LRU:
+		case ReplacementPolicy::CoherenceLRU:
+			touch(way);
+			break;
+		case ReplacementPolicy::TreePLRU:
+			plruTouch(way);
+			break;
+		case ReplacementPolicy::RandomVictim:
+			break;
+		default:
+			repl[way] = 0;
+	}
+}
+
+template <ReplacementPolicy R>
+void CacheSet::fill(int way) {
+	invalid[way >> 6] &= ~(1ULL << (way & 63));
+	switch (R) {
+		case ReplacementPolicy::LRU:
+		case ReplacementPolicy::CoherenceLRU:
+			touch(way);
+			break;
+		case ReplacementPolicy::TreePLRU:
+			plruTouch(way);
+			break;
+		case ReplacementPolicy::RandomVictim:
+			break;
+		default:
+			repl[way] = rripInsertion<R>();
+	}
+}
+
+template <ReplacementPolicy R>
+CacheBlock CacheSet::insert(CacheBlock new_block) {
+	int victim = victimWay<R>();
+	CacheBlock evicted_block = CacheBlock(tags[victim], states[victim]);
+
+	tags[victim] = new_block.tag;
+	states[victim] = new_block.state;
+	fill<R>(victim);
 	return evicted_block;
 }
 
+CacheBlockState CacheSet::getState(unsigned long long tag) {
+	int way = findWay(tag);
+	if (way < 0) {
+		return CacheBlockState::Invalid;
+	}
+	return states[way];
+}
+
+void CacheSet::moveToMRU(unsigned long long tag) {
+	int way = findWay(tag);
+	if (way < 0) {
+		return;
+	}
+	switch (policy) {
+		case ReplacementPolicy::LRU:
+			return hit<ReplacementPolicy::LRU>(way);
+		case ReplacementPolicy::TreePLRU:
+			return hit<ReplacementPolicy::TreePLRU>(way);
+		case ReplacementPolicy::SRRIP:
+			return hit<ReplacementPolicy::SRRIP>(way);
+		case ReplacementPolicy::BRRIP:
+			return hit<ReplacementPolicy::BRRIP>(way);
+		case ReplacementPolicy::DRRIP:
+			return hit<ReplacementPolicy::DRRIP>(way);
+		case ReplacementPolicy::RandomVictim:
+			return hit<ReplacementPolicy::RandomVictim>(way);
+		case ReplacementPolicy::CoherenceLRU:
+			return hit<ReplacementPolicy::CoherenceLRU>(way);
+	}
+}
+
+CacheBlock CacheSet::insertCacheBlock(CacheBlock new_block) {
+	switch (policy) {
+		case ReplacementPolicy::TreePLRU:
+			return insert<ReplacementPolicy::TreePLRU>(new_block);
+		case ReplacementPolicy::SRRIP:
+			return insert<ReplacementPolicy::SRRIP>(new_block);
+		case ReplacementPolicy::BRRIP:
+			return insert<ReplacementPolicy::BRRIP>(new_block);
+		case ReplacementPolicy::DRRIP:
+			return insert<ReplacementPolicy::DRRIP>(new_block);
+		case ReplacementPolicy::RandomVictim:
+			return insert<ReplacementPolicy::RandomVictim>(new_block);
+		case ReplacementPolicy::CoherenceLRU:
+			return insert<ReplacementPolicy::CoherenceLRU>(new_block);
+		default:
+			return insert<ReplacementPolicy::LRU>(new_block);
+	}
+}
+
 void CacheSet::setState(unsigned long long tag, CacheBlockState state) {
-	for (std::list<CacheBlock>::iterator iter=blocks.begin(); iter != blocks.end() ; iter++) {
-		if (iter->state != CacheBlockState::Invalid && iter->tag == tag) {
-			if (state == CacheBlockState::Invalid) {
-				// Move to LRU position
-				// We want invalid blocks to be at the LRU position so that
-				// we don't evict a valid block when an invalid block is available
-				CacheBlock cb = *iter;
-				cb.state = state;
-				cb.tag = 0;
-				blocks.erase(iter);
-				blocks.push_front(cb);
-			} else {
-				iter->state = state;
-			}
+	int way = findWay(tag);
+	if (way < 0) {
+		return;
+	}
+	if (state == CacheBlockState::Invalid) {
+		// Move to LRU position
+		// We want invalid blocks to be at the LRU position so that
+		// we don't evict a valid block when an invalid block is available
+		// The other policies look for invalid ways before asking the policy
+		states[way] = state;
+		tags[way] = 0;
+		invalid[way >> 6] |= 1ULL << (way & 63);
+		if (policy == ReplacementPolicy::LRU || policy == ReplacementPolicy::CoherenceLRU) {
+			demote(way);
 		}
+	} else {
+		states[way] = state;
 	}
 }
 
 void CacheSet::print() {
-	for (std::list<CacheBlock>::iterator iter = blocks.begin(); iter != blocks.end(); iter++) {
-		switch (iter->state) {
+	// Blocks are printed from the LRU to the MRU position, or in way order
+	// under the policies that do not rank the ways
+	bool ranked = policy == ReplacementPolicy::LRU || policy == ReplacementPolicy::CoherenceLRU;
+	int way_at_rank[MAX_ASSOCIATIVITY];
+	for (int way=0; way < ways; way++) {
+		way_at_rank[ranked ? repl[way] : way] = way;
+	}
+	for (int rank=0; rank < ways; rank++) {
+		int way = way_at_rank[rank];
+		switch (states[way]) {
 			case CacheBlockState::Modified:
 				std::cout << "M";
 				break;
@@ -82,8 +444,8 @@ void CacheSet::print() {
 				std::cout << "O";
 				break;
 		}
-		std::cout << ":" << "0x" << std::hex << iter->tag;
+		std::cout << ":" << "0x" << std::hex << tags[way];
 		std::cout << "\t";
 	}
-	std::cout << std::endl;
+	std::cout << '\n';
 }
@@ -1,4 +1,8 @@
 #pragma once
+#include <cstdint>
+#include "replacement.h"
+#include "geometry.h"
+
 typedef enum {
 	Modified,
 	Exclusive,
@@ -13,14 +17,46 @@ class CacheBlock {
 		unsigned long long tag;
 		CacheBlockState state;
 
-		CacheBlock(int _tag, CacheBlockState _state);
+		CacheBlock(unsigned long long _tag, CacheBlockState _state);
 };
 
+// The ways of a set are kept in parallel arrays so that lookups, hits,
+// inserts and invalidations never allocate. The arrays belong to the Cache,
+// which lays out all of its sets back to back; a CacheSet points at its slice.
+// Each way has a byte of replacement state, used as the policy needs:
+//  - LRU and CoherenceLRU: a rank, 0 being the LRU position and ways-1 the MRU
+//    position. Invalid blocks are always ranked below valid blocks, so the LRU
+//    way is also the first invalid way when there is one.
+//  - TreePLRU: the bytes hold the bits of the tree, packed
+//  - SRRIP, BRRIP and DRRIP: the RRPV of the way
+// Whatever the policy, an invalid way is always chosen before a valid block is evicted.
+// Each access switches once on the policy, to a body specialized for it.
+// The invalid ways are kept in a bitmask as blocks are filled and invalidated, so the
+// tree-PLRU and random victims are found without scanning the ways. LRU finds the way
+// ranked 0 with a scan, which is no dearer than the rank update every hit and fill
+// already makes; keeping that way up to date instead moves the scan into the update
+// and made fills slower. The RRIP policies scan the RRPVs, and coherence-lru the ranks.
 class CacheSet {
 	public:
-		std::list<CacheBlock> blocks;
+		unsigned long long* tags;
+		CacheBlockState* states;
+		unsigned char* repl;
+		int ways;
+		ReplacementPolicy policy;
+		DuelRole role;
+
+		// State shared by the sets of the cache; NULL for LRU
+		ReplacementState* shared;
+
+		// A bit per way, set when the way is invalid
+		uint64_t invalid[MAX_ASSOCIATIVITY / 64];
 
-		CacheSet();
+		// Initializes the ways at the storage given to invalid blocks, replaced in LRU order
+		CacheSet(unsigned long long* _tags, CacheBlockState* _states, unsigned char* _repl, int _ways);
+
+		// Same, with the policy given; set_index places the set among the DRRIP leaders
+		CacheSet(unsigned long long* _tags, CacheBlockState* _states, unsigned char* _repl, int _ways,
+			ReplacementPolicy _policy, ReplacementState* _shared, int set_index);
 
 		// Returns the state of the Block with tag given
 		// Returns CacheBlockState::Invalid if cache block is not found
@@ -29,12 +65,47 @@ class CacheSet {
 		// Sets the state of the block with tag given to state
 		void setState(unsigned long long tag, CacheBlockState state);
 
-		// Moves the block with tag given to MRU position of the set
+		// Records a hit on the block with tag given: under LRU, moves it to the MRU position of the set
 		void moveToMRU(unsigned long long tag);
 
-		// Inserts a new cache block in the set
+		// Inserts a new cache block in the set, in place of the victim of the policy
 		CacheBlock insertCacheBlock(CacheBlock new_block);
 
+		// Recomputes invalid from the states, once they were replaced (see Checkpoint::restore)
+		void rebuild();
+
 		// Prints the cache set
 		void print();
+
+	private:
+		// Returns the way holding a valid block with the tag given, or -1
+		int findWay(unsigned long long tag);
+
+		// Moves way to the MRU position
+		void touch(int way);
+
+		// Moves way to the LRU position
+		void demote(int way);
+
+		// Returns the first invalid way, or -1
+		int invalidWay();
+
+		// Per policy: the way to evict, and the updates on a hit and on a fill
+		template <ReplacementPolicy R>
+		int victimWay();
+		template <ReplacementPolicy R>
+		void hit(int way);
+		template <ReplacementPolicy R>
+		void fill(int way);
+		template <ReplacementPolicy R>
+		CacheBlock insert(CacheBlock new_block);
+
+		// Tree-PLRU over the next power of two of ways; the ways above ways are never chosen
+		int plruVictim();
+		void plruTouch(int way);
+
+		// RRIP: the way with the largest RRPV, after aging the set so that it is RRPV_MAX
+		int rripVictim();
+		template <ReplacementPolicy R>
+		int rripInsertion();
 };
@@ -0,0 +1,455 @@
+#!/bin/bash
+# Regression checks, run with make check
+# Every mode that claims to give the results of another is run both ways, on the
+# trace fixtures and on generated workloads, and the outputs are compared
+# Prints a line per check, and exits 1 if any failed
+cd "$(dirname "$0")"
+SIM=./sim
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+TRACES="Abdun_testcases/testcases/*.in"
+PROTOCOLS="MSI MESI MESIF MOESI FESI"
+WORKLOADS="uniform producer-consumer migratory false-sharing read-mostly streaming zipfian"
+WORKLOAD_ACCESSES=20000
+failed=0
+
+# A trace of random accesses, larger than the fixtures; cores stay below 10 since the
+# driver reads them as hex after the first access, like the original one
+LARGE_TRACE="$TMP/large.in"
+awk 'BEGIN { srand(1); print "MOESI"; for (i=0; i < 50000; i++)
+	printf "%d %s 0x%x\n", int(rand() * 10), rand() < 0.3 ? "w" : "r", int(rand() * 4096) * 64 }' > "$LARGE_TRACE"
+
+# awk function returning the value of the counter name on a line of JSON stats
+JSON_GET='function get(name) {
+	match($0, "\"" name "\": [0-9]+")
+	return substr($0, RSTART + length(name) + 4, RLENGTH - length(name) - 4) + 0
+}'
+
+# same NAME FILE1 FILE2: NAME passes if the files are identical
+same() {
+	if cmp -s "$2" "$3"; then
+		echo "ok   $1"
+	else
+		echo "FAIL $1"
+		failed=1
+	fi
+}
+
+# starts NAME FILE1 FILE2: NAME passes if FILE2 starts with the whole of FILE1, for the
+# modes that print the legacy output and then a report of their own
+starts() {
+	if head -c "$(wc -c < "$2")" "$3" | cmp -s "$2" -; then
+		echo "ok   $1"
+	else
+		echo "FAIL $1"
+		failed=1
+	fi
+}
+
+# contains NAME TEXT FILE: NAME passes if a line of FILE contains TEXT
+contains() {
+	if grep -qF "$2" "$3"; then
+		echo "ok   $1"
+	else
+		echo "FAIL $1"
+		failed=1
+	fi
+}
+
+# fails NAME COMMAND...: NAME passes if the command exits with status 1
+fails() {
+	local name=$1
+	shift
+	"$@" > /dev/null 2>&1
+	if [ $? -eq 1 ]; then
+		echo "ok   $name"
+	else
+		echo "FAIL $name"
+		failed=1
+	fi
+}
+
+# A binary trace, plain or gzip compressed, gives the results of the text trace it was
+# converted from, and a malformed trace ends the run with an error
+check_binary() {
+	for trace in $TRACES; do
+		$SIM < "$trace" > "$TMP/text"
+		$SIM --convert "$TMP/trace.bin" < "$trace" > /dev/null
+		$SIM --trace "$TMP/trace.bin" > "$TMP/binary"
+		same "binary $trace" "$TMP/text" "$TMP/binary"
+		gzip -c "$TMP/trace.bin" > "$TMP/trace.bin.gz"
+		$SIM --trace "$TMP/trace.bin.gz" > "$TMP/binary"
+		same "binary gzip $trace" "$TMP/text" "$TMP/binary"
+		gzip -c "$trace" > "$TMP/trace.in.gz"
+		$SIM --trace "$TMP/trace.in.gz" > "$TMP/binary"
+		same "text gzip $trace" "$TMP/text" "$TMP/binary"
+	done
+
+	# MyTestCases/1.txt has no protocol line: the simulator prints nothing, as it always
+	# did, but the converter reports it
+	$SIM --trace MyTestCases/1.txt > "$TMP/text"
+	same "no protocol" /dev/null "$TMP/text"
+	fails "no protocol convert" $SIM --convert "$TMP/none.bin" --trace MyTestCases/1.txt
+
+	# The op of the first record, after the 24 byte header and its address and core
+	printf '\x07' | dd of="$TMP/trace.bin" bs=1 seek=34 conv=notrunc 2> /dev/null
+	fails "binary bad op" $SIM --trace "$TMP/trace.bin"
+	gzip -c "$TMP/trace.bin" > "$TMP/trace.bin.gz"
+	fails "binary gzip bad op" $SIM --trace "$TMP/trace.bin.gz"
+	printf 'MSI\n0 r 0x10\n1 w 0x1ffffffffffffffff\n2 r 0x30\n' > "$TMP/overflow.in"
+	fails "text address overflow" $SIM --trace "$TMP/overflow.in"
+	printf 'MSI\n0 r 0x10\n99999999999999999999 w 0x20\n' > "$TMP/overflow.in"
+	fails "text core overflow" $SIM --trace "$TMP/overflow.in"
+}
+
+# The sweep prints for every protocol and geometry the totals the single run prints
+check_sweep() {
+	for trace in $TRACES "$LARGE_TRACE"; do
+		name=${trace#$TMP/}
+		$SIM --sweep all --sweep-geometry 4x4,16x2 --threads 3 < "$trace" \
+			| awk 'NR > 1 { printf "%s %s %s", $1, $2, $3; for (i=5; i <= 19; i++) printf " %s", $i; print "" }' \
+			| sort > "$TMP/sweep"
+		for protocol in $PROTOCOLS; do
+			for geometry in 4x4 16x2; do
+				{ echo $protocol; tail -n +2 "$trace"; } \
+					| $SIM --sets ${geometry%x*} --ways ${geometry#*x} --stats-format json \
+					| awk -v protocol=$protocol -v geometry=$geometry "$JSON_GET"'
+						/"total": / { total = get("reads") " " get("read_misses") " " get("writes") " " get("write_misses") " " get("invalidations") " " get("writebacks") " " get("provided") " " get("from_llc") " " get("random") }
+						/"bus": / { bus = get("busrd") " " get("busrdx") " " get("busupgr") " " get("flushes") " " get("flush_primes") " " get("setf") }
+						END { split(geometry, size, "x"); print protocol, size[1], size[2], total, bus }'
+			done
+		done | sort > "$TMP/single"
+		same "sweep $name" "$TMP/single" "$TMP/sweep"
+	done
+}
+
+# The snoop filter only skips the caches that do not hold the block
+check_snoop_filter() {
+	for trace in $TRACES; do
+		$SIM < "$trace" > "$TMP/broadcast"
+		$SIM --snoop-filter < "$trace" > "$TMP/filtered"
+		starts "snoop filter $trace" "$TMP/broadcast" "$TMP/filtered"
+	done
+	for protocol in $PROTOCOLS; do
+		for workload in $WORKLOADS; do
+			options="--workload $workload --protocol $protocol --accesses $WORKLOAD_ACCESSES"
+			$SIM $options < /dev/null > "$TMP/broadcast"
+			$SIM $options --snoop-filter < /dev/null > "$TMP/filtered"
+			starts "snoop filter $workload $protocol" "$TMP/broadcast" "$TMP/filtered"
+		done
+	done
+}
+
+# A workload is the same run for the same seed, and the default seed is 1
+check_workload() {
+	for protocol in $PROTOCOLS; do
+		for workload in $WORKLOADS; do
+			options="--workload $workload --protocol $protocol --accesses $WORKLOAD_ACCESSES"
+			$SIM $options < /dev/null > "$TMP/default"
+			$SIM $options --seed 1 < /dev/null > "$TMP/seeded"
+			same "workload seed $workload $protocol" "$TMP/default" "$TMP/seeded"
+			$SIM $options --seed 7 < /dev/null > "$TMP/first"
+			$SIM $options --seed 7 < /dev/null > "$TMP/second"
+			same "workload rerun $workload $protocol" "$TMP/first" "$TMP/second"
+		done
+	done
+}
+
+# The timed bus reorders the accesses of different cores, but each core makes the
+# reads and writes it does without it
+check_timed_bus() {
+	for trace in $TRACES "$LARGE_TRACE"; do
+		$SIM --stats-format json < "$trace" | core_accesses cache > "$TMP/atomic"
+		$SIM --timed-bus --stats-format json --stats-file "$TMP/timed.json" < "$trace" > /dev/null
+		core_accesses cache < "$TMP/timed.json" > "$TMP/timed"
+		same "timed bus $trace" "$TMP/atomic" "$TMP/timed"
+	done
+	for protocol in $PROTOCOLS; do
+		options="--workload migratory --protocol $protocol --accesses $WORKLOAD_ACCESSES --stats-format json"
+		$SIM $options < /dev/null | core_accesses cache > "$TMP/atomic"
+		$SIM $options --timed-bus --arbitration round-robin --stats-file "$TMP/timed.json" < /dev/null > /dev/null
+		core_accesses cache < "$TMP/timed.json" > "$TMP/timed"
+		same "timed bus $protocol" "$TMP/atomic" "$TMP/timed"
+	done
+	# Two cores reading their own blocks are timed alike whether the trace interleaves
+	# them or lists each core's accesses in one run, as a trace captured per thread does
+	for layout in interleaved per-thread; do
+		awk -v layout=$layout 'BEGIN { print "MESI"; for (i=0; i < 200000; i++) {
+			core = layout == "per-thread" ? int(i / 100000) : i % 2
+			block = layout == "per-thread" ? i % 100000 : int(i / 2)
+			printf "%d r 0x%x\n", core, (block % 8192) * 64 + core * 1048576 } }' > "$TMP/$layout.in"
+		$SIM --timed-bus --no-block-dump < "$TMP/$layout.in" | sed -n '/Timed bus/,$p' > "$TMP/$layout"
+	done
+	same "timed bus per-thread trace" "$TMP/interleaved" "$TMP/per-thread"
+}
+
+# Banking the bus splits its lines and counters by address, and changes no result
+check_bus_banks() {
+	for trace in $TRACES; do
+		$SIM < "$trace" > "$TMP/one"
+		$SIM --bus-banks 4 < "$trace" > "$TMP/banked"
+		starts "bus banks $trace" "$TMP/one" "$TMP/banked"
+	done
+	for protocol in $PROTOCOLS; do
+		for workload in $WORKLOADS; do
+			options="--workload $workload --protocol $protocol --accesses $WORKLOAD_ACCESSES"
+			$SIM $options < /dev/null > "$TMP/one"
+			$SIM $options --bus-banks 8 < /dev/null > "$TMP/banked"
+			starts "bus banks $workload $protocol" "$TMP/one" "$TMP/banked"
+		done
+	done
+}
+
+# A non-inclusive LLC never touches the caches in front of it, even when it is small
+check_llc() {
+	for trace in $TRACES; do
+		$SIM --no-block-dump < "$trace" | cache_counters > "$TMP/none"
+		$SIM --no-block-dump --llc non-inclusive < "$trace" | sed "/^>> LLC/q" | cache_counters > "$TMP/llc"
+		same "llc $trace" "$TMP/none" "$TMP/llc"
+	done
+	for protocol in $PROTOCOLS; do
+		for workload in $WORKLOADS; do
+			options="--workload $workload --protocol $protocol --accesses $WORKLOAD_ACCESSES --no-block-dump"
+			$SIM $options < /dev/null | cache_counters > "$TMP/none"
+			$SIM $options --llc non-inclusive --llc-banks 2 --llc-sets 16 --llc-ways 4 < /dev/null | sed "/^>> LLC/q" | cache_counters > "$TMP/llc"
+			same "llc $workload $protocol" "$TMP/none" "$TMP/llc"
+		done
+	done
+}
+
+# Every replacement policy carries its state across a checkpoint
+check_replacement() {
+	for policy in lru tree-plru srrip brrip drrip random coherence-lru; do
+		options="--workload zipfian --protocol MOESI --accesses $WORKLOAD_ACCESSES --sets 16 --ways 8 --replacement $policy"
+		$SIM $options --stats-format json < /dev/null > "$TMP/full"
+		$SIM $options --save-checkpoint "$TMP/checkpoint" --checkpoint-at 7777 < /dev/null > /dev/null
+		$SIM $options --restore "$TMP/checkpoint" --stats-format json < /dev/null > "$TMP/restored"
+		same "restore $policy" "$TMP/full" "$TMP/restored"
+	done
+}
+
+# Sampling windows that cover every access estimate exactly the totals of the full run
+check_sampling() {
+	for protocol in $PROTOCOLS; do
+		for workload in $WORKLOADS; do
+			options="--workload $workload --protocol $protocol --accesses $WORKLOAD_ACCESSES"
+			$SIM $options --no-block-dump < /dev/null | sed -n '/Total Cache Stats/,$p' |
+				awk -F ' *: *' '/^(Reads|Read misses|Writes|Write misses|Writebacks|Invalidations|Provided|From LLC) / { print $1, $2 }' |
+				sort > "$TMP/full"
+			$SIM $options --sample --sample-period 1000 --sample-window 1000 --sample-warmup 0 < /dev/null |
+				awk '/^(Reads|Read misses|Writes|Write misses|Writebacks|Invalidations|Provided|From LLC) +[0-9]/ {
+					name = $1; for (i = 2; i < NF - 2; i++) name = name " " $i; print name, $(NF - 2) }' |
+				sort > "$TMP/sampled"
+			same "sampling $workload $protocol" "$TMP/full" "$TMP/sampled"
+		done
+	done
+	# An interval listed twice would overlap its own window
+	printf "1 0\n1 1\n3 2\n" > "$TMP/simpoints"
+	printf "0.4 0\n0.4 1\n0.2 2\n" > "$TMP/weights"
+	fails "sampling repeated simpoint" $SIM --workload uniform --accesses 5000 --sample --sample-period 1000 \
+		--simpoints "$TMP/simpoints" --simpoint-weights "$TMP/weights"
+}
+
+# A run restored from a checkpoint taken halfway reports what the full run does
+check_restore() {
+	for trace in $TRACES; do
+		half=$(( $(wc -l < "$trace") / 2 ))
+		$SIM --stats-format json < "$trace" > "$TMP/full"
+		$SIM --save-checkpoint "$TMP/checkpoint" --checkpoint-at $half < "$trace" > /dev/null
+		$SIM --restore "$TMP/checkpoint" --stats-format json < "$trace" > "$TMP/restored"
+		same "restore $trace" "$TMP/full" "$TMP/restored"
+	done
+	for protocol in $PROTOCOLS; do
+		for workload in $WORKLOADS; do
+			options="--workload $workload --protocol $protocol --accesses $WORKLOAD_ACCESSES"
+			$SIM $options --stats-format json < /dev/null > "$TMP/full"
+			$SIM $options --save-checkpoint "$TMP/checkpoint" --checkpoint-at 7777 < /dev/null > /dev/null
+			$SIM $options --restore "$TMP/checkpoint" --stats-format json < /dev/null > "$TMP/restored"
+			same "restore $workload $protocol" "$TMP/full" "$TMP/restored"
+		done
+	done
+}
+
+# The counters of every cache, which the other modes must reproduce
+cache_counters() {
+	grep -E '^(>> Cache|(Reads|Read misses|Writes|Write misses|Writebacks|Invalidations|Provided) +:)' | grep -v '^[A-Za-z ]\{14\}:'
+}
+
+# The directory keeps the caches in the states the bus does, with the same counters
+check_directory() {
+	for workload in $WORKLOADS; do
+		options="--workload $workload --protocol FESI --accesses $WORKLOAD_ACCESSES"
+		$SIM $options < /dev/null | cache_counters > "$TMP/snoop"
+		$SIM $options --directory < /dev/null | cache_counters > "$TMP/directory"
+		same "directory $workload" "$TMP/snoop" "$TMP/directory"
+	done
+}
+
+# The size of the search and the kinds of error the model checker found; the counterexample
+# of each kind depends on which thread reached it first
+model_summary() {
+	awk '/^(States|Transitions|Depth|Errors) / { print } prev == "---- " { print | "sort" } { prev = $0 }'
+}
+
+# The model checker explores the same states and finds the same errors whatever the threads,
+# and the symmetry reduction finds every error the full search does
+# It exits 1 on the errors it finds in FESI_GEM5, among them the AckCount race below
+check_model() {
+	options="--caches 3 --queue-depth 1 --keep-going"
+	./checker $options --threads 1 | model_summary > "$TMP/serial"
+	./checker $options --threads 3 | model_summary > "$TMP/parallel"
+	same "model checker threads" "$TMP/serial" "$TMP/parallel"
+	./checker $options --no-symmetry | grep '^Errors ' > "$TMP/unreduced"
+	grep '^Errors ' "$TMP/serial" > "$TMP/reduced"
+	same "model checker symmetry" "$TMP/reduced" "$TMP/unreduced"
+	fails "model checker exit" ./checker
+	./checker > "$TMP/first"
+	contains "model checker AckCount race" 'Invalid transition: Cache 0 in IF_AD on NoAckCount' "$TMP/first"
+}
+
+# A sharded run merges the counters of its shards into exactly those of the serial run
+check_shards() {
+	for trace in $TRACES; do
+		$SIM < "$trace" > "$TMP/serial"
+		$SIM --shards 2 < "$trace" > "$TMP/sharded"
+		same "shards $trace" "$TMP/serial" "$TMP/sharded"
+	done
+	for protocol in $PROTOCOLS; do
+		for workload in $WORKLOADS; do
+			options="--workload $workload --protocol $protocol --accesses $WORKLOAD_ACCESSES --sets 16"
+			options="$options --snoop-filter --bus-banks 2 --latency --stats-format json"
+			$SIM $options < /dev/null > "$TMP/serial"
+			$SIM $options --shards 4 < /dev/null > "$TMP/sharded"
+			same "shards $workload $protocol" "$TMP/serial" "$TMP/sharded"
+		done
+	done
+}
+
+# A compact trace, plain or gzip compressed, gives the results of the text trace it was
+# converted from; the large trace spans several blocks, which --shards and --sweep decode
+# in parallel
+check_compact() {
+	for trace in $TRACES "$LARGE_TRACE"; do
+		name=${trace#$TMP/}
+		$SIM --convert-compact "$TMP/trace.fct" < "$trace" > /dev/null
+		$SIM < "$trace" > "$TMP/text"
+		$SIM --trace "$TMP/trace.fct" > "$TMP/compact"
+		same "compact $name" "$TMP/text" "$TMP/compact"
+		gzip -c "$TMP/trace.fct" > "$TMP/trace.fct.gz"
+		$SIM --trace "$TMP/trace.fct.gz" > "$TMP/compact"
+		same "compact gzip $name" "$TMP/text" "$TMP/compact"
+		$SIM --shards 2 --trace "$TMP/trace.fct" > "$TMP/compact"
+		same "compact shards $name" "$TMP/text" "$TMP/compact"
+		# The last column of a sweep is the time each run took
+		$SIM --sweep all < "$trace" | awk '{ $NF = ""; print }' > "$TMP/text"
+		$SIM --sweep all --trace "$TMP/trace.fct" | awk '{ $NF = ""; print }' > "$TMP/compact"
+		same "compact sweep $name" "$TMP/text" "$TMP/compact"
+	done
+}
+
+# shm_run NAME OPTIONS...: runs the simulator on the ring NAME, fed by the producer with
+# the options given, and prints what the simulator printed
+shm_run() {
+	local ring=$1
+	shift
+	$SIM --shm "$ring" > "$TMP/shm" &
+	local simulator=$!
+	# The simulator creates the ring, so the producer retries until it is there
+	for try in $(seq 50); do
+		./producer "$ring" "$@" > /dev/null 2>&1 && break
+		sleep 0.1
+	done
+	wait $simulator
+	cat "$TMP/shm"
+}
+
+# Accesses written into the shared-memory ring by another process give the results of
+# the same accesses read from a trace, or generated in the simulator
+check_shm() {
+	ring=/sim-check-$$
+	for trace in $TRACES; do
+		$SIM < "$trace" > "$TMP/trace"
+		shm_run $ring --trace "$trace" > "$TMP/ring"
+		same "shm $trace" "$TMP/trace" "$TMP/ring"
+	done
+	for protocol in $PROTOCOLS; do
+		options="--workload migratory --protocol $protocol --accesses $WORKLOAD_ACCESSES"
+		$SIM $options < /dev/null > "$TMP/trace"
+		shm_run $ring $options > "$TMP/ring"
+		same "shm migratory $protocol" "$TMP/trace" "$TMP/ring"
+	done	# Without a producer the simulator gives up in time, and leaves no ring behind
+	fails "shm timeout" $SIM --shm $ring --shm-timeout 1
+	fails "shm timeout removes the ring" test -e /dev/shm$ring
+}
+
+# Reads and writes per core, from JSON stats: those the core made, as counted by the cache
+# (view cache) or by its L1 (view l1); those the L1 missed or upgraded (view sent), and
+# those the L2 behind it counted (view l2)
+core_accesses() {
+	awk -v view=$1 "$JSON_GET"'
+		/"core[0-9]+": / && (view == "cache" || view == "l2") { print $1, get("reads"), get("writes") }
+		/"core[0-9]+_l1": / && view == "l1" { sub(/_l1/, "", $1); print $1, get("reads"), get("writes") }
+		/"core[0-9]+_l1": / && view == "sent" { sub(/_l1/, "", $1); print $1, get("read_misses"), get("write_misses") + get("upgrades") }'
+}
+
+# The L1 sees every access of its core, and only its misses and upgrades reach the L2
+check_l1() {
+	for protocol in $PROTOCOLS; do
+		for workload in $WORKLOADS; do
+			options="--workload $workload --protocol $protocol --accesses $WORKLOAD_ACCESSES --stats-format json"
+			$SIM $options < /dev/null | core_accesses cache > "$TMP/cache"
+			$SIM $options --l1 4x2 < /dev/null > "$TMP/hierarchy"
+			core_accesses l1 < "$TMP/hierarchy" > "$TMP/l1"
+			same "l1 accesses $workload $protocol" "$TMP/cache" "$TMP/l1"
+			core_accesses sent < "$TMP/hierarchy" > "$TMP/sent"
+			core_accesses l2 < "$TMP/hierarchy" > "$TMP/l2"
+			same "l1 misses $workload $protocol" "$TMP/sent" "$TMP/l2"
+		done
+	done
+}
+
+# --prefetch none is the default, and no prefetcher changes the accesses each core makes
+check_prefetch() {
+	for trace in $TRACES; do
+		$SIM < "$trace" > "$TMP/default"
+		$SIM --prefetch none < "$trace" > "$TMP/none"
+		same "prefetch none $trace" "$TMP/default" "$TMP/none"
+	done
+	for protocol in $PROTOCOLS; do
+		options="--workload streaming --protocol $protocol --accesses $WORKLOAD_ACCESSES"
+		$SIM $options < /dev/null | grep -E '^(Reads|Writes) ' > "$TMP/none"
+		for policy in next-line stride stream; do
+			$SIM $options --prefetch $policy < /dev/null | grep -E '^(Reads|Writes) ' > "$TMP/prefetch"
+			same "prefetch $policy $protocol accesses" "$TMP/none" "$TMP/prefetch"
+		done
+	done
+	# The streaming cores share no block, so the inclusive LLC evicts the prefetched blocks,
+	# but no core's write invalidates one
+	echo 0 > "$TMP/zero"
+	for protocol in $PROTOCOLS; do
+		options="--workload streaming --protocol $protocol --accesses $WORKLOAD_ACCESSES --prefetch next-line"
+		$SIM $options --llc inclusive --llc-banks 1 --llc-sets 16 --llc-ways 4 --stats-format json < /dev/null |
+			awk "$JSON_GET"'/_prefetch": / { sum += get("invalidated") } END { print sum + 0 }' > "$TMP/invalidated"
+		same "prefetch llc evictions $protocol" "$TMP/zero" "$TMP/invalidated"
+	done
+}
+
+check_binary
+check_sweep
+check_snoop_filter
+check_workload
+check_timed_bus
+check_bus_banks
+check_llc
+check_replacement
+check_sampling
+check_restore
+check_directory
+check_model
+check_shards
+check_compact
+check_shm
+check_l1
+check_prefetch
+exit $failed
@@ -0,0 +1,64 @@
+// Model checker of the FESI protocol of FESI_GEM5
+//
+// Usage: checker [--caches N] [--addresses N] [--queue-depth N] [--threads N]
+//                [--no-symmetry] [--keep-going] [--max-states N]
+// Visits every state of N caches and the directory, checks the single-writer /
+// multiple-reader and data-value invariants and looks for invalid transitions and
+// deadlocks, then prints the size of the search and a shortest trace to every error.
+// Exits with 1 when an error is found.
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include "modelcheck.h"
+using namespace std;
+
+static void printUsage(const char* program) {
+	cout << "Usage: " << program << " [options]" << endl;
+	cout << "  --caches N          caches, 2 to " << MODEL_MAX_CACHES << " (default 3)" << endl;
+	cout << "  --addresses N       addresses, 1 to " << MODEL_MAX_ADDRESSES << " (default 1)" << endl;
+	cout << "  --queue-depth N     messages a buffer may hold, 1 to " << MODEL_MAX_QUEUE << " (default 4)" << endl;
+	cout << "  --threads N         threads expanding each level (default: one per core)" << endl;
+	cout << "  --no-symmetry       visit states that differ only in the numbering of the caches apart" << endl;
+	cout << "  --keep-going        search every state, reporting each kind of error once" << endl;
+	cout << "  --max-states N      stop after N states (default 50000000)" << endl;
+}
+
+int main(int argc, char* argv[]) {
+	ModelConfig config;
+	for (int i=1; i < argc; i++) {
+		string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (arg == "--caches" && has_value) {
+			config.caches = atoi(argv[++i]);
+		} else if (arg == "--addresses" && has_value) {
+			config.addresses = atoi(argv[++i]);
+		} else if (arg == "--queue-depth" && has_value) {
+			config.queue_depth = atoi(argv[++i]);
+		} else if (arg == "--threads" && has_value) {
+			config.threads = atoi(argv[++i]);
+		} else if (arg == "--max-states" && has_value) {
+			config.max_states = strtoull(argv[++i], NULL, 10);
+		} else if (arg == "--no-symmetry") {
+			config.symmetry = false;
+		} else if (arg == "--keep-going") {
+			config.keep_going = true;
+		} else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+	if (config.caches < 2 || config.caches > MODEL_MAX_CACHES || config.addresses < 1 || config.addresses > MODEL_MAX_ADDRESSES
+		|| config.queue_depth < 1 || config.queue_depth > MODEL_MAX_QUEUE || config.threads < 1 || config.max_states == 0) {
+		printUsage(argv[0]);
+		return 1;
+	}
+
+	ModelChecker checker(config);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	bool passed = checker.run();
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	checker.printReport(seconds);
+	return passed ? 0 : 1;
+}
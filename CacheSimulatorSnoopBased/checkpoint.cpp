@@ -0,0 +1,340 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "protocol.h"
+
+// Every section starts on a multiple of this
+#define CHECKPOINT_ALIGN 8
+
+#define NUM_CACHE_COUNTERS 10
+#define NUM_BUS_COUNTERS 6
+#define NUM_SNOOP_FILTER_COUNTERS 3
+#define NUM_LLC_COUNTERS 8
+
+// The counters of each component, in checkpoint order
+static unsigned long long* cacheCounters(Cache& cache, int i) {
+	unsigned long long* counters[NUM_CACHE_COUNTERS] = {&cache.num_reads, &cache.num_read_misses, &cache.num_writes,
+		&cache.num_write_misses, &cache.num_writebacks, &cache.num_invalidations, &cache.num_provided,
+		&cache.num_fromLLC, &cache.num_random, &cache.num_cycles};
+	return counters[i];
+}
+
+static unsigned long long* busCounters(Bus& bus, int i) {
+	unsigned long long* counters[NUM_BUS_COUNTERS] = {&bus.num_busrd, &bus.num_busrdx, &bus.num_flushes,
+		&bus.num_flush_primes, &bus.num_busupgr, &bus.num_setF};
+	return counters[i];
+}
+
+static unsigned long long* snoopFilterCounters(SnoopFilter& snoop_filter, int i) {
+	unsigned long long* counters[NUM_SNOOP_FILTER_COUNTERS] = {&snoop_filter.num_lookups,
+		&snoop_filter.num_snoops_sent, &snoop_filter.num_snoops_filtered};
+	return counters[i];
+}
+
+static unsigned long long* llcCounters(LLCBank& bank, int i) {
+	unsigned long long* counters[NUM_LLC_COUNTERS] = {&bank.num_reads, &bank.num_read_hits, &bank.num_writebacks,
+		&bank.num_writeback_hits, &bank.num_evictions, &bank.num_dram_reads, &bank.num_dram_writebacks,
+		&bank.num_back_invalidations};
+	return counters[i];
+}
+
+static inline size_t alignUp(size_t size) {
+	return (size + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+}
+
+// Appends sections to the checkpoint file, padding each one to CHECKPOINT_ALIGN
+class CheckpointWriter {
+	public:
+		std::ofstream out;
+		size_t offset;
+
+		CheckpointWriter(const char* path) : out(path, std::ios::binary) {
+			offset = 0;
+		}
+
+		void write(const void* data, size_t size) {
+			static const char padding[CHECKPOINT_ALIGN] = {0};
+			out.write((const char*) data, size);
+			offset += size;
+			size_t pad = alignUp(offset) - offset;
+			out.write(padding, pad);
+			offset += pad;
+		}
+
+		void writeCounter(unsigned long long value) {
+			write(&value, sizeof(value));
+		}
+};
+
+// Walks the sections of a mapped checkpoint in the order they were written
+class CheckpointCursor {
+	public:
+		char* position;
+
+		CheckpointCursor(void* base) {
+			position = (char*) base;
+		}
+
+		void* take(size_t size) {
+			void* data = position;
+			position += alignUp(size);
+			return data;
+		}
+
+		unsigned long long takeCounter() {
+			return *(unsigned long long*) take(sizeof(unsigned long long));
+		}
+};
+
+// Bytes a cache or LLC bank with the counters and ways given takes
+static size_t storeSize(const CheckpointHeader& header, int counters, size_t ways) {
+	return counters * sizeof(unsigned long long) + alignUp(header.replacement_state_size)
+		+ alignUp(ways * sizeof(unsigned long long)) + alignUp(ways * header.state_size) + alignUp(ways);
+}
+
+// Bytes of a checkpoint of this configuration
+static size_t checkpointSize(const CheckpointHeader& header) {
+	size_t size = alignUp(sizeof(CheckpointHeader));
+	size += header.cores * storeSize(header, NUM_CACHE_COUNTERS, (size_t) header.associativity << header.set_bits);
+	size += NUM_BUS_COUNTERS * sizeof(unsigned long long) + alignUp(header.bus_banks * header.bus_bank_size);
+	size += NUM_SNOOP_FILTER_COUNTERS * sizeof(unsigned long long);
+	if (header.llc_enabled) {
+		size += header.llc_banks * storeSize(header, NUM_LLC_COUNTERS, (size_t) header.llc_associativity << header.llc_set_bits);
+	}
+	return size;
+}
+
+bool saveCheckpoint(const char* path, Simulator& sim, const SimConfig& config, uint64_t position) {
+	CheckpointWriter writer(path);
+	if (!writer.out) {
+		std::cout << "Cannot open " << path << std::endl;
+		return false;
+	}
+
+	const CacheGeometry& geometry = sim.caches[0]->geometry;
+	CheckpointHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CHECKPOINT_MAGIC;
+	header.version = CHECKPOINT_VERSION;
+	header.position = position;
+	header.protocol = sim.protocol;
+	header.cores = sim.numCores();
+	header.set_bits = geometry.set_bits;
+	header.associativity = geometry.associativity;
+	header.offset_bits = geometry.offset_bits;
+	header.replacement = sim.caches[0]->replacement;
+	header.bus_banks = sim.bus->banks.size();
+	header.llc_enabled = sim.llc != NULL;
+	if (sim.llc != NULL) {
+		header.llc_inclusive = config.llc.inclusive;
+		header.llc_banks = config.llc.banks;
+		header.llc_set_bits = config.llc.set_bits;
+		header.llc_associativity = config.llc.associativity;
+		header.llc_replacement = config.llc.replacement;
+	}
+	header.state_size = sizeof(CacheBlockState);
+	header.bus_bank_size = sizeof(BusBank);
+	header.replacement_state_size = sizeof(ReplacementState);
+	writer.write(&header, sizeof(header));
+
+	// The arrays are written from the sets, which may point into a restored checkpoint
+	size_t ways = geometry.associativity;
+	for (int i=0; i < sim.numCores(); i++) {
+		Cache& cache = *sim.caches[i];
+		for (int c=0; c < NUM_CACHE_COUNTERS; c++) {
+			writer.writeCounter(*cacheCounters(cache, c));
+		}
+		writer.write(&cache.replacement_state, sizeof(ReplacementState));
+		writer.write(cache.sets[0].tags, cache.sets.size() * ways * sizeof(unsigned long long));
+		writer.write(cache.sets[0].states, cache.sets.size() * ways * sizeof(CacheBlockState));
+		writer.write(cache.sets[0].repl, cache.sets.size() * ways);
+	}
+
+	for (int c=0; c < NUM_BUS_COUNTERS; c++) {
+		writer.writeCounter(*busCounters(*sim.bus, c));
+	}
+	writer.write(sim.bus->banks.data(), sim.bus->banks.size() * sizeof(BusBank));
+
+	for (int c=0; c < NUM_SNOOP_FILTER_COUNTERS; c++) {
+		writer.writeCounter(sim.snoop_filter != NULL ? *snoopFilterCounters(*sim.snoop_filter, c) : 0);
+	}
+
+	if (sim.llc != NULL) {
+		size_t llc_ways = sim.llc->geometry.associativity;
+		for (size_t b=0; b < sim.llc->banks.size(); b++) {
+			LLCBank& bank = *sim.llc->banks[b];
+			for (int c=0; c < NUM_LLC_COUNTERS; c++) {
+				writer.writeCounter(*llcCounters(bank, c));
+			}
+			writer.write(&bank.replacement_state, sizeof(ReplacementState));
+			writer.write(bank.sets[0].tags, bank.sets.size() * llc_ways * sizeof(unsigned long long));
+			writer.write(bank.sets[0].states, bank.sets.size() * llc_ways * sizeof(CacheBlockState));
+			writer.write(bank.sets[0].repl, bank.sets.size() * llc_ways);
+		}
+	}
+
+	writer.out.close();
+	if (!writer.out) {
+		std::cout << "Cannot write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+Checkpoint::Checkpoint() {
+	header = NULL;
+	fd = -1;
+	base = MAP_FAILED;
+	length = 0;
+}
+
+Checkpoint::~Checkpoint() {
+	if (base != MAP_FAILED) {
+		munmap(base, length);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+bool Checkpoint::open(const char* path) {
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		std::cout << "Cannot open checkpoint " << path << std::endl;
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(CheckpointHeader)) {
+		std::cout << "Checkpoint " << path << " is too short" << std::endl;
+		return false;
+	}
+	length = st.st_size;
+	// Private and writable: the simulation writes to its own copy of the pages it changes
+	base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		std::cout << "Cannot map checkpoint " << path << std::endl;
+		return false;
+	}
+
+	header = (const CheckpointHeader*) base;
+	if (header->magic != CHECKPOINT_MAGIC || header->version != CHECKPOINT_VERSION
+		|| header->state_size != sizeof(CacheBlockState) || header->bus_bank_size != sizeof(BusBank)
+		|| header->replacement_state_size != sizeof(ReplacementState)) {
+		std::cout << "Checkpoint " << path << " is not a version " << CHECKPOINT_VERSION << " checkpoint of this simulator" << std::endl;
+		return false;
+	}
+	if (length < checkpointSize(*header)) {
+		std::cout << "Checkpoint " << path << " is truncated" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Prints the mismatch and returns false if the saved and configured values differ
+static bool same(const char* what, unsigned long long saved, unsigned long long configured) {
+	if (saved != configured) {
+		std::cout << "The checkpoint has " << what << " " << saved << ", the configuration " << configured << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Checkpoint::matches(Protocol protocol, const SimConfig& config) {
+	if (header->protocol != (uint32_t) protocol) {
+		std::cout << "The checkpoint is of protocol " << protocolName((Protocol) header->protocol)
+			<< ", the trace of " << protocolName(protocol) << std::endl;
+		return false;
+	}
+	if (header->replacement != (uint32_t) config.replacement || header->llc_replacement != (uint32_t) (config.llc.enabled ? config.llc.replacement : 0)) {
+		std::cout << "The checkpoint was taken with other replacement policies" << std::endl;
+		return false;
+	}
+	const LLCConfig& llc = config.llc;
+	return same("cores", header->cores, config.cores)
+		&& same("set bits", header->set_bits, config.geometry.set_bits)
+		&& same("ways", header->associativity, config.geometry.associativity)
+		&& same("offset bits", header->offset_bits, config.geometry.offset_bits)
+		&& same("bus banks", header->bus_banks, config.bus_banks)
+		&& same("LLC enabled", header->llc_enabled, llc.enabled)
+		&& (!llc.enabled || (same("LLC inclusive", header->llc_inclusive, llc.inclusive)
+			&& same("LLC banks", header->llc_banks, llc.banks)
+			&& same("LLC set bits", header->llc_set_bits, llc.set_bits)
+			&& same("LLC ways", header->llc_associativity, llc.associativity)));
+}
+
+// Points the sets at the arrays of the checkpoint, and frees the arrays they had
+static void attachStores(std::vector<CacheSet>& sets, std::vector<unsigned long long>& tag_store,
+	std::vector<CacheBlockState>& state_store, std::vector<unsigned char>& repl_store, CheckpointCursor& cursor) {
+	size_t ways = sets[0].ways;
+	unsigned long long* tags = (unsigned long long*) cursor.take(sets.size() * ways * sizeof(unsigned long long));
+	CacheBlockState* states = (CacheBlockState*) cursor.take(sets.size() * ways * sizeof(CacheBlockState));
+	unsigned char* repl = (unsigned char*) cursor.take(sets.size() * ways);
+	for (size_t i=0; i < sets.size(); i++) {
+		sets[i].tags = tags + i * ways;
+		sets[i].states = states + i * ways;
+		sets[i].repl = repl + i * ways;
+		sets[i].rebuild();
+	}
+	std::vector<unsigned long long>().swap(tag_store);
+	std::vector<CacheBlockState>().swap(state_store);
+	std::vector<unsigned char>().swap(repl_store);
+}
+
+void Checkpoint::restore(Simulator& sim) {
+	CheckpointCursor cursor(base);
+	cursor.take(sizeof(CheckpointHeader));
+
+	for (int i=0; i < sim.numCores(); i++) {
+		Cache& cache = *sim.caches[i];
+		for (int c=0; c < NUM_CACHE_COUNTERS; c++) {
+			*cacheCounters(cache, c) = cursor.takeCounter();
+		}
+		memcpy(&cache.replacement_state, cursor.take(sizeof(ReplacementState)), sizeof(ReplacementState));
+		attachStores(cache.sets, cache.tag_store, cache.state_store, cache.repl_store, cursor);
+	}
+
+	for (int c=0; c < NUM_BUS_COUNTERS; c++) {
+		*busCounters(*sim.bus, c) = cursor.takeCounter();
+	}
+	memcpy(sim.bus->banks.data(), cursor.take(sim.bus->banks.size() * sizeof(BusBank)), sim.bus->banks.size() * sizeof(BusBank));
+
+	// The snoop filter is not saved but rebuilt from the caches, so a checkpoint
+	// taken without one can be restored with one
+	for (int c=0; c < NUM_SNOOP_FILTER_COUNTERS; c++) {
+		unsigned long long value = cursor.takeCounter();
+		if (sim.snoop_filter != NULL) {
+			*snoopFilterCounters(*sim.snoop_filter, c) = value;
+		}
+	}
+	if (sim.snoop_filter != NULL) {
+		for (int i=0; i < sim.numCores(); i++) {
+			Cache& cache = *sim.caches[i];
+			for (size_t set=0; set < cache.sets.size(); set++) {
+				const CacheSet& cache_set = cache.sets[set];
+				for (int way=0; way < cache_set.ways; way++) {
+					if (cache_set.states[way] != CacheBlockState::Invalid) {
+						sim.snoop_filter->addSharer(cache.geometry.blockAddress(cache_set.tags[way], set), cache.id);
+					}
+				}
+			}
+		}
+	}
+
+	if (sim.llc != NULL) {
+		for (size_t b=0; b < sim.llc->banks.size(); b++) {
+			LLCBank& bank = *sim.llc->banks[b];
+			for (int c=0; c < NUM_LLC_COUNTERS; c++) {
+				*llcCounters(bank, c) = cursor.takeCounter();
+			}
+			memcpy(&bank.replacement_state, cursor.take(sizeof(ReplacementState)), sizeof(ReplacementState));
+			attachStores(bank.sets, bank.tag_store, bank.state_store, bank.repl_store, cursor);
+		}
+	}
+
+	sim.resumeAfter(header->position);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "config.h"
+#include "simulator.h"
+
+// Checkpoint layout: one CheckpointHeader, then every section 8-byte aligned:
+//  - per cache: its counters, its ReplacementState and its tag, state and replacement arrays
+//  - the bus counters and its BusBanks
+//  - the snoop filter counters (zero without a snoop filter)
+//  - per LLC bank: its counters, its ReplacementState and its arrays
+// The arrays are laid out exactly as in memory, so a restore maps them in place
+#define CHECKPOINT_MAGIC 0x504b4346 // "FCKP"
+#define CHECKPOINT_VERSION 1
+
+struct CheckpointHeader {
+	uint32_t magic;
+	uint32_t version;
+
+	// Accesses of the trace simulated before the checkpoint
+	uint64_t position;
+
+	// The configuration the state belongs to; a restore must use the same one
+	uint32_t protocol;
+	uint32_t cores;
+	uint32_t set_bits, associativity, offset_bits, replacement;
+	uint32_t bus_banks;
+	uint32_t llc_enabled, llc_inclusive, llc_banks, llc_set_bits, llc_associativity, llc_replacement;
+
+	// Sizes of the structures written as they are, which differ between builds
+	uint32_t state_size, bus_bank_size, replacement_state_size;
+};
+
+// Writes the whole state of sim, position accesses into the trace, to path
+// Returns false (after printing the reason) if the file cannot be written
+bool saveCheckpoint(const char* path, Simulator& sim, const SimConfig& config, uint64_t position);
+
+// A checkpoint mapped copy-on-write: after restore, the caches and LLC banks work
+// directly on the mapped arrays, so restoring copies only the counters
+// The Checkpoint must outlive the Simulator it restored
+class Checkpoint {
+	public:
+		const CheckpointHeader* header;
+
+		Checkpoint();
+		~Checkpoint();
+
+		// Maps the checkpoint at path and validates its header
+		// Returns false (and prints the reason) if the file is not a usable checkpoint
+		bool open(const char* path);
+
+		// Returns false (and prints the reason) if the state does not fit a simulator
+		// of the protocol and config given
+		bool matches(Protocol protocol, const SimConfig& config);
+
+		// Puts sim, which must match, in the saved state, with its accesses numbered from
+		// the position of the checkpoint
+		void restore(Simulator& sim);
+
+	private:
+		int fd;
+		void* base;
+		size_t length;
+};
@@ -2,880 +2,422 @@
 #include "cache.h"
 #include "cacheset.h"
 #include "request.h"
+#include "protocol.h"
 
 /*
-The only difference in coding between the MSI and MESI protocols is,
-In MSI, on reading a "new" cache block, the block is always set to Shared State.
-In MESI, on reading a "new" cache block, if other cores have it, it is set to Shared State, else it goes to Exclusive State.
+The protocols differ only in their ProtocolTable (see protocol.h).
+For example, the only difference between the MSI and MESI tables is that
+in MSI, on reading a "new" cache block, the block is always set to Shared State, while
+in MESI, on reading a "new" cache block, if other cores have it, it is set to Shared State, else it goes to Exclusive State.
+
+The handlers below are instantiated once per protocol, so the table of the
+protocol is a compile time constant and there is no protocol dispatch per access.
 */
 
 // This function handles the Bus requests coming from other cores
-void Cache::handleBusRequest(BusRequest request, unsigned long long block_address) 
+template <Protocol P>
+void Cache::busRequest(BusRequest request, unsigned long long block_address)
 {
 	CacheBlockState BlockState = getState(block_address);
 
-	// for all BusRd requests
-	if(request == BusRequest::BusRd)
+	// No protocol reacts to requests for blocks it does not hold
+	if (BlockState == CacheBlockState::Invalid)
 	{
-		if(protocol == Protocol::MESI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Shared);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					bus->setSharedLine();
-					bus->setSupplied();
-					num_writebacks++;  // when Modified state receives BsRd, we write-back to LLC before supplying
-					num_provided++; // or should it be fromLLC?
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Shared);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSharedLine();
-					bus->setSupplied();
-					num_provided++;
-					break;
-				case CacheBlockState::Shared:
-					bus->setSharedLine();
-					if(bus->getSupplied() == false) // random Shared block will supply
-					{
-						bus->setSupplied();
-						bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-						num_provided++;
-						num_random++;
-					}
-					break;
-				case CacheBlockState::Invalid:
-					break;
-			}
-		}
-		else if(protocol == Protocol::MSI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Shared);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					bus->setSupplied();
-					num_writebacks++;  // when Modified state receives BsRd, we write-back to LLC before supplying
-					num_provided++; // or should it be fromLLC?
-					break;
-				case CacheBlockState::Shared:
-					if(bus->getSupplied() == false) // assume Random allocation is there in MSI too.
-					{
-						bus->setSupplied();
-						bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-						num_provided++;
-						num_random++;
-					}
-					break;
-				case CacheBlockState::Invalid:
-					break;
-			}	
-		}
-		else if(protocol == Protocol::MESIF)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Shared);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					bus->setSharedLine();
-					bus->setSupplied();
-					num_writebacks++;  // when Modified state receives BsRd, we write-back to LLC before supplying
-					num_provided++; // or should it be FromLLC?
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Shared);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSharedLine();
-					bus->setSupplied();
-					num_provided++;
-					break;
-				case CacheBlockState::Shared: // if only S without F is there, it won't supply the block
-					bus->setSharedLine();
-					break;
-				case CacheBlockState::Invalid:
-					break;
-				case CacheBlockState::Forward:
-					setState(block_address, CacheBlockState::Shared);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSharedLine(); // will set the shared line, no separate "forwarded line"
-					bus->setSupplied();
-					num_provided++;
-					break;
-			}
-		}
-		else if(protocol == Protocol::MOESI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Owned);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSharedLine(); // not needed?
-					bus->setSupplied();
-					// no write-back
-					num_provided++;
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Shared);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSharedLine();
-					bus->setSupplied();
-					num_provided++;
-					break;
-				case CacheBlockState::Shared:
-					bus->setSharedLine();
-					break;
-				case CacheBlockState::Invalid:
-					break;
-				case CacheBlockState::Owned:
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSharedLine(); // will set the shared line, no separate "owned line"
-					bus->setSupplied();
-					num_provided++;
-					break;
-			}
-		}
-		else // the new protocol
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Forward:
-					setState(block_address, CacheBlockState::Shared);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSharedLine();
-					bus->setSupplied();
-					// no write-back
-					num_provided++;
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Shared);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSharedLine();
-					bus->setSupplied();
-					num_provided++;
-					break;
-				case CacheBlockState::Shared:
-					// no need to set "Shared Line" because it will never be required
-					// save on bus transaction !!
-					break;
-				case CacheBlockState::Invalid:
-					break;
-			}
-		}
+		return;
 	}
-	// handling BsRdX requests
-	// we will assume that even during Write operations, the block needs to be supplied. 
-	else if(request == BusRequest::BusRdX)
+
+	const Transition& transition = PROTOCOL_TABLES[P].snoop[request][BlockState];
+	unsigned effects = transition.effects;
+
+	if (transition.next != KeepState)
 	{
-		if(protocol == Protocol::MESI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Invalid);					
-					bus->sendMessage(BusRequest::Flush, block_address, id); 
-					bus->setSupplied();
-					num_writebacks++;   // when Modified state receives BsRdX, we write-back to LLC (almost useless operation) 
-					num_invalidations++;
-					num_provided++;
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSupplied();
-					num_provided++;
-					num_invalidations++;
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					num_invalidations++;
-					if(bus->getSupplied() == false) // assume Random allocation is there in MSI too.
-					{
-						bus->setSupplied();
-						bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-						num_provided++;
-						num_random++;
-					}
-					break;
-				case CacheBlockState::Invalid:
-					break;
-			}
-		}
-		else if(protocol == Protocol::MSI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->setSupplied();
-					bus->sendMessage(BusRequest::Flush, block_address, id); 
-					num_writebacks++;   // when Modified state receives BsRdX, we write-back to LLC (almost useless operation) 
-					num_invalidations++;
-					num_provided++;
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					if(bus->getSupplied() == false) // assume Random allocation is there in MSI too.
-					{
-						bus->setSupplied();
-						bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-						num_provided++;
-						num_random++;
-					}
-					break;
-				case CacheBlockState::Invalid:
-					break;
-			}
-		}
-		else if(protocol == Protocol::MESIF)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					bus->setSupplied();
-					num_invalidations++;
-					num_writebacks++;  // when Modified state receives BsRd, we write-back to LLC before supplying
-					num_provided++;
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSupplied();
-					num_invalidations++;
-					num_provided++;
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Invalid:
-					break;
-				case CacheBlockState::Forward:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSupplied();
-					num_provided++;
-					num_invalidations++;
-					break;
-			}
-		}
-		else if(protocol == Protocol::MOESI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					bus->setSupplied();
-					num_writebacks++;  // when Modified state receives BsRd, we write-back to LLC before supplying
-					num_provided++; // or should it be FromLLC?
-					num_invalidations++;
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSupplied();
-					num_invalidations++;
-					num_provided++;
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Invalid:
-					break;
-				case CacheBlockState::Owned:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					bus->setSupplied();
-					num_writebacks++;
-					num_provided++; // or should it be from the LLC?
-					num_invalidations++;
-					break;
-			}
-		}
-		else // the new protocol
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Forward:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSupplied();
-					num_invalidations++;
-					num_provided++;
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush_prime, block_address, id);
-					bus->setSupplied();
-					num_invalidations++;
-					num_provided++;
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Invalid:
-					break;
-			}
-		}
+		setState(block_address, (CacheBlockState) transition.next);
 	}
-	else if(request == BusRequest::BusUpgr)
+	if (effects & SendFlush)
 	{
-		if(protocol == Protocol::MESI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					bus->sendMessage(BusRequest::Flush, block_address, id); 
-					num_writebacks++;   // when Modified state receives BsRdX, we write-back to LLC (almost useless operation) 
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;					
-					break;
-				case CacheBlockState::Invalid:
-					break;
-			}
-		}
-		else if(protocol == Protocol::MSI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					bus->sendMessage(BusRequest::Flush, block_address, id); 
-					num_writebacks++;   // when Modified state receives BsRdX, we write-back to LLC (almost useless operation) 
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;					
-					break;
-				case CacheBlockState::Invalid:
-					break;
-			}
-		}
-		else if(protocol == Protocol::MESIF)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					num_invalidations++;
-					num_writebacks++;  // when Modified state receives BsUpgr, we write-back to LLC before invalidating
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Invalid:
-					break;
-				case CacheBlockState::Forward:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-			}
-		}
-		else if(protocol == Protocol::MOESI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					num_invalidations++;
-					num_writebacks++;  // when Modified state receives BsUpgr, we write-back to LLC before invalidating
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Invalid:
-					break;
-				case CacheBlockState::Owned:					
-					setState(block_address, CacheBlockState::Invalid);
-					bus->sendMessage(BusRequest::Flush, block_address, id);
-					num_invalidations++;
-					num_writebacks++; // when Modified state receives BsUpgr, we write-back to LLC before invalidating
-					break;
-			}
-		}
-		else // the new protocol
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Forward:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Exclusive:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Shared:
-					setState(block_address, CacheBlockState::Invalid);
-					num_invalidations++;
-					break;
-				case CacheBlockState::Invalid:
-					break;
-			}
-		}
-	}	
-	else // setF
-	// this Bus Transaction happens only for the new protocol
+		bus->sendMessage(BusRequest::Flush, block_address, id);
+	}
+	if (effects & SendFlushPrime)
 	{
-		if (BlockState == CacheBlockState::Shared)
-		{			
-			if(bus->getSupplied() == false) // F hasn't been allocated to any block yet
-			{
-				bus->setSupplied();
-				setState(block_address, CacheBlockState::Forward);
-				num_random++;		
-			}				
-		}
+		bus->sendMessage(BusRequest::Flush_prime, block_address, id);
+	}
+	if (effects & RaiseShared)
+	{
+		bus->setSharedLine(block_address);
+	}
+	if (effects & RaiseSupplied)
+	{
+		bus->setSupplied(block_address);
+	}
+	if (effects & CountWriteback)
+	{
+		num_writebacks++;
+		bus->outcome.writebacks++;
+	}
+	if (effects & CountInvalidation)
+	{
+		num_invalidations++;
+		bus->outcome.invalidations++;
+	}
+	if (effects & CountProvided)
+	{
+		num_provided++;
+	}
+	if ((effects & SupplyIfUnsupplied) && bus->getSupplied(block_address) == false) // random Shared block will supply
+	{
+		bus->setSupplied(block_address);
+		bus->sendMessage(BusRequest::Flush_prime, block_address, id);
+		num_provided++;
+		num_random++;
+	}
+	if ((effects & TakeFIfUnsupplied) && bus->getSupplied(block_address) == false) // F hasn't been allocated to any block yet
+	{
+		bus->setSupplied(block_address);
+		setState(block_address, CacheBlockState::Forward);
+		num_random++;
 	}
 }
 
 // This function handles the memory requests coming from the processor
-void Cache::handleProcRequest(ProcRequest request, unsigned long long address) 
+template <Protocol P>
+void Cache::procRequest(ProcRequest request, unsigned long long address)
 {
-	unsigned long long blockAddress = address >> CACHE_OFFSET_BITS;
-	
-	int set_Address = blockAddress & ((1 << SET_BITS) - 1);
+	const ProtocolTable& table = PROTOCOL_TABLES[P];
+
+	unsigned long long blockAddress = geometry.blockAddressOf(address);
 
 	CacheBlockState BlockState = getState(blockAddress);
 
+	AccessOutcome& outcome = bus->outcome;
+	outcome.reset();
+
 	if(request == ProcRequest::ProcRd)
 	{
 		num_reads++;
+	}
+	else
+	{
+		num_writes++;
+	}
 
-		if(protocol == Protocol::MESI)
+	if(BlockState != CacheBlockState::Invalid)
+	{
+		const Transition& transition = table.hit[request][BlockState];
+		outcome.hit = true;
+		moveToMRU(blockAddress);
+		if (transition.next != KeepState)
 		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Exclusive:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRd, blockAddress, id);
-					bool shared_state = bus->getSharedLine();
-					bool supplied = bus->getSupplied();
-					
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Shared);
-					if( shared_state == false )
-					{
-						setState(blockAddress, CacheBlockState::Exclusive); // need to change to E from S
-					}
-					if( supplied == false ) 	
-					{
-						num_fromLLC++;
-					}
-					 	
-					if(evictedBlock.state == CacheBlockState::Modified)
-					{					
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-						num_writebacks++;
-					}				
-					num_read_misses++;
-					break;
-			}
+			setState(blockAddress, (CacheBlockState) transition.next);
 		}
-		else if(protocol == Protocol::MSI)
+		if (transition.effects & SendBusUpgr)
 		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRd, blockAddress, id);
-					bool supplied = bus->getSupplied();
-					
-					if( supplied == false )
-					{
-						num_fromLLC++;
-					}
-					
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Shared);
-					
-					if(evictedBlock.state == CacheBlockState::Modified)
-					{					
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-						num_writebacks++;
-					}				
-					num_read_misses++;
-					break;
-			}
+			outcome.upgrade = true;
+			bus->sendMessage(BusRequest::BusUpgr, blockAddress, id);
 		}
-		else if(protocol == Protocol::MESIF)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Exclusive:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Forward:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRd, blockAddress, id);
-					bool shared_state = bus->getSharedLine();
-					bool supplied = bus->getSupplied();
-
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Forward);
-					if( shared_state == false )
-					{
-						setState(blockAddress, CacheBlockState::Exclusive); // need to change to F from E
-					}	
+		return;
+	}
 
-					if( supplied == false )
-					{
-						num_fromLLC++;
-					}		
-					 	
-					if(evictedBlock.state == CacheBlockState::Modified)
-					{					
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-						num_writebacks++;
-					}				
-					num_read_misses++;
-					break;				
-			}
-		}
-		else if(protocol == Protocol::MOESI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Owned:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Exclusive:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRd, blockAddress, id);
-					bool shared_state = bus->getSharedLine();
-					bool supplied = bus->getSupplied();					
-					
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Shared);
-					if( shared_state == false )
-					{
-						setState(blockAddress, CacheBlockState::Exclusive); // need to change to E from S
-					}			
-					 	
-					if( supplied == false )
-					{
-						num_fromLLC++;
-					}	
-					
-					if( (evictedBlock.state == CacheBlockState::Modified) || (evictedBlock.state == CacheBlockState::Owned) )
-					{					
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-						num_writebacks++;
-					}				
-					num_read_misses++;
-					break;				
-			}
-		}
-		else // the new protocol
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Forward:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Exclusive:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRd, blockAddress, id);
-					bool shared_state = bus->getSharedLine();
-					bool supplied = bus->getSupplied();
-					
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Forward);
-					if( shared_state == false )
-					{
-						setState(blockAddress, CacheBlockState::Exclusive); // need to change to E from F
-					}	
+	if (missRequest<P, false>(request == ProcRequest::ProcRd ? BusRequest::BusRd : BusRequest::BusRdX, blockAddress) == false)
+	{
+		num_fromLLC++;
+	}
 
-					if( supplied == false )
-					{
-						num_fromLLC++;
-					}		
-					 	
-					if( (evictedBlock.state == CacheBlockState::Forward) )
-					{					
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::setF, evicted_blockAddress, id);
-						// whether write_back happens or not depends on whether we are able to allocate F to someone else
-						bool allocated = bus->getSupplied();
-						if(allocated == false)
-						{
-							bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-							num_writebacks++;
-						}
-					}				
-					num_read_misses++;
-					break;
-			}
-		}
+	if(request == ProcRequest::ProcRd)
+	{
+		num_read_misses++;
 	}
 	else
 	{
-		num_writes++;
+		num_write_misses++;
+	}
+}
 
-		if(protocol == Protocol::MESI)
-		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Exclusive:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Modified);
-					break;
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Modified);
-					bus->sendMessage(BusRequest::BusUpgr, blockAddress, id);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRdX, blockAddress, id);
-					bool supplied = bus->getSupplied();
-
-					if( supplied == false )
-					{
-						num_fromLLC++;
-					}
+// Reads a block ahead of the processor: the miss path of procRequest for a read, without
+// the counters of the processor access, as no access was made
+template <Protocol P>
+bool Cache::prefetchRequest(unsigned long long blockAddress)
+{
+	if (getState(blockAddress) != CacheBlockState::Invalid)
+	{
+		return false;
+	}
+	bus->outcome.reset();
+	missRequest<P, false>(BusRequest::BusRd, blockAddress);
+	return true;
+}
 
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Modified);
+/*
+Functional warming (see Sampler) makes the same state changes as the handlers above,
+in the same order, but counts nothing. Every cache is snooped on every miss, so the
+snoop is kept in this file where it can be inlined: the bus calls the handler of the
+protocol directly, and the set is searched in place.
+*/
 
-					// we will decide if num_provided or num_fromLLC based on bus response (from other cores)
+// Returns the state of the block with the tag in the set, without branching on the tags
+// Ways is the associativity of the set, or 0 for any
+template <int Ways>
+static inline CacheBlockState warmLookup(const CacheSet& set, unsigned long long tag)
+{
+	int ways = Ways ? Ways : set.ways;
+	CacheBlockState state = CacheBlockState::Invalid;
+	for (int way=0; way < ways; way++)
+	{
+		state = (set.tags[way] == tag && set.states[way] != CacheBlockState::Invalid) ? set.states[way] : state;
+	}
+	return state;
+}
 
-					if(evictedBlock.state == CacheBlockState::Modified)
-					{
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-						num_writebacks++;
-					}				
-					num_write_misses++;
-					break;
-			}
+// Snoops every cache but the sender; the caches all have the same geometry,
+// so the set and tag are worked out once
+template <Protocol P, int Ways>
+static void warmSnoop(Bus& bus, BusRequest request, unsigned long long block_address, int sender_cache_id)
+{
+	const CacheGeometry& geometry = bus.caches[0]->geometry;
+	int set = geometry.setIndex(block_address);
+	unsigned long long tag = geometry.tag(block_address);
+	int num_caches = bus.caches.size();
+	for (int i=0; i < num_caches; i++)
+	{
+		Cache* cache = bus.caches[i];
+		CacheBlockState state = warmLookup<Ways>(cache->sets[set >> cache->shard_bits], tag);
+		if (state != CacheBlockState::Invalid && i != sender_cache_id)
+		{
+			cache->warmBusRequest<P>(request, block_address, state);
 		}
-		else if(protocol == Protocol::MSI)
+	}
+}
+
+template <Protocol P>
+void Bus::warmMessage(BusRequest request, unsigned long long block_address, int sender_cache_id)
+{
+	if (request == BusRequest::Flush && llc != NULL)
+	{
+		llc->warmWriteback(block_address);
+	}
+	if (request == BusRequest::Flush || request == BusRequest::Flush_prime)
+	{
+		return;
+	}
+
+	BusBank& bank = banks[bankIndex(block_address)];
+	bank.shared_line = false;
+	bank.supplied = false;
+
+	if (snoop_filter != NULL)
+	{
+		if (snoop_filter->getSharers(block_address, sharers.data()))
 		{
-			switch (BlockState)
+			for (int w=0; w < snoop_filter->words; w++)
 			{
-				case CacheBlockState::Modified:
-					moveToMRU(blockAddress);
-					break;				
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Modified);
-					bus->sendMessage(BusRequest::BusUpgr, blockAddress, id);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRdX, blockAddress, id);
-					bool supplied = bus->getSupplied();
-
-					if( supplied == false )
+				uint64_t bits = sharers[w];
+				while (bits != 0)
+				{
+					int i = w * 64 + __builtin_ctzll(bits);
+					bits &= bits - 1;
+					CacheBlockState state = caches[i]->getState(block_address);
+					if (i != sender_cache_id && state != CacheBlockState::Invalid)
 					{
-						num_fromLLC++;
+						caches[i]->warmBusRequest<P>(request, block_address, state);
 					}
+				}
+			}
+		}
+		return;
+	}
+
+	switch (caches[0]->geometry.associativity)
+	{
+		case 1:
+			return warmSnoop<P, 1>(*this, request, block_address, sender_cache_id);
+		case 2:
+			return warmSnoop<P, 2>(*this, request, block_address, sender_cache_id);
+		case 4:
+			return warmSnoop<P, 4>(*this, request, block_address, sender_cache_id);
+		case 8:
+			return warmSnoop<P, 8>(*this, request, block_address, sender_cache_id);
+		case 16:
+			return warmSnoop<P, 16>(*this, request, block_address, sender_cache_id);
+	}
+	warmSnoop<P, 0>(*this, request, block_address, sender_cache_id);
+}
 
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Modified);
-					
-					// we will decide if num_provided or num_fromLLC based on bus response (from other cores)
+// Handles a snooped request for a block the cache holds in BlockState
+template <Protocol P>
+void Cache::warmBusRequest(BusRequest request, unsigned long long block_address, CacheBlockState BlockState)
+{
+	const Transition& transition = PROTOCOL_TABLES[P].snoop[request][BlockState];
+	unsigned effects = transition.effects;
+	BusBank& bank = bus->banks[bus->bankIndex(block_address)];
 
-					if(evictedBlock.state == CacheBlockState::Modified)
-					{
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-						num_writebacks++;
-					}				
-					num_write_misses++;
-					break;
-			}
+	if (transition.next != KeepState)
+	{
+		setState(block_address, (CacheBlockState) transition.next);
+	}
+	if (effects & SendFlush)
+	{
+		bus->warmMessage<P>(BusRequest::Flush, block_address, id);
+	}
+	if (effects & RaiseShared)
+	{
+		bank.shared_line = true;
+	}
+	if (effects & (RaiseSupplied | SupplyIfUnsupplied))
+	{
+		bank.supplied = true;
+	}
+	if ((effects & TakeFIfUnsupplied) && bank.supplied == false)
+	{
+		bank.supplied = true;
+		setState(block_address, CacheBlockState::Forward);
+	}
+}
+
+template <Protocol P>
+void Cache::warmProcRequest(ProcRequest request, unsigned long long address)
+{
+	const ProtocolTable& table = PROTOCOL_TABLES[P];
+
+	unsigned long long blockAddress = geometry.blockAddressOf(address);
+	CacheBlockState BlockState = getState(blockAddress);
+
+	if (BlockState != CacheBlockState::Invalid)
+	{
+		const Transition& transition = table.hit[request][BlockState];
+		moveToMRU(blockAddress);
+		if (transition.next != KeepState)
+		{
+			setState(blockAddress, (CacheBlockState) transition.next);
 		}
-		else if(protocol == Protocol::MESIF)
+		if (transition.effects & SendBusUpgr)
 		{
-			switch (BlockState)
-			{
-				case CacheBlockState::Modified:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Exclusive:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Modified);
-					break;
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Modified);
-					bus->sendMessage(BusRequest::BusUpgr, blockAddress, id);
-					break;
-				case CacheBlockState::Forward:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Modified);
-					bus->sendMessage(BusRequest::BusUpgr, blockAddress, id);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRdX, blockAddress, id);
-					bool supplied = bus->getSupplied();
-
-					if( supplied == false )
-					{
-						num_fromLLC++;
-					}
+			bus->warmMessage<P>(BusRequest::BusUpgr, blockAddress, id);
+		}
+		return;
+	}
 
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Modified);
-					
-					// we will decide if num_provided or num_fromLLC based on bus response (from other cores)
+	missRequest<P, true>(request == ProcRequest::ProcRd ? BusRequest::BusRd : BusRequest::BusRdX, blockAddress);
+}
 
-					if(evictedBlock.state == CacheBlockState::Modified)
-					{
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-						num_writebacks++;
-					}				
-					num_write_misses++;
-					break;				
-			}
+// The other caches decide through the shared and supplied lines whether the block is
+// shared and whether it comes from a cache or from the LLC
+template <Protocol P, bool Warm>
+bool Cache::missRequest(BusRequest request, unsigned long long blockAddress)
+{
+	const ProtocolTable& table = PROTOCOL_TABLES[P];
+	int set_Address = geometry.setIndex(blockAddress);
+
+	bool shared_state, supplied;
+	if (Warm)
+	{
+		bus->warmMessage<P>(request, blockAddress, id);
+		BusBank& bank = bus->banks[bus->bankIndex(blockAddress)];
+		shared_state = bank.shared_line;
+		supplied = bank.supplied;
+	}
+	else
+	{
+		bus->sendMessage(request, blockAddress, id);
+		shared_state = bus->getSharedLine(blockAddress);
+		supplied = bus->getSupplied(blockAddress);
+		bus->outcome.supplied = supplied;
+	}
+
+	CacheBlockState fill_state = table.write_fill;
+	if(request == BusRequest::BusRd)
+	{
+		fill_state = shared_state ? table.read_fill_shared : table.read_fill_alone;
+	}
+	CacheBlock evictedBlock = insertCacheBlock(blockAddress, fill_state);
+
+	if (supplied == false && bus->llc != NULL)
+	{
+		if (Warm)
+		{
+			bus->llc->warmRead(blockAddress);
 		}
-		else if(protocol == Protocol::MOESI)
+		else
 		{
-			switch (BlockState)
+			bus->outcome.dram = !bus->llc->read(blockAddress);
+		}
+	}
+
+	unsigned long long evicted_blockAddress = geometry.blockAddress(evictedBlock.tag, set_Address);
+	bool writeback = false;
+	switch (table.victim[evictedBlock.state])
+	{
+		case VictimAction::DropVictim:
+			break;
+		case VictimAction::WritebackVictim:
+			writeback = true;
+			break;
+		case VictimAction::HandOffF:
+			// whether write_back happens or not depends on whether we are able to allocate F to someone else
+			if (Warm)
 			{
-				case CacheBlockState::Modified:
-					moveToMRU(blockAddress);
-					break;
-				case CacheBlockState::Owned:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Modified);
-					bus->sendMessage(BusRequest::BusUpgr, blockAddress, id);
-					break;
-				case CacheBlockState::Exclusive:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Modified);
-					break;
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Modified);
-					bus->sendMessage(BusRequest::BusUpgr, blockAddress, id);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRdX, blockAddress, id);
-					bool supplied = bus->getSupplied();
-					if( supplied == false )
-					{
-						num_fromLLC++;
-					}
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Modified);
-					if( (evictedBlock.state == CacheBlockState::Modified) || (evictedBlock.state == CacheBlockState::Owned) )
-					{
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-						num_writebacks++;
-					}				
-					num_write_misses++;
-					break;				
+				bus->warmMessage<P>(BusRequest::setF, evicted_blockAddress, id);
+				writeback = bus->banks[bus->bankIndex(evicted_blockAddress)].supplied == false;
 			}
-		}
-		else // the new protocol
-		{
-			switch (BlockState)
+			else
 			{
-				case CacheBlockState::Forward:
-					moveToMRU(blockAddress);
-					bus->sendMessage(BusRequest::BusUpgr, blockAddress, id);
-					break;
-				case CacheBlockState::Exclusive:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Forward);
-					break;
-				case CacheBlockState::Shared:
-					moveToMRU(blockAddress);
-					setState(blockAddress, CacheBlockState::Forward);
-					bus->sendMessage(BusRequest::BusUpgr, blockAddress, id);
-					break;
-				case CacheBlockState::Invalid:
-					bus->sendMessage(BusRequest::BusRdX, blockAddress, id);
-					bool supplied = bus->getSupplied();
-					// we will decide if num_provided or num_fromLLC based on bus response (from other cores)
-					if( supplied == false )
-					{
-						num_fromLLC++;
-					}
-					CacheBlock evictedBlock = insertCacheBlock(blockAddress, CacheBlockState::Forward);
-	
-					if(evictedBlock.state == CacheBlockState::Forward)
-					{
-						unsigned long long evicted_blockAddress = (evictedBlock.tag << SET_BITS) + set_Address;
-						bus->sendMessage(BusRequest::setF, evicted_blockAddress, id);
-						// whether write_back happens or not depends on whether we are able to allocate F to someone else
-						bool allocated = bus->getSupplied();
-						if(allocated == false)
-						{
-							bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
-							num_writebacks++;
-						}
-					}				
-					num_write_misses++;
-					break;
+				bus->sendMessage(BusRequest::setF, evicted_blockAddress, id);
+				writeback = bus->getSupplied(evicted_blockAddress) == false;
 			}
+			break;
+	}
+	if (writeback)
+	{
+		if (Warm)
+		{
+			bus->warmMessage<P>(BusRequest::Flush, evicted_blockAddress, id);
+		}
+		else
+		{
+			bus->sendMessage(BusRequest::Flush, evicted_blockAddress, id);
+			num_writebacks++;
+			bus->outcome.writebacks++;
 		}
 	}
-}
\ No newline at end of file
+	return supplied;
+}
+
+bool Cache::needsBus(ProcRequest request, unsigned long long address)
+{
+	CacheBlockState BlockState = getState(geometry.blockAddressOf(address));
+	if (BlockState == CacheBlockState::Invalid)
+	{
+		return true;
+	}
+	return (PROTOCOL_TABLES[protocol].hit[request][BlockState].effects & SendBusUpgr) != 0;
+}
+
+// Points the request handlers at the instantiations for the protocol of the cache
+template <Protocol P>
+static void bindHandlers(Cache& cache)
+{
+	cache.proc_handler = &Cache::procRequest<P>;
+	cache.bus_handler = &Cache::busRequest<P>;
+	cache.warm_proc_handler = &Cache::warmProcRequest<P>;
+	cache.prefetch_handler = &Cache::prefetchRequest<P>;
+}
+
+void Cache::bindProtocol()
+{
+	switch (protocol)
+	{
+		case Protocol::MSI:
+			bindHandlers<Protocol::MSI>(*this);
+			break;
+		case Protocol::MESI:
+			bindHandlers<Protocol::MESI>(*this);
+			break;
+		case Protocol::MESIF:
+			bindHandlers<Protocol::MESIF>(*this);
+			break;
+		case Protocol::MOESI:
+			bindHandlers<Protocol::MOESI>(*this);
+			break;
+		case Protocol::FESI:
+			bindHandlers<Protocol::FESI>(*this);
+			break;
+	}
+}
@@ -0,0 +1,745 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "protocol.h"
+#include "config.h"
+#include "bus.h"
+#include "shard.h"
+#include "shmring.h"
+
+SimConfig::SimConfig() {
+	cores = DEFAULT_NUMBER_OF_CORES;
+	geometry = CacheGeometry();
+	snoop_filter = false;
+	directory = false;
+	replacement = ReplacementPolicy::LRU;
+	bus_banks = 1;
+	report_latency = false;
+	timed_bus = false;
+	convert_compact = false;
+	l1_set_bits = 0;
+	l1_ways = 0;
+	checkpoint_at = 0;
+	use_workload = false;
+	protocol = Protocol::FESI;
+	threads = std::thread::hardware_concurrency();
+	if (threads < 1) {
+		threads = 1;
+	}
+	shards = 1;
+	shm_timeout = DEFAULT_SHM_TIMEOUT;
+}
+
+// Returns log2(value), or -1 if value is not a power of two
+static int log2Exact(long long value) {
+	if (value <= 0 || (value & (value - 1)) != 0) {
+		return -1;
+	}
+	int bits = 0;
+	while ((1LL << bits) < value) {
+		bits++;
+	}
+	return bits;
+}
+
+static bool parseProtocolList(const std::string& list, std::vector<Protocol>& protocols) {
+	if (list == "all") {
+		protocols = {Protocol::MSI, Protocol::MESI, Protocol::MESIF, Protocol::MOESI, Protocol::FESI};
+		return true;
+	}
+	std::istringstream in(list);
+	std::string name;
+	while (std::getline(in, name, ',')) {
+		Protocol protocol;
+		if (!protocolFromName(name, protocol)) {
+			std::cout << "Unknown protocol " << name << std::endl;
+			return false;
+		}
+		protocols.push_back(protocol);
+	}
+	return !protocols.empty();
+}
+
+static bool parseGeometryList(const std::string& list, int block_size, std::vector<CacheGeometry>& geometries) {
+	std::istringstream in(list);
+	std::string item;
+	while (std::getline(in, item, ',')) {
+		long long sets = 0, ways = 0, block = block_size;
+		char x1 = 'x', x2 = 'x';
+		std::istringstream fields(item);
+		fields >> sets >> x1 >> ways;
+		if (!fields.eof()) {
+			fields >> x2 >> block;
+		}
+		int set_bits = log2Exact(sets);
+		int offset_bits = log2Exact(block);
+		if (fields.fail() || !fields.eof() || x1 != 'x' || x2 != 'x' || set_bits < 0 || set_bits > 30
+			|| ways < 1 || ways > MAX_ASSOCIATIVITY || offset_bits < 0 || offset_bits > 30) {
+			std::cout << "Bad geometry '" << item << "', expected SETSxWAYS[xBLOCKSIZE] with power of two sets and block size" << std::endl;
+			return false;
+		}
+		geometries.push_back(CacheGeometry(set_bits, ways, offset_bits));
+	}
+	return !geometries.empty();
+}
+
+static bool parseNumber(const std::string& option, const std::string& value, long long& number) {
+	std::istringstream in(value);
+	if (!(in >> number) || !in.eof()) {
+		std::cout << "Option " << option << " expects a number, got '" << value << "'" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+static bool parseFraction(const std::string& option, const std::string& value, double low, double high, double& fraction) {
+	std::istringstream in(value);
+	if (!(in >> fraction) || !in.eof() || fraction < low || fraction > high) {
+		std::cout << "Option " << option << " expects a number between " << low << " and " << high << ", got '" << value << "'" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Returns true for the on/off options, which take no value
+static bool isFlag(const std::string& option) {
+	return option == "snoop-filter" || option == "latency" || option == "timed-bus" || option == "sample" || option == "profile"
+		|| option == "no-block-dump" || option == "directory";
+}
+
+// Applies a single option with its value; option is given without the leading "--"
+static bool applyOption(const std::string& option, const std::string& value, SimConfig& config) {
+	long long number;
+	if (option == "cores") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1 || number > 65535) {
+			std::cout << "Number of cores must be between 1 and 65535" << std::endl;
+			return false;
+		}
+		config.cores = number;
+	} else if (option == "sets") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		int bits = log2Exact(number);
+		if (bits < 0 || bits > 30) {
+			std::cout << "Number of sets must be a power of two" << std::endl;
+			return false;
+		}
+		config.geometry = CacheGeometry(bits, config.geometry.associativity, config.geometry.offset_bits);
+	} else if (option == "ways") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1 || number > MAX_ASSOCIATIVITY) {
+			std::cout << "Associativity must be between 1 and " << MAX_ASSOCIATIVITY << std::endl;
+			return false;
+		}
+		config.geometry = CacheGeometry(config.geometry.set_bits, number, config.geometry.offset_bits);
+	} else if (option == "block-size") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		int bits = log2Exact(number);
+		if (bits < 0 || bits > 30) {
+			std::cout << "Block size must be a power of two" << std::endl;
+			return false;
+		}
+		config.geometry = CacheGeometry(config.geometry.set_bits, config.geometry.associativity, bits);
+	} else if (option == "sweep") {
+		config.sweep_protocols.clear();
+		return parseProtocolList(value, config.sweep_protocols);
+	} else if (option == "sweep-geometry") {
+		config.sweep_geometries.clear();
+		return parseGeometryList(value, config.geometry.blockSize(), config.sweep_geometries);
+	} else if (option == "threads") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1) {
+			std::cout << "Number of threads must be at least 1" << std::endl;
+			return false;
+		}
+		config.threads = number;
+	} else if (option == "shards") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (log2Exact(number) < 0 || number > MAX_SHARDS) {
+			std::cout << "Number of shards must be a power of two, at most " << MAX_SHARDS << std::endl;
+			return false;
+		}
+		config.shards = number;
+	} else if (option == "l1") {
+		long long sets = 0, ways = 0;
+		char x = 'x';
+		std::istringstream fields(value);
+		fields >> sets >> x >> ways;
+		int bits = log2Exact(sets);
+		if (fields.fail() || !fields.eof() || x != 'x' || bits < 0 || bits > 30 || ways < 1 || ways > MAX_ASSOCIATIVITY) {
+			std::cout << "Bad L1 '" << value << "', expected SETSxWAYS with a power of two sets" << std::endl;
+			return false;
+		}
+		config.l1_set_bits = bits;
+		config.l1_ways = ways;
+	} else if (option == "prefetch") {
+		if (!prefetchPolicyFromName(value, config.prefetch.policy)) {
+			std::cout << "Unknown prefetcher " << value << std::endl;
+			return false;
+		}
+	} else if (option == "prefetch-degree" || option == "prefetch-distance") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1 || number > 64) {
+			std::cout << "The prefetch " << (option == "prefetch-degree" ? "degree" : "distance") << " must be between 1 and 64" << std::endl;
+			return false;
+		}
+		if (option == "prefetch-degree") {
+			config.prefetch.degree = number;
+		} else {
+			config.prefetch.distance = number;
+		}
+	} else if (option == "snoop-filter") {
+		config.snoop_filter = true;
+	} else if (option == "latency") {
+		config.report_latency = true;
+	} else if (option == "hit-latency" || option == "c2c-latency" || option == "llc-latency" || option == "dram-latency"
+		|| option == "writeback-latency" || option == "invalidation-latency" || option == "l2-latency") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 0) {
+			std::cout << "Latencies cannot be negative" << std::endl;
+			return false;
+		}
+		if (option == "hit-latency") {
+			config.latency.hit = number;
+		} else if (option == "c2c-latency") {
+			config.latency.cache_to_cache = number;
+		} else if (option == "llc-latency") {
+			config.latency.llc = number;
+		} else if (option == "dram-latency") {
+			config.latency.dram = number;
+		} else if (option == "writeback-latency") {
+			config.latency.writeback = number;
+		} else if (option == "l2-latency") {
+			config.latency.l2 = number;
+		} else {
+			config.latency.invalidation = number;
+		}
+		config.report_latency = true;
+	} else if (option == "bus-banks") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (log2Exact(number) < 0 || number > MAX_BUS_BANKS) {
+			std::cout << "Number of bus banks must be a power of two up to " << MAX_BUS_BANKS << std::endl;
+			return false;
+		}
+		config.bus_banks = number;
+	} else if (option == "llc") {
+		if (value != "inclusive" && value != "non-inclusive") {
+			std::cout << "LLC must be inclusive or non-inclusive" << std::endl;
+			return false;
+		}
+		config.llc.enabled = true;
+		config.llc.inclusive = value == "inclusive";
+	} else if (option == "llc-banks" || option == "llc-sets") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		int bits = log2Exact(number);
+		if (bits < 0 || bits > 24) {
+			std::cout << "Number of LLC " << (option == "llc-banks" ? "banks" : "sets") << " must be a power of two" << std::endl;
+			return false;
+		}
+		if (option == "llc-banks") {
+			config.llc.banks = number;
+		} else {
+			config.llc.set_bits = bits;
+		}
+	} else if (option == "llc-ways") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1 || number > MAX_ASSOCIATIVITY) {
+			std::cout << "LLC associativity must be between 1 and " << MAX_ASSOCIATIVITY << std::endl;
+			return false;
+		}
+		config.llc.associativity = number;
+	} else if (option == "replacement" || option == "llc-replacement") {
+		ReplacementPolicy policy;
+		if (!policyFromName(value, policy)) {
+			std::cout << "Unknown replacement policy " << value << std::endl;
+			return false;
+		}
+		if (option == "replacement") {
+			config.replacement = policy;
+		} else {
+			config.llc.replacement = policy;
+		}
+	} else if (option == "timed-bus") {
+		config.timed_bus = true;
+	} else if (option == "arbitration") {
+		if (value == "fcfs") {
+			config.bus_timing.arbitration = Arbitration::FCFS;
+		} else if (value == "round-robin") {
+			config.bus_timing.arbitration = Arbitration::RoundRobin;
+		} else {
+			std::cout << "Arbitration must be fcfs or round-robin" << std::endl;
+			return false;
+		}
+	} else if (option == "address-cycles") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 0) {
+			std::cout << "Address phase cannot be negative" << std::endl;
+			return false;
+		}
+		config.bus_timing.address_cycles = number;
+	} else if (option == "bus-bandwidth") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1) {
+			std::cout << "Bus bandwidth must be at least 1 byte per cycle" << std::endl;
+			return false;
+		}
+		config.bus_timing.bandwidth = number;
+	} else if (option == "sample") {
+		config.sampling.enabled = true;
+	} else if (option == "sample-period" || option == "sample-window" || option == "sample-warmup") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < (option == "sample-warmup" ? 0 : 1)) {
+			std::cout << "Option " << option << " must be " << (option == "sample-warmup" ? "at least 0" : "at least 1") << std::endl;
+			return false;
+		}
+		if (option == "sample-period") {
+			config.sampling.period = number;
+		} else if (option == "sample-window") {
+			config.sampling.window = number;
+		} else {
+			config.sampling.warmup = number;
+		}
+		config.sampling.enabled = true;
+	} else if (option == "simpoints") {
+		config.sampling.simpoints_path = value;
+		config.sampling.enabled = true;
+	} else if (option == "simpoint-weights") {
+		config.sampling.weights_path = value;
+		config.sampling.enabled = true;
+	} else if (option == "directory") {
+		config.directory = true;
+	} else if (option == "stats-format") {
+		if (!statsFormatFromName(value, config.stats.format)) {
+			std::cout << "Unknown stats format " << value << std::endl;
+			return false;
+		}
+	} else if (option == "stats-file") {
+		config.stats.path = value;
+	} else if (option == "stats-interval") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1) {
+			std::cout << "Stats interval must be at least 1 access" << std::endl;
+			return false;
+		}
+		config.stats.interval = number;
+	} else if (option == "no-block-dump") {
+		config.stats.block_dump = false;
+	} else if (option == "profile") {
+		config.profile.enabled = true;
+	} else if (option == "profile-top") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1 || number > 65536) {
+			std::cout << "Profiled blocks must be between 1 and 65536" << std::endl;
+			return false;
+		}
+		config.profile.top = number;
+		config.profile.enabled = true;
+	} else if (option == "profile-width") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		int bits = log2Exact(number);
+		if (bits < 4 || bits > 24) {
+			std::cout << "Profile sketch width must be a power of two between 16 and 16777216" << std::endl;
+			return false;
+		}
+		config.profile.width_bits = bits;
+		config.profile.enabled = true;
+	} else if (option == "save-checkpoint") {
+		config.save_checkpoint_path = value;
+	} else if (option == "checkpoint-at") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1) {
+			std::cout << "Checkpoint position must be at least 1" << std::endl;
+			return false;
+		}
+		config.checkpoint_at = number;
+	} else if (option == "restore") {
+		config.restore_path = value;
+	} else if (option == "config") {
+		return loadConfigFile(value, config);
+	} else if (option == "trace") {
+		config.trace_path = value;
+	} else if (option == "shm") {
+		config.shm_name = value;
+	} else if (option == "shm-timeout") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 0 || number > 86400) {
+			std::cout << "Shared-memory ring timeout must be between 0 and 86400 seconds" << std::endl;
+			return false;
+		}
+		config.shm_timeout = number;
+	} else if (option == "convert") {
+		config.convert_path = value;
+		config.convert_compact = false;
+	} else if (option == "convert-compact") {
+		config.convert_path = value;
+		config.convert_compact = true;
+	} else if (option == "protocol") {
+		if (!protocolFromName(value, config.protocol)) {
+			std::cout << "Unknown protocol " << value << std::endl;
+			return false;
+		}
+	} else if (option == "workload") {
+		if (!patternFromName(value, config.workload.pattern)) {
+			std::cout << "Unknown workload " << value << std::endl;
+			return false;
+		}
+		config.use_workload = true;
+	} else if (option == "accesses") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 0) {
+			std::cout << "Number of accesses cannot be negative" << std::endl;
+			return false;
+		}
+		config.workload.accesses = number;
+	} else if (option == "seed") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		config.workload.seed = number;
+	} else if (option == "working-set") {
+		if (!parseNumber(option, value, number)) {
+			return false;
+		}
+		if (number < 1) {
+			std::cout << "Working set must be at least 1 block" << std::endl;
+			return false;
+		}
+		config.workload.working_set = number;
+	} else if (option == "write-ratio") {
+		return parseFraction(option, value, 0, 1, config.workload.write_ratio);
+	} else if (option == "shared-ratio") {
+		return parseFraction(option, value, 0, 1, config.workload.shared_ratio);
+	} else if (option == "zipf-theta") {
+		if (!parseFraction(option, value, 0, 1, config.workload.zipf_theta)) {
+			return false;
+		}
+		if (config.workload.zipf_theta <= 0 || config.workload.zipf_theta >= 1) {
+			std::cout << "Zipf theta must be strictly between 0 and 1" << std::endl;
+			return false;
+		}
+	} else {
+		std::cout << "Unknown option " << option << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool loadConfigFile(const std::string& path, SimConfig& config) {
+	std::ifstream in(path);
+	if (!in) {
+		std::cout << "Cannot open config file " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	while (std::getline(in, line)) {
+		std::istringstream fields(line);
+		std::string option, value;
+		if (!(fields >> option) || option[0] == '#') {
+			continue;
+		}
+		if (!isFlag(option) && !(fields >> value)) {
+			std::cout << "Option " << option << " in " << path << " has no value" << std::endl;
+			return false;
+		}
+		if (!applyOption(option, value, config)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Checks the checkpoint options against the mode, once all are applied
+static bool checkCheckpoint(const SimConfig& config) {
+	bool sweep = !config.sweep_protocols.empty() || !config.sweep_geometries.empty();
+	if (config.checkpoint_at != 0 && config.save_checkpoint_path.empty()) {
+		std::cout << "--checkpoint-at needs --save-checkpoint" << std::endl;
+		return false;
+	}
+	if (!config.save_checkpoint_path.empty() && (sweep || config.timed_bus || config.sampling.enabled)) {
+		std::cout << "Checkpoints are saved from plain runs only, not sweeps, the timed bus or sampling" << std::endl;
+		return false;
+	}
+	if (!config.restore_path.empty() && (sweep || !config.sampling.simpoints_path.empty())) {
+		std::cout << "A checkpoint cannot be restored into a sweep or SimPoint sampling" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Checks the profiler options against the mode, once all are applied
+static bool checkProfile(const SimConfig& config) {
+	if (config.profile.enabled && (!config.sweep_protocols.empty() || !config.sweep_geometries.empty())) {
+		std::cout << "The sharing profiler cannot be combined with a sweep" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Checks the sampling options against each other and the mode, once all are applied
+static bool checkSampling(const SimConfig& config) {
+	const SamplingConfig& sampling = config.sampling;
+	if (!sampling.enabled) {
+		return true;
+	}
+	if (!config.sweep_protocols.empty() || !config.sweep_geometries.empty() || config.timed_bus) {
+		std::cout << "Sampling cannot be combined with a sweep or the timed bus" << std::endl;
+		return false;
+	}
+	if (sampling.simpoints_path.empty() != sampling.weights_path.empty()) {
+		std::cout << "SimPoint sampling needs both --simpoints and --simpoint-weights" << std::endl;
+		return false;
+	}
+	if (sampling.simpoints_path.empty() && sampling.window + sampling.warmup > sampling.period) {
+		std::cout << "The sample window and warm-up must fit in the sample period" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Checks the directory backend against the options that only apply to the Bus, once all are applied
+static bool checkDirectory(const SimConfig& config) {
+	if (!config.directory) {
+		return true;
+	}
+	if (config.snoop_filter || config.bus_banks > 1 || config.llc.enabled || config.timed_bus) {
+		std::cout << "The directory backend replaces the bus: no snoop filter, bus banks, LLC or timed bus" << std::endl;
+		return false;
+	}
+	if (config.sampling.enabled || !config.save_checkpoint_path.empty() || !config.restore_path.empty()
+		|| !config.sweep_protocols.empty() || !config.sweep_geometries.empty()) {
+		std::cout << "The directory backend runs plain simulations only, not sweeps, sampling or checkpoints" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Checks a sharded run against the components whose state spans sets, once all are applied
+static bool checkShards(const SimConfig& config) {
+	if (config.shards == 1) {
+		return true;
+	}
+	if (config.shards > config.geometry.numSets()) {
+		std::cout << "Cannot split " << config.geometry.numSets() << " sets into " << config.shards << " shards" << std::endl;
+		return false;
+	}
+	if (config.llc.enabled || config.directory || config.timed_bus || config.profile.enabled || config.stats.interval != 0) {
+		std::cout << "Only the caches and the bus can be sharded: no LLC, directory, timed bus, profiler or stats intervals" << std::endl;
+		return false;
+	}
+	if (config.replacement == ReplacementPolicy::BRRIP || config.replacement == ReplacementPolicy::DRRIP
+		|| config.replacement == ReplacementPolicy::RandomVictim) {
+		std::cout << "The " << policyName(config.replacement) << " policy shares state between sets, and cannot be sharded" << std::endl;
+		return false;
+	}
+	if (config.sampling.enabled || !config.save_checkpoint_path.empty() || !config.restore_path.empty()
+		|| !config.sweep_protocols.empty() || !config.sweep_geometries.empty()) {
+		std::cout << "Sharding runs plain simulations only, not sweeps, sampling or checkpoints" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Checks a shared-memory ring against the other sources of accesses, once all are applied
+static bool checkShm(const SimConfig& config) {
+	if (config.shm_name.empty()) {
+		return true;
+	}
+	if (!config.trace_path.empty() || config.use_workload || !config.convert_path.empty()) {
+		std::cout << "--shm is a source of accesses of its own: no --trace, --workload or --convert" << std::endl;
+		return false;
+	}
+	if (!config.sweep_protocols.empty() || !config.sweep_geometries.empty() || config.shards > 1) {
+		std::cout << "A shared-memory ring is read once, by a single run: no sweeps or shards" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Checks the L1 against the modes that do not know about it, once all are applied
+static bool checkL1(const SimConfig& config) {
+	if (config.l1_ways == 0) {
+		return true;
+	}
+	if (config.sampling.enabled || !config.save_checkpoint_path.empty() || !config.restore_path.empty() || config.shards > 1) {
+		std::cout << "An L1 cannot be combined with sampling, checkpoints or shards" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Checks the prefetchers against the modes that do not know about them, once all are applied
+static bool checkPrefetch(const SimConfig& config) {
+	if (config.prefetch.policy == PrefetchPolicy::NoPrefetch) {
+		return true;
+	}
+	if (config.directory || config.timed_bus) {
+		std::cout << "Prefetches are sent on the snooping bus, untimed: no directory or timed bus" << std::endl;
+		return false;
+	}
+	if (config.sampling.enabled || !config.save_checkpoint_path.empty() || !config.restore_path.empty() || config.shards > 1) {
+		std::cout << "Prefetching cannot be combined with sampling, checkpoints or shards" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Checks the stats options against the mode, once all are applied
+static bool checkStats(const SimConfig& config) {
+	const StatsConfig& stats = config.stats;
+	bool structured = stats.format != TextStats;
+	if (!stats.path.empty() && !structured) {
+		std::cout << "--stats-file needs --stats-format json or csv" << std::endl;
+		return false;
+	}
+	if ((structured || stats.interval != 0) && (!config.sweep_protocols.empty() || !config.sweep_geometries.empty() || config.sampling.enabled)) {
+		std::cout << "Structured stats and intervals cannot be combined with a sweep or sampling" << std::endl;
+		return false;
+	}
+	// The other reports are text, which would corrupt the stats on stdout
+	if (structured && stats.path.empty() && (config.timed_bus || config.profile.enabled || !config.save_checkpoint_path.empty())) {
+		std::cout << "JSON or CSV stats go to --stats-file when the timed bus, profiler or a checkpoint also report" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool parseArgs(int argc, char* argv[], SimConfig& config) {
+	for (int i=1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.compare(0, 2, "--") != 0) {
+			printUsage(argv[0]);
+			return false;
+		}
+		std::string option = arg.substr(2);
+		std::string value;
+		if (!isFlag(option)) {
+			if (i + 1 >= argc) {
+				printUsage(argv[0]);
+				return false;
+			}
+			value = argv[++i];
+		}
+		if (!applyOption(option, value, config)) {
+			return false;
+		}
+	}
+	return checkSampling(config) && checkCheckpoint(config) && checkProfile(config) && checkStats(config)
+		&& checkDirectory(config) && checkShards(config) && checkShm(config)
+		&& checkL1(config) && checkPrefetch(config);
+}
+
+void printUsage(const char* program) {
+	std::cout << "Usage: " << program << " [options] < trace.in" << std::endl;
+	std::cout << "  --trace FILE        simulate the trace in FILE instead of reading stdin" << std::endl;
+	std::cout << "                      (text or binary, either one optionally gzip compressed)" << std::endl;
+	std::cout << "  --shm NAME          simulate the accesses a producer writes into the shared-memory ring NAME" << std::endl;
+	std::cout << "  --shm-timeout N     seconds to wait for the producer to attach, 0 for ever (default " << DEFAULT_SHM_TIMEOUT << ")" << std::endl;
+	std::cout << "  --convert FILE      convert the trace (stdin or --trace) to a binary trace" << std::endl;
+	std::cout << "  --convert-compact FILE  convert the trace to a compact trace: per-core address deltas as varints" << std::endl;
+	std::cout << "  --config FILE       read options from FILE, one \"option value\" per line" << std::endl;
+	std::cout << "  --cores N           number of cores (default " << DEFAULT_NUMBER_OF_CORES << ")" << std::endl;
+	std::cout << "  --sets N            sets per cache, a power of two" << std::endl;
+	std::cout << "  --ways N            associativity" << std::endl;
+	std::cout << "  --block-size N      block size in bytes, a power of two" << std::endl;
+	std::cout << "  --replacement NAME  replacement policy: lru (default), tree-plru, srrip, brrip, drrip, random" << std::endl;
+	std::cout << "                      or coherence-lru (evicts Shared blocks first)" << std::endl;
+	std::cout << "  --l1 SETSxWAYS      put a private L1 in front of every cache, which becomes the L2 of its core" << std::endl;
+	std::cout << "  --prefetch NAME     prefetcher of every core: none (default), next-line, stride or stream" << std::endl;
+	std::cout << "  --prefetch-degree N blocks prefetched at a time (default " << DEFAULT_PREFETCH_DEGREE << ")" << std::endl;
+	std::cout << "  --prefetch-distance N  blocks the stream prefetcher runs ahead (default " << DEFAULT_PREFETCH_DISTANCE << ")" << std::endl;
+	std::cout << "  --snoop-filter      snoop only the caches that hold the block" << std::endl;
+	std::cout << "  --latency           report the memory access latency per core" << std::endl;
+	std::cout << "  --hit-latency N     cycles of a hit (default " << DEFAULT_HIT_LATENCY << "); this and the four below imply --latency" << std::endl;
+	std::cout << "  --c2c-latency N     extra cycles of a miss served by another cache (default " << DEFAULT_CACHE_TO_CACHE_LATENCY << ")" << std::endl;
+	std::cout << "  --llc-latency N     extra cycles of a miss served by the LLC (default " << DEFAULT_LLC_LATENCY << ")" << std::endl;
+	std::cout << "  --dram-latency N    extra cycles of a miss the LLC reads from DRAM (default " << DEFAULT_DRAM_LATENCY << ", needs --llc)" << std::endl;
+	std::cout << "  --writeback-latency N     extra cycles per writeback an access causes (default " << DEFAULT_WRITEBACK_LATENCY << ")" << std::endl;
+	std::cout << "  --invalidation-latency N  extra cycles of an upgrade or invalidating miss (default " << DEFAULT_INVALIDATION_LATENCY << ")" << std::endl;
+	std::cout << "  --l2-latency N      extra cycles of an access that misses the L1 (default " << DEFAULT_L2_LATENCY << ", needs --l1)" << std::endl;
+	std::cout << "  --directory         keep the caches coherent with a sparse directory instead of the bus," << std::endl;
+	std::cout << "                      as FESI_GEM5/FESI-dir.sm does (FESI traces only)" << std::endl;
+	std::cout << "  --bus-banks N       split the bus into N address-interleaved banks, a power of two" << std::endl;
+	std::cout << "  --llc MODE          model a shared LLC, inclusive or non-inclusive, with DRAM behind it" << std::endl;
+	std::cout << "  --llc-banks N       LLC banks, a power of two (default " << DEFAULT_LLC_BANKS << ")" << std::endl;
+	std::cout << "  --llc-sets N        sets per LLC bank, a power of two (default " << (1 << DEFAULT_LLC_SET_BITS) << ")" << std::endl;
+	std::cout << "  --llc-ways N        LLC associativity (default " << DEFAULT_LLC_ASSOCIATIVITY << ")" << std::endl;
+	std::cout << "  --llc-replacement NAME  replacement policy of the LLC (default lru)" << std::endl;
+	std::cout << "  --timed-bus         time the accesses on a split-transaction bus and report its contention" << std::endl;
+	std::cout << "  --arbitration NAME  fcfs or round-robin (default fcfs)" << std::endl;
+	std::cout << "  --address-cycles N  cycles of the address phase (default " << DEFAULT_ADDRESS_CYCLES << ")" << std::endl;
+	std::cout << "  --bus-bandwidth N   bytes per cycle of the data bus (default " << DEFAULT_BUS_BANDWIDTH << ")" << std::endl;
+	std::cout << "  --sample            simulate in detail only sample windows, warm the caches in between," << std::endl;
+	std::cout << "                      and estimate the counters of the whole trace" << std::endl;
+	std::cout << "  --sample-period N   accesses per sampling period, or per SimPoint interval (default " << DEFAULT_SAMPLE_PERIOD << ")" << std::endl;
+	std::cout << "  --sample-window N   accesses measured at the end of every period (default " << DEFAULT_SAMPLE_WINDOW << ")" << std::endl;
+	std::cout << "  --sample-warmup N   accesses simulated in detail before every window (default " << DEFAULT_SAMPLE_WARMUP << ")" << std::endl;
+	std::cout << "  --simpoints FILE    measure the intervals SimPoint picked in FILE instead of periodic windows" << std::endl;
+	std::cout << "  --simpoint-weights FILE  weights of the SimPoint clusters" << std::endl;
+	std::cout << "  --stats-format NAME text (default), json or csv" << std::endl;
+	std::cout << "  --stats-file FILE   write the JSON or CSV stats to FILE instead of stdout" << std::endl;
+	std::cout << "  --stats-interval N  also snapshot the counters every N accesses" << std::endl;
+	std::cout << "  --no-block-dump     leave the blocks of every set out of the text stats" << std::endl;
+	std::cout << "  --profile           report the blocks causing the most coherence traffic, and false sharing" << std::endl;
+	std::cout << "  --profile-top N     blocks reported (default " << DEFAULT_PROFILE_TOP << ")" << std::endl;
+	std::cout << "  --profile-width N   columns of the profile sketch, a power of two (default " << (1 << DEFAULT_PROFILE_WIDTH_BITS) << ")" << std::endl;
+	std::cout << "  --save-checkpoint FILE  save the state of the caches, bus and LLC to FILE at the end of the run" << std::endl;
+	std::cout << "  --checkpoint-at N   stop and save the checkpoint after N accesses instead" << std::endl;
+	std::cout << "  --restore FILE      start from the checkpoint in FILE, skipping the accesses it covers;" << std::endl;
+	std::cout << "                      the protocol, geometry, bus banks, LLC and replacement policies must match" << std::endl;
+	std::cout << "  --sweep LIST        run every protocol in LIST (comma separated, or \"all\")" << std::endl;
+	std::cout << "  --sweep-geometry LIST  run every SETSxWAYS[xBLOCKSIZE] geometry in LIST" << std::endl;
+	std::cout << "  --threads N         worker threads for a sweep (default: all hardware threads)" << std::endl;
+	std::cout << "  --shards N          split the sets of a single run over N threads, a power of two; same results" << std::endl;
+	std::cout << "  --workload NAME     simulate a generated workload instead of a trace: uniform, producer-consumer," << std::endl;
+	std::cout << "                      migratory, false-sharing, read-mostly, streaming or zipfian" << std::endl;
+	std::cout << "  --protocol NAME     protocol of the generated workload (default FESI)" << std::endl;
+	std::cout << "  --accesses N        accesses to generate (default 1000000)" << std::endl;
+	std::cout << "  --seed N            seed of the generator; a seed always gives the same accesses" << std::endl;
+	std::cout << "  --working-set N     blocks in the working set (default 4096)" << std::endl;
+	std::cout << "  --write-ratio F     fraction of writes (default depends on the workload)" << std::endl;
+	std::cout << "  --shared-ratio F    uniform: fraction of accesses to the shared working set (default 0.1)" << std::endl;
+	std::cout << "  --zipf-theta F      zipfian: skew, between 0 and 1 (default 0.99)" << std::endl;
+	std::cout << "Traces compressed with other tools can be piped in, e.g. zstd -dc trace.in.zst | " << program << std::endl;
+}
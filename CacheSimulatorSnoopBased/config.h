@@ -0,0 +1,110 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "request.h"
+#include "geometry.h"
+#include "workload.h"
+#include "latency.h"
+#include "llc.h"
+#include "sampling.h"
+#include "profiler.h"
+#include "stats.h"
+#include "prefetcher.h"
+
+// Everything that can be chosen on the command line or in a config file
+class SimConfig {
+	public:
+		int cores;
+		CacheGeometry geometry;
+
+		// Private L1 of 2^l1_set_bits sets and l1_ways ways in front of every cache, which
+		// then acts as the L2 of its core (see L1Cache); 0 ways for none
+		int l1_set_bits, l1_ways;
+
+		// Prefetcher of every core, which reads ahead with BusRd (see Prefetcher)
+		PrefetchConfig prefetch;
+
+		// Snoop only the caches that hold a block (see SnoopFilter)
+		bool snoop_filter;
+
+		// Address-interleaved banks the bus is split into (see BusBank)
+		int bus_banks;
+
+		// Replacement policy of the caches (see CacheSet)
+		ReplacementPolicy replacement;
+
+		// Keep FESI coherent with a directory instead of the snooping Bus (see Directory)
+		bool directory;
+
+		// Shared LLC behind the bus (see LLC)
+		LLCConfig llc;
+
+		// Sweep mode: every protocol in sweep_protocols is run with every geometry
+		// in sweep_geometries on a pool of threads
+		// An empty list means the protocol of the trace or the geometry above
+		std::vector<Protocol> sweep_protocols;
+		std::vector<CacheGeometry> sweep_geometries;
+		int threads;
+
+		// Split the sets of a single run over this many threads, a power of two (see runSharded)
+		int shards;
+
+		// Trace to simulate; empty to read it from stdin
+		std::string trace_path;
+
+		// Shared-memory ring to create and simulate the accesses of a producer from, in place
+		// of a trace (see ShmConsumer); empty when unused
+		// and the seconds to wait for the producer to attach, 0 to wait forever
+		std::string shm_name;
+		unsigned shm_timeout;
+
+		// Output file of --convert or --convert-compact; empty when not converting
+		std::string convert_path;
+		bool convert_compact;
+
+		// Cycles charged per event, and whether the latency report is printed
+		LatencyModel latency;
+		bool report_latency;
+
+		// Time the accesses on a split-transaction bus (see TimedBus); single runs only
+		bool timed_bus;
+		BusTiming bus_timing;
+
+		// Simulate only sample windows in detail, and warm the caches in between (see Sampler)
+		SamplingConfig sampling;
+
+		// Format and destination of the stats, and interval snapshots (see StatsRegistry)
+		StatsConfig stats;
+
+		// Report the blocks causing the coherence traffic (see SharingProfiler)
+		ProfilerConfig profile;
+
+		// Save the state to save_checkpoint_path after checkpoint_at accesses (0: at the end),
+		// or start from the state saved in restore_path (see Checkpoint); empty when unused
+		std::string save_checkpoint_path;
+		uint64_t checkpoint_at;
+		std::string restore_path;
+
+		// Simulate a generated workload instead of a trace
+		// Its cores and block size are filled in from the options above when it runs
+		bool use_workload;
+		WorkloadSpec workload;
+
+		// Protocol of a generated workload; traces name their own protocol
+		Protocol protocol;
+
+		SimConfig();
+};
+
+// Parses the command line into config
+// Options are applied in order, so values after --config override the file
+// Returns false (after printing the reason) on a bad command line
+bool parseArgs(int argc, char* argv[], SimConfig& config);
+
+// Applies the "<option> <value>" lines of a config file to config
+// On/off options such as snoop-filter are given without a value
+// Blank lines and lines starting with '#' are ignored
+bool loadConfigFile(const std::string& path, SimConfig& config);
+
+// Prints the command line options
+void printUsage(const char* program);
@@ -0,0 +1,284 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include "directory.h"
+#include "cache.h"
+#include "bus.h"
+#include "stats.h"
+
+static const char* MESSAGE_NAMES[NUM_DIRECTORY_MESSAGES] = {
+	"GetS", "GetM", "PutS", "PutE", "PutF",
+	"Fwd-GetS", "Fwd-GetM", "Inv", "PutAck", "FAllocReq", "AllocF",
+	"Data", "ExclusiveData", "InvAck", "AckCount", "StoFAck", "StoFInvAck", "SFDone",
+	"MEMORY_READ", "MEMORY_WB"
+};
+
+const char* directoryMessageName(DirectoryMessage message) {
+	return MESSAGE_NAMES[message];
+}
+
+Directory::Directory(std::vector<Cache*>& _caches, AccessOutcome* _outcome) {
+	caches = _caches;
+	words = (caches.size() + 63) / 64;
+	outcome = _outcome;
+	for (int m=0; m < NUM_DIRECTORY_MESSAGES; m++) {
+		num_messages[m] = 0;
+	}
+	num_requests = 0;
+}
+
+unsigned int Directory::slot(unsigned long long block_address) {
+	std::unordered_map<unsigned long long, unsigned int>::iterator iter = entries.find(block_address);
+	if (iter != entries.end()) {
+		return iter->second;
+	}
+	unsigned int slot;
+	if (!free_slots.empty()) {
+		slot = free_slots.back();
+		free_slots.pop_back();
+	} else {
+		slot = states.size();
+		states.push_back(DirI);
+		owners.push_back(-1);
+		sharers.resize(sharers.size() + words);
+	}
+	states[slot] = DirI;
+	owners[slot] = -1;
+	for (int w=0; w < words; w++) {
+		sharers[slot * words + w] = 0;
+	}
+	entries[block_address] = slot;
+	return slot;
+}
+
+void Directory::release(unsigned long long block_address, unsigned int slot) {
+	entries.erase(block_address);
+	free_slots.push_back(slot);
+}
+
+int Directory::countSharers(unsigned int slot) {
+	int count = 0;
+	for (int w=0; w < words; w++) {
+		count += __builtin_popcountll(sharers[slot * words + w]);
+	}
+	return count;
+}
+
+int Directory::invalidateSharers(unsigned int slot, int requestor, unsigned long long block_address) {
+	int invalidated = 0;
+	for (int w=0; w < words; w++) {
+		uint64_t bits = sharers[slot * words + w];
+		while (bits != 0) {
+			int i = w * 64 + __builtin_ctzll(bits);
+			bits &= bits - 1;
+			if (i == requestor) {
+				continue;
+			}
+			num_messages[MsgInv]++;
+			num_messages[MsgInvAck]++;
+			caches[i]->setState(block_address, CacheBlockState::Invalid);
+			caches[i]->num_invalidations++;
+			invalidated++;
+		}
+		sharers[slot * words + w] = 0;
+	}
+	return invalidated;
+}
+
+CacheBlockState Directory::getS(int requestor, unsigned long long block_address) {
+	num_requests++;
+	num_messages[MsgGetS]++;
+	unsigned int s = slot(block_address);
+	if (states[s] == DirI) {
+		// The only copy: Exclusive, from memory
+		num_messages[MsgMemoryRead]++;
+		num_messages[MsgExclusiveData]++;
+		caches[requestor]->num_fromLLC++;
+		owners[s] = requestor;
+		states[s] = DirE;
+		return CacheBlockState::Exclusive;
+	}
+
+	// The owner sends the data and becomes a sharer; the requestor is the new owner
+	int owner = owners[s];
+	num_messages[MsgFwdGetS]++;
+	num_messages[MsgData]++;
+	caches[owner]->setState(block_address, CacheBlockState::Shared);
+	caches[owner]->num_provided++;
+	outcome->supplied = true;
+	addSharer(s, owner);
+	owners[s] = requestor;
+	states[s] = DirF;
+	return CacheBlockState::Forward;
+}
+
+void Directory::getM(int requestor, unsigned long long block_address) {
+	num_requests++;
+	num_messages[MsgGetM]++;
+	unsigned int s = slot(block_address);
+	if (states[s] == DirI) {
+		num_messages[MsgMemoryRead]++;
+		num_messages[MsgData]++;
+		caches[requestor]->num_fromLLC++;
+		owners[s] = requestor;
+		states[s] = DirF;
+		return;
+	}
+
+	int owner = owners[s];
+	if (owner == requestor) {
+		// GetMOwner: the directory tells the owner how many InvAcks to wait for
+		num_messages[MsgAckCount]++;
+		outcome->invalidations += invalidateSharers(s, requestor, block_address);
+		return;
+	}
+
+	// GetMNonOwner: the owner sends the data and invalidates its copy, the other sharers
+	// are invalidated by the directory
+	// A requestor upgrading from S already has the data, so none moves, as with BusUpgr
+	bool upgrade = isSharer(s, requestor);
+	removeSharer(s, requestor);
+	num_messages[MsgFwdGetM]++;
+	caches[owner]->setState(block_address, CacheBlockState::Invalid);
+	caches[owner]->num_invalidations++;
+	if (!upgrade) {
+		num_messages[MsgData]++;
+		caches[owner]->num_provided++;
+		outcome->supplied = true;
+	}
+	outcome->invalidations += 1 + invalidateSharers(s, requestor, block_address);
+	owners[s] = requestor;
+	states[s] = DirF;
+}
+
+void Directory::put(int requestor, unsigned long long block_address, CacheBlockState state) {
+	unsigned int s = slot(block_address);
+	switch (state) {
+		case CacheBlockState::Shared:
+			num_messages[MsgPutS]++;
+			num_messages[MsgPutAck]++;
+			removeSharer(s, requestor);
+			break;
+		case CacheBlockState::Exclusive:
+			num_messages[MsgPutE]++;
+			num_messages[MsgPutAck]++;
+			release(block_address, s);
+			break;
+		case CacheBlockState::Forward:
+		{
+			num_messages[MsgPutF]++;
+			num_messages[MsgPutAck]++;
+			int count = countSharers(s);
+			if (count == 0) {
+				// The last copy is written back
+				num_messages[MsgMemoryWriteback]++;
+				caches[requestor]->num_writebacks++;
+				outcome->writebacks++;
+				release(block_address, s);
+				break;
+			}
+			// Every sharer is asked to take F and accepts; the first (lowest id) is chosen
+			num_messages[MsgFAllocReq] += count;
+			num_messages[MsgStoFAck] += count;
+			num_messages[MsgAllocF]++;
+			num_messages[MsgSFDone]++;
+			int chosen = 0;
+			for (int w=0; w < words; w++) {
+				if (sharers[s * words + w] != 0) {
+					chosen = w * 64 + __builtin_ctzll(sharers[s * words + w]);
+					break;
+				}
+			}
+			removeSharer(s, chosen);
+			caches[chosen]->setState(block_address, CacheBlockState::Forward);
+			caches[chosen]->num_random++;
+			owners[s] = chosen;
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+void Directory::printStats() {
+	unsigned long long total = 0;
+	for (int m=0; m < NUM_DIRECTORY_MESSAGES; m++) {
+		total += num_messages[m];
+	}
+	std::cout << std::dec;
+	std::cout << ">> Directory stats\n";
+	for (int m=0; m < NUM_DIRECTORY_MESSAGES; m++) {
+		std::cout << "Number of " << std::setw(14) << std::left << MESSAGE_NAMES[m] << std::right << ": " << num_messages[m] << '\n';
+	}
+	std::cout << "Tracked blocks          : " << entries.size() << '\n';
+	std::cout << "Messages                : " << total << '\n';
+	std::cout << "Messages per request    : " << std::fixed << std::setprecision(2)
+		<< (num_requests ? (double) total / num_requests : 0.0) << " (GetS and GetM)\n";
+}
+
+void Directory::registerStats(StatsRegistry& stats) {
+	for (int m=0; m < NUM_DIRECTORY_MESSAGES; m++) {
+		stats.add("directory", MESSAGE_NAMES[m], &num_messages[m]);
+	}
+	stats.add("directory", "tracked_blocks", [this]() -> unsigned long long { return entries.size(); });
+}
+
+// Processor requests under the directory backend: the state changes of FESI-cache.sm
+// between its stable states I, S, E and F
+void Cache::directoryProcRequest(ProcRequest request, unsigned long long address)
+{
+	unsigned long long blockAddress = geometry.blockAddressOf(address);
+	int set_Address = geometry.setIndex(blockAddress);
+	CacheBlockState BlockState = getState(blockAddress);
+
+	AccessOutcome& outcome = bus->outcome;
+	outcome.reset();
+
+	if(request == ProcRequest::ProcRd)
+	{
+		num_reads++;
+	}
+	else
+	{
+		num_writes++;
+	}
+
+	if(BlockState != CacheBlockState::Invalid)
+	{
+		outcome.hit = true;
+		moveToMRU(blockAddress);
+		if(request == ProcRequest::ProcWr)
+		{
+			if(BlockState == CacheBlockState::Exclusive)
+			{
+				// Silent upgrade: the directory still has the block in E
+				setState(blockAddress, CacheBlockState::Forward);
+			}
+			else
+			{
+				outcome.upgrade = true;
+				directory->getM(id, blockAddress);
+				setState(blockAddress, CacheBlockState::Forward);
+			}
+		}
+		return;
+	}
+
+	CacheBlockState fill_state = CacheBlockState::Forward;
+	if(request == ProcRequest::ProcRd)
+	{
+		fill_state = directory->getS(id, blockAddress);
+		num_read_misses++;
+	}
+	else
+	{
+		directory->getM(id, blockAddress);
+		num_write_misses++;
+	}
+
+	CacheBlock evictedBlock = insertCacheBlock(blockAddress, fill_state);
+	if(evictedBlock.state != CacheBlockState::Invalid)
+	{
+		directory->put(id, geometry.blockAddress(evictedBlock.tag, set_Address), evictedBlock.state);
+	}
+}
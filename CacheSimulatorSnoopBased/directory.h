@@ -0,0 +1,121 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "request.h"
+#include "latency.h"
+#include "cacheset.h"
+
+class Cache;
+class StatsRegistry;
+
+// Messages of the directory backend, named as in FESI_GEM5/FESI-msg.sm
+// Forwarded GetS and GetM travel on the forward network and are counted apart
+// from the requests; the memory requests are those of the directory controller
+typedef enum {
+	// Requests from the caches to the directory
+	MsgGetS,
+	MsgGetM,
+	MsgPutS,
+	MsgPutE,
+	MsgPutF,
+	// Requests from the directory to the caches
+	MsgFwdGetS,
+	MsgFwdGetM,
+	MsgInv,
+	MsgPutAck,
+	MsgFAllocReq,
+	MsgAllocF,
+	// Responses
+	MsgData,
+	MsgExclusiveData,
+	MsgInvAck,
+	MsgAckCount,
+	MsgStoFAck,
+	MsgStoFInvAck,
+	MsgSFDone,
+	// Between the directory and memory
+	MsgMemoryRead,
+	MsgMemoryWriteback,
+	NUM_DIRECTORY_MESSAGES
+} DirectoryMessage;
+
+// Returns the name of the message, as in FESI-msg.sm
+const char* directoryMessageName(DirectoryMessage message);
+
+// Stable states of a block at the directory, as in FESI-dir.sm
+typedef enum {
+	DirI, // in no cache
+	DirE, // in the owner only, Exclusive (or Forward after a silent upgrade)
+	DirF  // the owner holds it in Forward, the sharers in Shared
+} DirectoryState;
+
+// Directory backend of FESI, in place of the Bus: a sparse directory keyed by block
+// address, with the owner and the sharer mask of every block some cache holds, which
+// sends each message point to point (a multicast counts once per destination)
+// Every request completes before the next access, so the transient states and races
+// of FESI-dir.sm never arise, and a sharer always accepts FAllocReq
+class Directory {
+	public:
+		std::vector<Cache*> caches;
+
+		// 64-bit words per sharer mask
+		int words;
+
+		// Block address -> slot of its state, owner and sharer mask; blocks in state I have no entry
+		std::unordered_map<unsigned long long, unsigned int> entries;
+		std::vector<DirectoryState> states;
+		std::vector<int> owners;
+		std::vector<uint64_t> sharers;
+		std::vector<unsigned int> free_slots;
+
+		// Outcome of the access being handled (the Bus's, read by the Simulator)
+		AccessOutcome* outcome;
+
+		// Counters
+		unsigned long long num_messages[NUM_DIRECTORY_MESSAGES];
+		unsigned long long num_requests;
+
+		Directory(std::vector<Cache*>& _caches, AccessOutcome* _outcome);
+
+		// A read miss of the requestor: returns the state it fills the block in
+		CacheBlockState getS(int requestor, unsigned long long block_address);
+
+		// A write miss, or a write hit in Forward or Shared, of the requestor, which
+		// holds the block in Forward afterwards
+		void getM(int requestor, unsigned long long block_address);
+
+		// The requestor evicted the block, which it held in the state given
+		void put(int requestor, unsigned long long block_address, CacheBlockState state);
+
+		// Prints the messages per type, and per request
+		void printStats();
+
+		// Registers the message counters under "directory"
+		void registerStats(StatsRegistry& stats);
+
+	private:
+		// Returns the slot of the block, creating it in state I if it has none
+		unsigned int slot(unsigned long long block_address);
+
+		// Drops the entry of a block no cache holds any more
+		void release(unsigned long long block_address, unsigned int slot);
+
+		// Sends Inv to every sharer but the requestor, which each answer with an InvAck to it,
+		// and clears the sharers; returns the caches invalidated
+		int invalidateSharers(unsigned int slot, int requestor, unsigned long long block_address);
+
+		void addSharer(unsigned int slot, int cache_id) {
+			sharers[slot * words + cache_id / 64] |= 1ULL << (cache_id % 64);
+		}
+
+		void removeSharer(unsigned int slot, int cache_id) {
+			sharers[slot * words + cache_id / 64] &= ~(1ULL << (cache_id % 64));
+		}
+
+		bool isSharer(unsigned int slot, int cache_id) {
+			return (sharers[slot * words + cache_id / 64] >> (cache_id % 64)) & 1;
+		}
+
+		int countSharers(unsigned int slot);
+};
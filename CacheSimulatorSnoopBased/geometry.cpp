@@ -0,0 +1,15 @@
+#include "geometry.h"
+
+CacheGeometry::CacheGeometry() {
+	set_bits = DEFAULT_SET_BITS;
+	associativity = DEFAULT_ASSOCIATIVITY;
+	offset_bits = DEFAULT_CACHE_OFFSET_BITS;
+	set_mask = (1ULL << set_bits) - 1;
+}
+
+CacheGeometry::CacheGeometry(int _set_bits, int _associativity, int _offset_bits) {
+	set_bits = _set_bits;
+	associativity = _associativity;
+	offset_bits = _offset_bits;
+	set_mask = (1ULL << set_bits) - 1;
+}
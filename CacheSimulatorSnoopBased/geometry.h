@@ -0,0 +1,35 @@
+#pragma once
+
+// Defaults, used when no geometry is given on the command line or in a config file
+#define DEFAULT_NUMBER_OF_CORES 16
+#define DEFAULT_SET_BITS 2
+#define DEFAULT_ASSOCIATIVITY 4
+#define DEFAULT_CACHE_OFFSET_BITS 6
+
+// The ways of a set are ranked in an unsigned char
+#define MAX_ASSOCIATIVITY 256
+
+// Shape of a cache, chosen at run time
+// The number of sets and the block size are powers of two, so the set index
+// and tag are a mask and a shift; the associativity can be any value up to MAX_ASSOCIATIVITY
+class CacheGeometry {
+	public:
+		int set_bits;
+		int associativity;
+		int offset_bits;
+		unsigned long long set_mask;
+
+		CacheGeometry();
+		CacheGeometry(int _set_bits, int _associativity, int _offset_bits);
+
+		int numSets() const { return 1 << set_bits; }
+		int blockSize() const { return 1 << offset_bits; }
+
+		// Address decomposition, used on every access
+		unsigned long long blockAddressOf(unsigned long long address) const { return address >> offset_bits; }
+		int setIndex(unsigned long long block_address) const { return block_address & set_mask; }
+		unsigned long long tag(unsigned long long block_address) const { return block_address >> set_bits; }
+
+		// Rebuilds a block address from the tag and set index
+		unsigned long long blockAddress(unsigned long long tag, int set) const { return (tag << set_bits) + set; }
+};
@@ -0,0 +1,122 @@
+#include <iostream>
+#include "l1cache.h"
+#include "cache.h"
+#include "bus.h"
+#include "stats.h"
+
+L1Cache::L1Cache(Protocol protocol, CacheGeometry _geometry) {
+	geometry = _geometry;
+	int ways = geometry.associativity;
+	int num_sets = geometry.numSets();
+	tag_store.resize(num_sets * ways);
+	state_store.resize(num_sets * ways);
+	repl_store.resize(num_sets * ways);
+	for (int i=0; i < num_sets; i++) {
+		sets.push_back(CacheSet(&tag_store[i * ways], &state_store[i * ways], &repl_store[i * ways], ways));
+	}
+	for (int state=0; state < NUM_BLOCK_STATES; state++) {
+		const Transition& transition = PROTOCOL_TABLES[protocol].hit[ProcRequest::ProcWr][state];
+		writable[state] = state != CacheBlockState::Invalid && transition.next == KeepState && transition.effects == 0;
+	}
+	num_reads = 0;
+	num_read_misses = 0;
+	num_writes = 0;
+	num_write_misses = 0;
+	num_upgrades = 0;
+	num_writebacks = 0;
+	num_back_invalidations = 0;
+	num_downgrades = 0;
+	num_snoops = 0;
+	num_snoops_forwarded = 0;
+}
+
+bool L1Cache::access(ProcRequest request, unsigned long long block_address) {
+	CacheSet& set = sets[geometry.setIndex(block_address)];
+	unsigned long long tag = geometry.tag(block_address);
+	CacheBlockState state = set.getState(tag);
+	if (request == ProcRequest::ProcRd) {
+		num_reads++;
+		if (state != CacheBlockState::Invalid) {
+			set.moveToMRU(tag);
+			return true;
+		}
+		num_read_misses++;
+		return false;
+	}
+	num_writes++;
+	if (state == CacheBlockState::Modified) {
+		set.moveToMRU(tag);
+		return true;
+	}
+	if (state == CacheBlockState::Invalid) {
+		num_write_misses++;
+	} else {
+		num_upgrades++;
+	}
+	return false;
+}
+
+void L1Cache::fill(unsigned long long block_address, CacheBlockState l2_state) {
+	CacheSet& set = sets[geometry.setIndex(block_address)];
+	unsigned long long tag = geometry.tag(block_address);
+	CacheBlockState state = writable[l2_state] ? CacheBlockState::Modified : CacheBlockState::Shared;
+	if (set.getState(tag) != CacheBlockState::Invalid) {
+		set.setState(tag, state);
+		set.moveToMRU(tag);
+		return;
+	}
+	// The L2 holds every block of the L1, so a dirty victim is written back into it
+	CacheBlock evicted = set.insertCacheBlock(CacheBlock(tag, state));
+	if (evicted.state == CacheBlockState::Modified) {
+		num_writebacks++;
+	}
+}
+
+void L1Cache::printStats() {
+	std::cout << "L1 reads        : " << num_reads << '\n';
+	std::cout << "L1 read misses  : " << num_read_misses << '\n';
+	std::cout << "L1 writes       : " << num_writes << '\n';
+	std::cout << "L1 write misses : " << num_write_misses << '\n';
+	std::cout << "L1 upgrades     : " << num_upgrades << '\n';
+	std::cout << "L1 writebacks   : " << num_writebacks << '\n';
+	std::cout << "L1 back-invals  : " << num_back_invalidations << '\n';
+	std::cout << "L1 downgrades   : " << num_downgrades << '\n';
+	std::cout << "Snoops at L2    : " << num_snoops << '\n';
+	std::cout << "Snoops to L1    : " << num_snoops_forwarded << '\n';
+}
+
+void L1Cache::registerStats(StatsRegistry& stats, const std::string& group) {
+	stats.add(group, "reads", &num_reads);
+	stats.add(group, "read_misses", &num_read_misses);
+	stats.add(group, "writes", &num_writes);
+	stats.add(group, "write_misses", &num_write_misses);
+	stats.add(group, "upgrades", &num_upgrades);
+	stats.add(group, "writebacks", &num_writebacks);
+	stats.add(group, "back_invalidations", &num_back_invalidations);
+	stats.add(group, "downgrades", &num_downgrades);
+	stats.add(group, "snoops", &num_snoops);
+	stats.add(group, "snoops_forwarded", &num_snoops_forwarded);
+}
+
+// Processor requests with an L1: only the accesses the L1 cannot serve reach the L2
+void Cache::hierarchyProcRequest(ProcRequest request, unsigned long long address) {
+	unsigned long long block_address = geometry.blockAddressOf(address);
+	if (l1->access(request, block_address)) {
+		bus->outcome.reset();
+		bus->outcome.hit = true;
+		return;
+	}
+	(this->*level2_proc_handler)(request, address);
+	bus->outcome.l2 = true;
+	l1->fill(block_address, getState(block_address));
+}
+
+// Snoops with an L1: the L2 answers them, and only the state changes it makes reach the L1
+void Cache::hierarchyBusRequest(BusRequest request, unsigned long long block_address) {
+	unsigned long long changes = l1->num_back_invalidations + l1->num_downgrades;
+	(this->*level2_bus_handler)(request, block_address);
+	l1->num_snoops++;
+	if (l1->num_back_invalidations + l1->num_downgrades != changes) {
+		l1->num_snoops_forwarded++;
+	}
+}
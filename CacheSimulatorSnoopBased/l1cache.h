@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "request.h"
+#include "geometry.h"
+#include "cacheset.h"
+#include "protocol.h"
+
+class StatsRegistry;
+
+// Private L1 in front of a Cache, which is then the L2 of its core: the L2 keeps the
+// coherence state and answers the snoops, and the L1 holds copies of some of its blocks
+// The L2 keeps the L1 inclusive: it back-invalidates the L1 copy of every block it evicts
+// or loses, and takes the write permission back when its block leaves a state in which
+// the protocol writes without telling the bus
+// An L1 block is Shared (read only) or Modified (writable without going to the L2)
+class L1Cache {
+	public:
+		CacheGeometry geometry;
+		std::vector<CacheSet> sets;
+		std::vector<unsigned long long> tag_store;
+		std::vector<CacheBlockState> state_store;
+		std::vector<unsigned char> repl_store;
+
+		// L2 states in which a write hit changes nothing, from the table of the protocol
+		bool writable[NUM_BLOCK_STATES];
+
+		// Counters; upgrades are writes to read-only copies, which go to the L2 as well
+		unsigned long long num_reads, num_read_misses, num_writes, num_write_misses, num_upgrades;
+		unsigned long long num_writebacks, num_back_invalidations, num_downgrades;
+
+		// Snoops the L2 answered, and those that had to reach the L1 copy
+		unsigned long long num_snoops, num_snoops_forwarded;
+
+		// The geometry has the block size of the L2, and LRU replacement
+		L1Cache(Protocol protocol, CacheGeometry _geometry);
+
+		// Returns true if the access hits with the permission it needs; counts it either way
+		bool access(ProcRequest request, unsigned long long block_address);
+
+		// Copies the block in from the L2 once the L2 has handled the access, with the
+		// permission its L2 state gives
+		void fill(unsigned long long block_address, CacheBlockState l2_state);
+
+		// Follows the L2 state of the block: drops or demotes the L1 copy if it has to
+		void update(unsigned long long block_address, CacheBlockState l2_state) {
+			int set = geometry.setIndex(block_address);
+			unsigned long long tag = geometry.tag(block_address);
+			CacheBlockState state = sets[set].getState(tag);
+			if (state == CacheBlockState::Invalid) {
+				return;
+			}
+			if (l2_state == CacheBlockState::Invalid) {
+				sets[set].setState(tag, CacheBlockState::Invalid);
+				num_back_invalidations++;
+			} else if (state == CacheBlockState::Modified && !writable[l2_state]) {
+				sets[set].setState(tag, CacheBlockState::Shared);
+				num_downgrades++;
+			}
+		}
+
+		// Prints the counters, below those of the L2
+		void printStats();
+
+		// Registers the counters under group
+		void registerStats(StatsRegistry& stats, const std::string& group);
+};
@@ -0,0 +1,17 @@
+#include "latency.h"
+
+LatencyModel::LatencyModel() {
+	hit = DEFAULT_HIT_LATENCY;
+	cache_to_cache = DEFAULT_CACHE_TO_CACHE_LATENCY;
+	llc = DEFAULT_LLC_LATENCY;
+	dram = DEFAULT_DRAM_LATENCY;
+	writeback = DEFAULT_WRITEBACK_LATENCY;
+	invalidation = DEFAULT_INVALIDATION_LATENCY;
+	l2 = DEFAULT_L2_LATENCY;
+}
+
+BusTiming::BusTiming() {
+	arbitration = Arbitration::FCFS;
+	address_cycles = DEFAULT_ADDRESS_CYCLES;
+	bandwidth = DEFAULT_BUS_BANDWIDTH;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+// Default cycles of each kind of event, see LatencyModel
+#define DEFAULT_HIT_LATENCY 1
+#define DEFAULT_CACHE_TO_CACHE_LATENCY 20
+#define DEFAULT_LLC_LATENCY 40
+#define DEFAULT_WRITEBACK_LATENCY 40
+#define DEFAULT_INVALIDATION_LATENCY 20
+#define DEFAULT_DRAM_LATENCY 160
+#define DEFAULT_L2_LATENCY 10
+
+// Defaults of the timed bus, see BusTiming
+#define DEFAULT_ADDRESS_CYCLES 2
+#define DEFAULT_BUS_BANDWIDTH 16 // bytes per cycle
+
+// What the last processor access did, recorded by the request handlers as it is handled
+class AccessOutcome {
+	public:
+		bool hit;
+		bool supplied;     // a miss served by another cache rather than the LLC
+		bool dram;         // a miss the LLC had to read from DRAM (only with an LLC model)
+		bool upgrade;      // a hit that had to send BusUpgr
+		bool l2;           // missed the L1 and went to the L2 (only with an L1)
+		int writebacks;    // blocks written back because of the access, by any cache
+		int invalidations; // copies invalidated in the other caches
+
+		void reset() {
+			hit = false;
+			supplied = false;
+			dram = false;
+			upgrade = false;
+			l2 = false;
+			writebacks = 0;
+			invalidations = 0;
+		}
+};
+
+// Cycles charged to each kind of event
+class LatencyModel {
+	public:
+		unsigned long long hit, cache_to_cache, llc, dram, writeback, invalidation, l2;
+
+		LatencyModel();
+
+		// Every access costs a hit, and one that goes on to the L2 of an L1 adds the L2; a miss adds the transfer from another cache or from the LLC
+		// (plus DRAM if the LLC missed), each writeback it caused adds a writeback, and an upgrade or a miss that invalidated
+		// other copies adds one invalidation round
+		unsigned long long cost(const AccessOutcome& outcome) const {
+			unsigned long long cycles = hit;
+			if (outcome.l2) {
+				cycles += l2;
+			}
+			if (!outcome.hit) {
+				cycles += outcome.supplied ? cache_to_cache : llc;
+			}
+			if (outcome.dram) {
+				cycles += dram;
+			}
+			cycles += outcome.writebacks * writeback;
+			if (outcome.upgrade || outcome.invalidations > 0) {
+				cycles += invalidation;
+			}
+			return cycles;
+		}
+};
+
+// Who gets the bus when several cores are waiting for it
+typedef enum {
+	FCFS,      // the core that has waited longest
+	RoundRobin // the next waiting core after the one granted last
+} Arbitration;
+
+// Parameters of the timed, split-transaction bus (see TimedBus)
+class BusTiming {
+	public:
+		Arbitration arbitration;
+
+		// Cycles of the address phase of a transaction
+		unsigned address_cycles;
+
+		// Bytes the data bus moves per cycle; a block takes block size / bandwidth cycles
+		unsigned bandwidth;
+
+		BusTiming();
+};
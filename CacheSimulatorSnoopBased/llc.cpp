@@ -0,0 +1,205 @@
+#include <iostream>
+#include <iomanip>
+#include "llc.h"
+#include "bus.h"
+#include "cache.h"
+#include "protocol.h"
+#include "stats.h"
+
+LLCConfig::LLCConfig() {
+	enabled = false;
+	inclusive = true;
+	banks = DEFAULT_LLC_BANKS;
+	set_bits = DEFAULT_LLC_SET_BITS;
+	associativity = DEFAULT_LLC_ASSOCIATIVITY;
+	replacement = ReplacementPolicy::LRU;
+}
+
+LLCBank::LLCBank(const CacheGeometry& geometry, ReplacementPolicy replacement) {
+	int ways = geometry.associativity;
+	int num_sets = geometry.numSets();
+	tag_store.resize(num_sets * ways);
+	state_store.resize(num_sets * ways);
+	repl_store.resize(num_sets * ways);
+	for (int i=0; i < num_sets; i++) {
+		sets.push_back(CacheSet(&tag_store[i * ways], &state_store[i * ways], &repl_store[i * ways], ways, replacement, &replacement_state, i));
+	}
+	num_reads = 0;
+	num_read_hits = 0;
+	num_writebacks = 0;
+	num_writeback_hits = 0;
+	num_evictions = 0;
+	num_dram_reads = 0;
+	num_dram_writebacks = 0;
+	num_back_invalidations = 0;
+}
+
+LLC::LLC(const LLCConfig& config, int _block_size, Bus* _bus) {
+	inclusive = config.inclusive;
+	block_size = _block_size;
+	geometry = CacheGeometry(config.set_bits, config.associativity, 0);
+	bank_bits = 0;
+	while ((1 << bank_bits) < config.banks) {
+		bank_bits++;
+	}
+	for (int i=0; i < config.banks; i++) {
+		banks.push_back(new LLCBank(geometry, config.replacement));
+	}
+	bus = _bus;
+}
+
+LLC::~LLC() {
+	for (size_t i=0; i < banks.size(); i++) {
+		delete banks[i];
+	}
+}
+
+template <bool Warm>
+bool LLC::readBlock(unsigned long long block_address) {
+	int bank_index = block_address & ((1ULL << bank_bits) - 1);
+	LLCBank& bank = *banks[bank_index];
+	unsigned long long bank_block = block_address >> bank_bits;
+	CacheSet& set = bank.sets[geometry.setIndex(bank_block)];
+	unsigned long long tag = geometry.tag(bank_block);
+
+	bank.num_reads += !Warm;
+	if (set.getState(tag) != CacheBlockState::Invalid) {
+		set.moveToMRU(tag);
+		bank.num_read_hits += !Warm;
+		return true;
+	}
+	bank.num_dram_reads += !Warm;
+	insert<Warm>(bank_index, block_address, CacheBlockState::Shared);
+	return false;
+}
+
+template <bool Warm>
+void LLC::writebackBlock(unsigned long long block_address) {
+	int bank_index = block_address & ((1ULL << bank_bits) - 1);
+	LLCBank& bank = *banks[bank_index];
+	unsigned long long bank_block = block_address >> bank_bits;
+	CacheSet& set = bank.sets[geometry.setIndex(bank_block)];
+	unsigned long long tag = geometry.tag(bank_block);
+
+	bank.num_writebacks += !Warm;
+	if (set.getState(tag) != CacheBlockState::Invalid) {
+		set.setState(tag, CacheBlockState::Modified);
+		bank.num_writeback_hits += !Warm;
+	} else if (inclusive) {
+		// The block was evicted (and back-invalidated) while the L1 was writing it back
+		bank.num_dram_writebacks += !Warm;
+	} else {
+		insert<Warm>(bank_index, block_address, CacheBlockState::Modified);
+	}
+}
+
+bool LLC::read(unsigned long long block_address) {
+	return readBlock<false>(block_address);
+}
+
+void LLC::writeback(unsigned long long block_address) {
+	writebackBlock<false>(block_address);
+}
+
+void LLC::warmRead(unsigned long long block_address) {
+	readBlock<true>(block_address);
+}
+
+void LLC::warmWriteback(unsigned long long block_address) {
+	writebackBlock<true>(block_address);
+}
+
+template <bool Warm>
+void LLC::insert(int bank_index, unsigned long long block_address, CacheBlockState state) {
+	LLCBank& bank = *banks[bank_index];
+	unsigned long long bank_block = block_address >> bank_bits;
+	int set = geometry.setIndex(bank_block);
+	CacheBlock evicted = bank.sets[set].insertCacheBlock(CacheBlock(geometry.tag(bank_block), state));
+	if (evicted.state == CacheBlockState::Invalid) {
+		return;
+	}
+	bank.num_evictions += !Warm;
+	bool dirty = evicted.state == CacheBlockState::Modified;
+	if (inclusive) {
+		unsigned long long evicted_address = (geometry.blockAddress(evicted.tag, set) << bank_bits) | bank_index;
+		dirty |= backInvalidate<Warm>(bank, evicted_address);
+	}
+	if (dirty) {
+		bank.num_dram_writebacks += !Warm;
+	}
+}
+
+template <bool Warm>
+bool LLC::backInvalidate(LLCBank& bank, unsigned long long block_address) {
+	bool dirty = false;
+	for (size_t i=0; i < bus->caches.size(); i++) {
+		Cache* cache = bus->caches[i];
+		CacheBlockState state = cache->getState(block_address);
+		if (state == CacheBlockState::Invalid) {
+			continue;
+		}
+		// States the protocol writes back on eviction are taken to be dirty (FESI's F included,
+		// as the protocol does not track whether F was written)
+		if (PROTOCOL_TABLES[cache->protocol].victim[state] != VictimAction::DropVictim) {
+			dirty = true;
+		}
+		cache->backInvalidate(block_address);
+		bank.num_back_invalidations += !Warm;
+	}
+	return dirty;
+}
+
+// Sums a counter over the banks
+static unsigned long long total(const std::vector<LLCBank*>& banks, unsigned long long LLCBank::*counter) {
+	unsigned long long sum = 0;
+	for (size_t i=0; i < banks.size(); i++) {
+		sum += banks[i]->*counter;
+	}
+	return sum;
+}
+
+void LLC::printStats() {
+	unsigned long long reads = total(banks, &LLCBank::num_reads);
+	unsigned long long read_hits = total(banks, &LLCBank::num_read_hits);
+	unsigned long long dram_reads = total(banks, &LLCBank::num_dram_reads);
+	unsigned long long dram_writebacks = total(banks, &LLCBank::num_dram_writebacks);
+	std::cout << std::dec << std::fixed << std::setprecision(2);
+	std::cout << ">> LLC stats (" << (inclusive ? "inclusive" : "non-inclusive") << ", " << banks.size() << " banks of "
+		<< geometry.numSets() << " sets x " << geometry.associativity << " ways)\n";
+	std::cout << "Reads               : " << reads << '\n';
+	std::cout << "Read hits           : " << read_hits << " (" << (reads ? 100.0 * read_hits / reads : 0.0) << "%)\n";
+	std::cout << "Writebacks from L1  : " << total(banks, &LLCBank::num_writebacks) << '\n';
+	std::cout << "Evictions           : " << total(banks, &LLCBank::num_evictions) << '\n';
+	std::cout << "Back-invalidations  : " << total(banks, &LLCBank::num_back_invalidations) << '\n';
+	std::cout << "DRAM reads          : " << dram_reads << " (" << dram_reads * block_size << " bytes)\n";
+	std::cout << "DRAM writebacks     : " << dram_writebacks << " (" << dram_writebacks * block_size << " bytes)\n";
+	if (banks.size() > 1) {
+		for (size_t i=0; i < banks.size(); i++) {
+			const LLCBank& bank = *banks[i];
+			std::cout << "Bank " << std::setw(4) << std::left << i << std::right << ": reads " << bank.num_reads
+				<< ", hits " << bank.num_read_hits << ", writebacks " << bank.num_writebacks
+				<< ", DRAM reads " << bank.num_dram_reads << ", DRAM writebacks " << bank.num_dram_writebacks << '\n';
+		}
+	}
+}
+
+void LLC::registerStats(StatsRegistry& stats) {
+	static const char* names[] = {"reads", "read_hits", "writebacks", "writeback_hits", "evictions",
+		"dram_reads", "dram_writebacks", "back_invalidations"};
+	unsigned long long LLCBank::*counters[] = {&LLCBank::num_reads, &LLCBank::num_read_hits, &LLCBank::num_writebacks,
+		&LLCBank::num_writeback_hits, &LLCBank::num_evictions, &LLCBank::num_dram_reads, &LLCBank::num_dram_writebacks,
+		&LLCBank::num_back_invalidations};
+	for (int c=0; c < 8; c++) {
+		unsigned long long LLCBank::*counter = counters[c];
+		stats.add("llc", names[c], [this, counter]() { return total(banks, counter); });
+	}
+	if (banks.size() == 1) {
+		return;
+	}
+	for (size_t i=0; i < banks.size(); i++) {
+		std::string group = "llc_bank" + std::to_string(i);
+		for (int c=0; c < 8; c++) {
+			stats.add(group, names[c], &(banks[i]->*counters[c]));
+		}
+	}
+}
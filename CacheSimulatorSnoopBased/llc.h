@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include "geometry.h"
+#include "cacheset.h"
+
+class Bus;
+class StatsRegistry;
+
+// Defaults of the LLC, per bank
+#define DEFAULT_LLC_BANKS 4
+#define DEFAULT_LLC_SET_BITS 10
+#define DEFAULT_LLC_ASSOCIATIVITY 16
+
+// Shape and policy of the LLC, chosen on the command line
+class LLCConfig {
+	public:
+		// Without an LLC, every block no cache supplies is simply counted as From LLC
+		bool enabled;
+
+		// An inclusive LLC holds every block of the L1 caches, and invalidates the
+		// L1 copies of the blocks it evicts
+		bool inclusive;
+
+		// Banks (a power of two), and sets (a power of two) and ways of each bank
+		int banks;
+		int set_bits;
+		int associativity;
+
+		ReplacementPolicy replacement;
+
+		LLCConfig();
+};
+
+// One address-interleaved bank of the LLC, with its own array and counters
+class LLCBank {
+	public:
+		std::vector<CacheSet> sets;
+		std::vector<unsigned long long> tag_store;
+		std::vector<CacheBlockState> state_store;
+		std::vector<unsigned char> repl_store;
+		ReplacementState replacement_state;
+
+		// Counters
+		unsigned long long num_reads, num_read_hits, num_writebacks, num_writeback_hits, num_evictions;
+		unsigned long long num_dram_reads, num_dram_writebacks, num_back_invalidations;
+
+		LLCBank(const CacheGeometry& geometry, ReplacementPolicy replacement);
+};
+
+// Shared last-level cache behind the bus, in front of DRAM
+// It is filled by the L1 misses no cache supplies and by the L1 writebacks (Flush);
+// its blocks are Shared (clean) or Modified (to be written back to DRAM)
+class LLC {
+	public:
+		bool inclusive;
+		int block_size;
+
+		// Geometry of one bank; block addresses are divided among the banks by their low bits first
+		CacheGeometry geometry;
+		int bank_bits;
+		std::vector<LLCBank*> banks;
+
+		// Bus of the L1 caches, for back-invalidations
+		Bus* bus;
+
+		LLC(const LLCConfig& config, int _block_size, Bus* _bus);
+		~LLC();
+
+		// Reads the block for an L1 miss that no cache supplied
+		// Returns true on an LLC hit, false if the block had to be read from DRAM
+		bool read(unsigned long long block_address);
+
+		// Takes a block written back by an L1 cache
+		void writeback(unsigned long long block_address);
+
+		// Functional warming versions of read and writeback, which count nothing
+		void warmRead(unsigned long long block_address);
+		void warmWriteback(unsigned long long block_address);
+
+		// Prints the counts, the DRAM traffic and, with several banks, the counts per bank
+		void printStats();
+
+		// Registers the totals under "llc", and the counters of every bank under "llc_bank<i>"
+		// when there are several
+		void registerStats(StatsRegistry& stats);
+
+	private:
+		// The implementations of the above; Warm leaves the counters alone
+		template <bool Warm>
+		bool readBlock(unsigned long long block_address);
+		template <bool Warm>
+		void writebackBlock(unsigned long long block_address);
+
+		// Inserts the block in its bank, evicting (and back-invalidating) a victim if needed
+		template <bool Warm>
+		void insert(int bank, unsigned long long block_address, CacheBlockState state);
+
+		// Invalidates the L1 copies of the block
+		// Returns true if one of them was dirty
+		template <bool Warm>
+		bool backInvalidate(LLCBank& bank, unsigned long long block_address);
+};
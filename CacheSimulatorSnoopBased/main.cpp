@@ -1,115 +1,360 @@
 #include <iostream>
 #include <vector>
-#include <list>
-#include "cache.h"
-#include "bus.h"
+#include <algorithm>
+#include "checkpoint.h"
+#include "config.h"
+#include "pipeline.h"
+#include "protocol.h"
+#include "sampling.h"
+#include "shard.h"
+#include "shmring.h"
+#include "simulator.h"
+#include "sweep.h"
+#include "timedbus.h"
+#include "trace.h"
+#include "workload.h"
 using namespace std;
 
-int main() {
-	int total_reads = 0;
-	int total_read_misses = 0;
-	int total_writes = 0;
-	int total_write_misses = 0;
-	int total_invalidations = 0;
-	int total_writebacks = 0;
-	int total_provided = 0;
-	int total_fromLLC = 0;
-	int total_random = 0;
-
-	Protocol protocol;
-	string protocolName;
-	cin >> protocolName;
-	
-	if( protocolName == "MESI" )
-	{
-		protocol = Protocol::MESI;
-		cout << "Protocol Used : MESI" << endl;
-	}
-	else if( protocolName == "MSI" )
-	{
-		protocol = Protocol::MSI;
-		cout << "Protocol Used : MSI" << endl;
-	}
-	else if( protocolName == "MESIF" )
-	{
-		protocol = Protocol::MESIF;
-		cout << "Protocol Used : MESIF" << endl;
-	}
-	else if( protocolName == "MOESI" )
-	{
-		protocol = Protocol::MOESI;
-		cout << "Protocol Used : MOESI" << endl;
-	}
-	else if( protocolName == "FESI" )
-	{
-		protocol = Protocol::FESI;
-		cout << "Protocol Used : FESI" << endl;
-	}
-	else
-	{
-		exit(0);	
-	}
-
-	vector<Cache*> caches;
-	for (int i=0; i < NUMBER_OF_CORES; i++) {
-		caches.push_back(new Cache(i, protocol));
-	}
-
-	Bus bus(caches);
-	for (int i=0; i < NUMBER_OF_CORES; i++) {
-		caches[i]->setBus(&bus);
-	}
-
-	int core;
-	char r_or_w;
-	unsigned long long address;
-	while (true) {
-		cin >> core;
-		if (core == -1) {
-			break;
-		}
-		cin >> r_or_w >> hex >> address;
-		if (core >= NUMBER_OF_CORES || core < 0) {
-			cout << "Incorrect core number " << core << endl;
+// Reads and drops the first count records of source
+// Returns false if the trace ends first
+static bool skipRecords(RecordSource& source, uint64_t count) {
+	vector<TraceRecord> scratch(4096);
+	while (count > 0) {
+		size_t read = source(scratch.data(), min<uint64_t>(count, scratch.size()));
+		if (read == 0) {
+			return false;
+		}
+		count -= read;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[]) {
+	SimConfig config;
+	if (!parseArgs(argc, argv, config)) {
+		exit(1);
+	}
+	int num_cores = config.cores;
+
+	// Traces other than stdin come from --trace
+	const char* trace_path = config.trace_path.empty() ? "-" : config.trace_path.c_str();
+
+	if (!config.convert_path.empty()) {
+		TraceReader reader;
+		if (!reader.open(trace_path)) {
+			return 1;
+		}
+		return convertTrace(reader, config.convert_path.c_str(), config.convert_compact);
+	}
+
+	// An uncompressed binary trace is mapped and read in place, anything else is
+	// decoded as it streams in
+	TraceFile trace;
+	TraceReader reader;
+	ShmConsumer ring;
+	bool shm = !config.shm_name.empty();
+	bool binary_trace = !config.trace_path.empty() && isBinaryTrace(trace_path);
+	// An uncompressed compact trace is decoded in parallel when it is loaded whole
+	bool compact_trace = !config.trace_path.empty() && isCompactTrace(trace_path);
+	if (binary_trace && !trace.open(trace_path)) {
+		exit(1);
+	}
+	if (!binary_trace && !config.use_workload && !shm && !reader.open(trace_path)) {
+		exit(1);
+	}
+	if (shm && !ring.open(config.shm_name.c_str(), config.shm_timeout)) {
+		exit(1);
+	}
+
+	Protocol protocol = config.protocol;
+	if (config.use_workload) {
+		// Nothing to read: the accesses are generated as the simulation runs
+	} else if (shm) {
+		if (ring.protocol() > Protocol::FESI) {
+			exit(0);
+		}
+		protocol = (Protocol) ring.protocol();
+	} else if (binary_trace) {
+		if (trace.header->protocol > Protocol::FESI) {
+			exit(0);
+		}
+		protocol = (Protocol) trace.header->protocol;
+	} else {
+		string name;
+		if (!reader.readProtocol(protocol, name)) {
+			exit(0);
+		}
+	}
+
+	bool sweep = !config.sweep_protocols.empty() || !config.sweep_geometries.empty();
+	vector<SweepPoint> points;
+	if (sweep) {
+		vector<Protocol> protocols = config.sweep_protocols;
+		if (protocols.empty()) {
+			protocols.push_back(protocol);
+		}
+		vector<CacheGeometry> geometries = config.sweep_geometries;
+		if (geometries.empty()) {
+			geometries.push_back(config.geometry);
+		}
+		for (size_t p=0; p < protocols.size(); p++) {
+			for (size_t g=0; g < geometries.size(); g++) {
+				points.push_back(SweepPoint(protocols[p], geometries[g]));
+			}
+		}
+	}
+
+	if (sweep && config.use_workload) {
+		runSweep(config.workload, points, config);
+		return 0;
+	}
+
+	if (sweep) {
+		// The trace is decoded once and shared read-only by every configuration
+		vector<TraceRecord> text_records;
+		const TraceRecord* records = trace.records;
+		uint64_t num_records = binary_trace ? trace.size() : 0;
+		if (!binary_trace) {
+			bool loaded = compact_trace ? loadCompactTrace(trace_path, config.threads, text_records) : loadTrace(reader, text_records);
+			if (!loaded) {
+				exit(1);
+			}
+			records = text_records.data();
+			num_records = text_records.size();
+		}
+		for (uint64_t i=0; i < num_records; i++) {
+			if (records[i].core >= num_cores) {
+				cout << "Incorrect core number " << records[i].core << endl;
+				exit(0);
+			}
+		}
+
+		runSweep(records, num_records, points, config);
+		return 0;
+	}
+
+	vector<SimPoint> simpoints;
+	if (!config.sampling.simpoints_path.empty() && !loadSimPoints(config.sampling, simpoints)) {
+		exit(1);
+	}
+
+	// The snoop filter gives the same results and spares the warming most of its snoops
+	if (config.sampling.enabled) {
+		config.snoop_filter = true;
+	}
+
+	if (config.directory && protocol != Protocol::FESI) {
+		cout << "The directory backend implements FESI only, not " << protocolName(protocol) << endl;
+		exit(1);
+	}
+
+	// The checkpoint is mapped before the simulator is built, and unmapped after it is gone
+	Checkpoint checkpoint;
+	if (!config.restore_path.empty() && (!checkpoint.open(config.restore_path.c_str()) || !checkpoint.matches(protocol, config))) {
+		exit(1);
+	}
+
+	// JSON and CSV on stdout carry the protocol themselves
+	if (config.stats.format == TextStats || !config.stats.path.empty()) {
+		cout << "Protocol Used : " << protocolName(protocol) << endl;
+	}
+
+	Simulator sim(protocol, config.geometry, config);
+
+	// Accesses are numbered from the start of the trace, whether or not the run starts there
+	uint64_t position = 0;
+	uint64_t stop_position = config.checkpoint_at ? config.checkpoint_at : UINT64_MAX;
+
+	WorkloadSpec spec = config.workload;
+	spec.cores = num_cores;
+	spec.block_size = config.geometry.blockSize();
+	if (!config.save_checkpoint_path.empty()) {
+		spec.accesses = min<uint64_t>(spec.accesses, stop_position);
+	}
+	WorkloadGenerator generator(spec);
+
+	// The timed bus and the sampler pull the accesses themselves
+	uint64_t next_record = 0;
+	RecordSource source = [&](TraceRecord* records, size_t max_records) -> size_t {
+		if (config.use_workload) {
+			return generator.fill(records, max_records);
+		}
+		if (shm) {
+			return ring.read(records, max_records);
+		}
+		if (binary_trace) {
+			size_t count = min<uint64_t>(max_records, trace.size() - next_record);
+			copy(trace.records + next_record, trace.records + next_record + count, records);
+			next_record += count;
+			return count;
+		}
+		return reader.read(records, max_records);
+	};
+
+	if (!config.restore_path.empty()) {
+		checkpoint.restore(sim);
+		position = checkpoint.header->position;
+		bool skipped = binary_trace ? position <= trace.size() : skipRecords(source, position);
+		if (!skipped) {
+			cout << "The trace ends before the checkpoint, at access " << position << endl;
+			exit(1);
+		}
+		next_record = position;
+	}
+
+	if (config.sampling.enabled) {
+		Sampler sampler(sim, config.sampling, simpoints);
+		int bad_core;
+		if (!sampler.run(source, bad_core)) {
+			cout << "Incorrect core number " << bad_core << endl;
+			exit(0);
+		}
+		if (reader.has_bad_core) {
+			cout << "Incorrect core number " << reader.bad_core << endl;
+			exit(0);
+		}
+		if (reader.error() || ring.error()) {
+			exit(1);
+		}
+		cout << "---- " << endl;
+		sampler.printStats();
+		if (sim.profiler != NULL) {
+			// Only the accesses simulated in detail are profiled
+			cout << "---- " << endl;
+			sim.profiler->printReport();
+		}
+		return 0;
+	}
+
+	if (config.timed_bus) {
+		// The timed bus reorders the accesses across cores by time
+		TimedBus timed_bus(sim, config.bus_timing);
+		int bad_core;
+		if (!timed_bus.run(source, bad_core)) {
+			cout << "Incorrect core number " << bad_core << endl;
+			exit(0);
+		}
+		if (reader.has_bad_core) {
+			cout << "Incorrect core number " << reader.bad_core << endl;
 			exit(0);
 		}
-		if (r_or_w == 'r') {
-			caches[core]->handleProcRequest(ProcRequest::ProcRd, address);
-		} else if (r_or_w == 'w') {
-			caches[core]->handleProcRequest(ProcRequest::ProcWr, address);
-		}
-	}
-
-	// calculate overall stats from all Caches
-	for (int i=0; i < NUMBER_OF_CORES; i++) {
-		total_reads += caches[i]->returnStats(CacheStats::Reads);
-		total_read_misses += caches[i]->returnStats(CacheStats::Read_misses);
-		total_writes += caches[i]->returnStats(CacheStats::Writes);
-		total_write_misses += caches[i]->returnStats(CacheStats::Write_misses);
-		total_invalidations += caches[i]->returnStats(CacheStats::Invalidations);
-		total_writebacks += caches[i]->returnStats(CacheStats::Writebacks);
-		total_provided += caches[i]->returnStats(CacheStats::Provided);
-		total_fromLLC += caches[i]->returnStats(CacheStats::FromLLC);
-		total_random += caches[i]->returnStats(CacheStats::Random);
-	}	
-
-	// Print the statistics and contents of cache
-	for (int i=0; i < NUMBER_OF_CORES; i++) {
-		caches[i]->printStats();
-	}
-	std::cout << "---- " << std::endl;
-	bus.printStats();
-
-	// Print the total cache statistics
-	std::cout << "---- " << std::endl;
-	std::cout << ">>>> Total Cache Stats "<< std::endl;
-	std::cout << "Reads         : " << total_reads << std::endl;
-	std::cout << "Read misses   : " << total_read_misses << std::endl;
-	std::cout << "Writes        : " << total_writes << std::endl;
-	std::cout << "Write misses  : " << total_write_misses << std::endl;
-	std::cout << "Writebacks    : " << total_writebacks << std::endl;
-	std::cout << "Invalidations : " << total_invalidations << std::endl;
-	std::cout << "Provided      : " << total_provided << std::endl;
-	std::cout << "From LLC      : " << total_fromLLC << std::endl;
-	std::cout << "Random        : " << total_random << std::endl;
+		if (reader.error() || ring.error()) {
+			exit(1);
+		}
+		if (!sim.printStats()) {
+			exit(1);
+		}
+		cout << "---- " << endl;
+		timed_bus.printStats();
+		return 0;
+	}
+
+	// Without a checkpoint to save, stop_position is never reached
+	if (config.shards > 1) {
+		// Every shard scans all the accesses for those to its sets, so they are loaded first
+		vector<TraceRecord> loaded;
+		const TraceRecord* records = trace.records;
+		uint64_t num_records = binary_trace ? trace.size() : 0;
+		if (config.use_workload) {
+			loaded.resize(spec.accesses);
+			size_t count;
+			while ((count = generator.fill(loaded.data() + num_records, loaded.size() - num_records)) > 0) {
+				num_records += count;
+			}
+			loaded.resize(num_records);
+		} else if (compact_trace) {
+			if (!loadCompactTrace(trace_path, config.threads, loaded)) {
+				exit(1);
+			}
+		} else if (!binary_trace && !loadTrace(reader, loaded)) {
+			exit(reader.has_bad_core ? 0 : 1);
+		}
+		if (!binary_trace) {
+			records = loaded.data();
+			num_records = loaded.size();
+		}
+		for (uint64_t i=0; i < num_records; i++) {
+			if (records[i].core >= num_cores) {
+				cout << "Incorrect core number " << records[i].core << endl;
+				exit(0);
+			}
+		}
+		runSharded(sim, records, num_records, config);
+		position = num_records;
+	} else if (config.use_workload) {
+		sim.runWorkload(generator);
+		position = spec.accesses;
+	} else if (binary_trace) {
+		// Records are read straight out of the mapping, no parsing or copying
+		const TraceRecord* records = trace.records;
+		uint64_t num_records = min(trace.size(), stop_position);
+		for (uint64_t i=position; i < num_records; i++) {
+			if (records[i].core >= num_cores) {
+				cout << "Incorrect core number " << records[i].core << endl;
+				exit(0);
+			}
+			sim.access(records[i].core, (ProcRequest) records[i].op, records[i].address);
+		}
+		position = max(position, num_records);
+	} else if (shm) {
+		// Records are read out of the ring one at a time, and handed back a batch at a time
+		const TraceRecord* records;
+		size_t count;
+		while (position < stop_position && (count = ring.next(records, min<uint64_t>(PIPELINE_BATCH_SIZE, stop_position - position))) > 0) {
+			for (size_t i=0; i < count; i++) {
+				// Copied first: the producer owns the memory, and could change it after the checks
+				TraceRecord record = records[i];
+				if (record.core >= num_cores) {
+					cout << "Incorrect core number " << record.core << endl;
+					exit(0);
+				}
+				if (!ring.validOp(record)) {
+					exit(1);
+				}
+				sim.access(record.core, (ProcRequest) record.op, record.address);
+			}
+			ring.release(count);
+			position += count;
+		}
+		if (ring.error()) {
+			exit(1);
+		}
+	} else {
+		// The reader thread decodes the next batches while this one is simulated
+		TracePipeline pipeline(reader);
+		TraceBatch* batch;
+		while (position < stop_position && (batch = pipeline.next()) != NULL) {
+			size_t count = min<uint64_t>(batch->count, stop_position - position);
+			for (size_t i=0; i < count; i++) {
+				const TraceRecord& record = batch->records[i];
+				if (record.core >= num_cores) {
+					cout << "Incorrect core number " << record.core << endl;
+					exit(0);
+				}
+				sim.access(record.core, (ProcRequest) record.op, record.address);
+			}
+			position += count;
+			pipeline.release(batch);
+		}
+		if (reader.has_bad_core) {
+			cout << "Incorrect core number " << reader.bad_core << endl;
+			exit(0);
+		}
+		if (reader.error()) {
+			exit(1);
+		}
+	}
+
+	if (!config.save_checkpoint_path.empty() && !saveCheckpoint(config.save_checkpoint_path.c_str(), sim, config, position)) {
+		exit(1);
+	}
+
+	if (!sim.printStats()) {
+		exit(1);
+	}
+
+	if (!config.save_checkpoint_path.empty()) {
+		cout << "---- " << endl;
+		cout << "Checkpoint after " << dec << position << " accesses saved to " << config.save_checkpoint_path << endl;
+	}
 }
@@ -0,0 +1,1389 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include "modelcheck.h"
+
+static const char* CACHE_STATE_NAMES[NUM_MODEL_CACHE_STATES] = {
+	"I", "F", "S", "E",
+	"IE_D", "IF_AD", "IF_A", "SF_AD", "SF_A", "FF_AA", "FF_A",
+	"FI_A", "SI_A", "EI_A", "II_A"
+};
+
+static const char* DIRECTORY_STATE_NAMES[NUM_MODEL_DIRECTORY_STATES] = {
+	"I", "E", "F", "F_AS", "FF_A", "F_m", "E_m", "FI_m"
+};
+
+static const char* MESSAGE_NAMES[NUM_MODEL_MESSAGES] = {
+	"GetS", "GetM", "PutS", "PutE", "PutF",
+	"Inv", "PutAck", "FAllocReq", "AllocF",
+	"Data", "ExclusiveData", "InvAck", "AckCount", "StoFAck", "StoFInvAck", "SFDone",
+	"MEMORY_READ", "MEMORY_WB"
+};
+
+static const char* CACHE_EVENT_NAMES[NUM_MODEL_CACHE_EVENTS] = {
+	"Load", "Store", "Replacement",
+	"FwdGetS", "FwdGetM", "Inv", "PutAck", "FAllocReq", "AllocF",
+	"ExclusiveData", "DataDir", "AckCount", "NoAckCount", "DataOwnerNoAcks", "DataOwnerAcks",
+	"InvAck", "LastInvAck"
+};
+
+static const char* DIRECTORY_EVENT_NAMES[NUM_MODEL_DIRECTORY_EVENTS] = {
+	"GetS", "GetMNonOwner", "GetMOwner", "PutSSharer", "PutSNonSharer",
+	"PutFOwnerSharer", "PutFOwnerNoSharer", "PutFNonOwner", "PutEOwner", "PutENonOwner",
+	"StoFAck", "StoFInvAck", "LastStoFInvAck", "SFDone", "MemData", "MemAck"
+};
+
+// Acks outstanding are packed in 3 bits
+#define MIN_ACKS -4
+#define MAX_ACKS 3
+
+// Blocks are read in the states with Read_Only or Read_Write permission in FESI-cache.sm
+static bool canRead(int state) {
+	return state == CE || state == CF || state == CS || state == CSF_AD || state == CSF_A;
+}
+
+// States with a TBE, the only ones a response may arrive in
+static bool hasTBE(int state) {
+	return state >= CIE_D && state <= CFF_A;
+}
+
+// States whose data is not used: the block is not allocated, or waits for its data
+static bool holdsData(int state) {
+	return state != CI && state != CIE_D && state != CIF_AD && state != CII_A;
+}
+
+static bool isStable(int state) {
+	return state <= CE;
+}
+
+static int bit(int cache) {
+	return 1 << cache;
+}
+
+void ModelQueue::pop() {
+	for (int i=1; i < length; i++) {
+		messages[i - 1] = messages[i];
+	}
+	length--;
+}
+
+ModelState::ModelState() {
+	for (int c=0; c < MODEL_MAX_CACHES; c++) {
+		for (int a=0; a < MODEL_MAX_ADDRESSES; a++) {
+			cache_state[c][a] = CI;
+			acks[c][a] = 0;
+			cache_data[c][a] = 0;
+		}
+		forward_in[c].length = 0;
+		response_in[c].length = 0;
+	}
+	for (int a=0; a < MODEL_MAX_ADDRESSES; a++) {
+		directory_state[a] = DI;
+		owners[a] = 0;
+		sharers[a] = 0;
+		memory[a] = 0;
+		latest[a] = 0;
+	}
+	request_in.length = 0;
+	directory_response_in.length = 0;
+	memory_request_in.length = 0;
+	memory_response_in.length = 0;
+}
+
+static std::string machineName(int machine, const int* names, bool with_ids) {
+	if (machine == MODEL_DIRECTORY) {
+		return "Dir";
+	}
+	if (machine == MODEL_MEMORY) {
+		return "Memory";
+	}
+	if (!with_ids) {
+		return "Cache";
+	}
+	return "Cache " + std::to_string(names != NULL ? names[machine] : machine);
+}
+
+std::string ModelError::describe(const int* names, bool with_ids) const {
+	std::ostringstream out;
+	bool directory = machine == MODEL_DIRECTORY;
+	std::string where;
+	if (machine == MODEL_MEMORY) {
+		where = "Memory for A" + std::to_string(address);
+	} else if (machine >= 0) {
+		where = machineName(machine, names, with_ids) + " in "
+			+ (directory ? DIRECTORY_STATE_NAMES[state] : CACHE_STATE_NAMES[state]);
+		if (event >= 0) {
+			where += std::string(" on ") + (directory ? DIRECTORY_EVENT_NAMES[event] : CACHE_EVENT_NAMES[event]);
+		}
+		where += " for A" + std::to_string(address);
+	}
+	switch (kind) {
+		case InvalidTransition:
+			out << "Invalid transition: " << where;
+			break;
+		case FailedAssertion:
+			out << "Failed assertion: " << where;
+			break;
+		case SWMRViolation:
+			out << "SWMR violated: " << where << ", while " << machineName(other, names, with_ids) << " can read it";
+			break;
+		case DataValueViolation:
+			out << "Data value violated: " << where << " holds a stale value";
+			break;
+		case MemoryValueViolation:
+			out << "Memory value violated: A" << address << " is in no cache and memory is stale";
+			break;
+		case Deadlock:
+			out << "Deadlock: work is pending and no message can be handled";
+			break;
+	}
+	return out.str();
+}
+
+ModelConfig::ModelConfig() {
+	caches = 3;
+	addresses = 1;
+	queue_depth = 4;
+	threads = std::max(1u, std::thread::hardware_concurrency());
+	symmetry = true;
+	keep_going = false;
+	max_states = 50000000;
+}
+
+// The state changes of one rule, made on the next state; fail records the first error
+class Transition {
+	public:
+		const ModelConfig& config;
+		ModelState& s;
+		ModelError& error;
+		bool failed;
+
+		// Whether a buffer sent to is full, which stalls the transition, as the check of
+		// the slots of the out ports does in gem5
+		bool blocked;
+
+		Transition(const ModelConfig& _config, ModelState& _s, ModelError& _error) : config(_config), s(_s), error(_error) {
+			failed = false;
+			blocked = false;
+		}
+
+		// The machine, its state and the event being handled, for the errors
+		void at(int machine, int state, int event, int address) {
+			error.machine = machine;
+			error.state = state;
+			error.event = event;
+			error.address = address;
+			error.other = -1;
+		}
+
+		void fail(ModelErrorKind kind) {
+			if (!failed) {
+				error.kind = kind;
+				failed = true;
+			}
+		}
+
+		void send(ModelQueue& queue, int type, int address, int sender, int acks, int data) {
+			if (queue.length >= config.queue_depth) {
+				blocked = true;
+				return;
+			}
+			ModelMessage& message = queue.messages[queue.length++];
+			message.type = type;
+			message.address = address;
+			message.sender = sender;
+			message.acks = acks;
+			message.data = data;
+		}
+
+		// Performs a store of the cache, which must be the only one that can read the block
+		void store(int cache, int address) {
+			for (int c=0; c < config.caches; c++) {
+				if (c != cache && canRead(s.cache_state[c][address])) {
+					fail(SWMRViolation);
+					error.other = c;
+					return;
+				}
+			}
+			s.latest[address] ^= 1;
+			s.cache_data[cache][address] = s.latest[address];
+		}
+
+		void storeAcks(int cache, int address, const ModelMessage& in) {
+			int acks = s.acks[cache][address] + in.acks;
+			if (acks <= 0 || acks > MAX_ACKS) {
+				fail(FailedAssertion);
+				return;
+			}
+			s.acks[cache][address] = acks;
+		}
+
+		void decrementAcks(int cache, int address) {
+			if (s.acks[cache][address] == MIN_ACKS) {
+				fail(FailedAssertion);
+				return;
+			}
+			s.acks[cache][address]--;
+		}
+
+		FESIModel::RuleResult cacheTransition(int c, int a, int event, const ModelMessage& in);
+		FESIModel::RuleResult directoryTransition(int a, int event, const ModelMessage& in);
+};
+
+// The transitions of FESI-cache.sm
+FESIModel::RuleResult Transition::cacheTransition(int c, int a, int event, const ModelMessage& in) {
+	unsigned char& state = s.cache_state[c][a];
+	unsigned char& data = s.cache_data[c][a];
+	bool processor = event <= EvReplacement;
+	at(c, state, event, a);
+
+	switch (state) {
+		case CI:
+			if (event == EvLoad) {
+				send(s.request_in, MGetS, a, c, 0, 0);
+				state = CIE_D;
+			} else if (event == EvStore) {
+				send(s.request_in, MGetM, a, c, 0, 0);
+				state = CIF_AD;
+			} else if (event == EvReplacement) {
+				return FESIModel::RuleDisabled;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CE:
+		case CF:
+			if (event == EvLoad) {
+				// Load hit
+			} else if (event == EvStore && state == CE) {
+				store(c, a);
+				state = CF;
+			} else if (event == EvStore) {
+				send(s.request_in, MGetM, a, c, 0, 0);
+				state = CFF_AA;
+			} else if (event == EvReplacement && state == CE) {
+				send(s.request_in, MPutE, a, c, 0, 0);
+				state = CEI_A;
+			} else if (event == EvReplacement) {
+				send(s.request_in, MPutF, a, c, 0, data);
+				state = CFI_A;
+			} else if (event == EvFwdGetS) {
+				send(s.response_in[in.sender], MData, a, c, in.acks, data);
+				s.forward_in[c].pop();
+				state = CS;
+			} else if (event == EvFwdGetM) {
+				send(s.response_in[in.sender], MData, a, c, in.acks, data);
+				s.forward_in[c].pop();
+				state = CI;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CS:
+			if (event == EvLoad) {
+				// Load hit
+			} else if (event == EvStore) {
+				send(s.request_in, MGetM, a, c, 0, 0);
+				state = CSF_AD;
+			} else if (event == EvReplacement) {
+				send(s.request_in, MPutS, a, c, 0, 0);
+				state = CSI_A;
+			} else if (event == EvInv) {
+				send(s.response_in[in.sender], MInvAck, a, c, 0, 0);
+				s.forward_in[c].pop();
+				state = CI;
+			} else if (event == EvFAllocReq) {
+				send(s.directory_response_in, MStoFAck, a, c, 0, 0);
+				s.forward_in[c].pop();
+			} else if (event == EvAllocF) {
+				send(s.directory_response_in, MSFDone, a, c, 0, 0);
+				s.forward_in[c].pop();
+				state = CF;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CIE_D:
+			if (processor || event == EvFwdGetS || event == EvFwdGetM) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvExclusiveData || event == EvDataOwnerNoAcks) {
+				data = in.data;
+				s.acks[c][a] = 0;
+				s.response_in[c].pop();
+				state = event == EvExclusiveData ? CE : CF;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CIF_AD:
+			if (processor || event == EvFwdGetS || event == EvFwdGetM) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvDataOwnerNoAcks || event == EvDataDir) {
+				data = in.data;
+				s.acks[c][a] = 0;
+				store(c, a);
+				s.response_in[c].pop();
+				state = CF;
+			} else if (event == EvDataOwnerAcks) {
+				data = in.data;
+				storeAcks(c, a, in);
+				s.response_in[c].pop();
+				state = CIF_A;
+			} else if (event == EvInvAck) {
+				decrementAcks(c, a);
+				s.response_in[c].pop();
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CIF_A:
+		case CSF_A:
+			if (processor || event == EvFwdGetS || event == EvFwdGetM) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvInvAck) {
+				decrementAcks(c, a);
+				s.response_in[c].pop();
+			} else if (event == EvLastInvAck) {
+				s.acks[c][a] = 0;
+				store(c, a);
+				s.response_in[c].pop();
+				state = CF;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CSF_AD:
+			if (processor || event == EvFwdGetS || event == EvFwdGetM) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvFAllocReq) {
+				send(s.directory_response_in, MStoFAck, a, c, 0, 0);
+				s.forward_in[c].pop();
+			} else if (event == EvInvAck) {
+				decrementAcks(c, a);
+				s.response_in[c].pop();
+			} else if (event == EvInv) {
+				send(s.response_in[in.sender], MInvAck, a, c, 0, 0);
+				s.forward_in[c].pop();
+				state = CIF_AD;
+			} else if (event == EvDataOwnerNoAcks) {
+				data = in.data;
+				s.acks[c][a] = 0;
+				store(c, a);
+				s.response_in[c].pop();
+				state = CF;
+			} else if (event == EvDataOwnerAcks) {
+				data = in.data;
+				storeAcks(c, a, in);
+				s.response_in[c].pop();
+				state = CSF_A;
+			} else if (event == EvAllocF) {
+				send(s.directory_response_in, MSFDone, a, c, 0, 0);
+				s.forward_in[c].pop();
+				state = CFF_AA;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CFF_AA:
+			if (processor) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvInvAck) {
+				decrementAcks(c, a);
+				s.response_in[c].pop();
+			} else if (event == EvFwdGetS || event == EvFwdGetM) {
+				send(s.response_in[in.sender], MData, a, c, in.acks, data);
+				s.forward_in[c].pop();
+				state = event == EvFwdGetS ? CSF_AD : CIF_AD;
+			} else if (event == EvAckCount) {
+				storeAcks(c, a, in);
+				s.response_in[c].pop();
+				state = CFF_A;
+			} else if (event == EvNoAckCount) {
+				s.acks[c][a] = 0;
+				store(c, a);
+				s.response_in[c].pop();
+				state = CF;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CFF_A:
+			if (processor || event == EvFwdGetS || event == EvFwdGetM) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvInvAck) {
+				decrementAcks(c, a);
+				s.response_in[c].pop();
+			} else if (event == EvLastInvAck) {
+				s.acks[c][a] = 0;
+				store(c, a);
+				s.response_in[c].pop();
+				state = CF;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CEI_A:
+		case CFI_A:
+			if (processor) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvFwdGetS || event == EvFwdGetM) {
+				send(s.response_in[in.sender], MData, a, c, in.acks, data);
+				s.forward_in[c].pop();
+				state = event == EvFwdGetS ? CSI_A : CII_A;
+			} else if (event == EvPutAck) {
+				s.forward_in[c].pop();
+				state = CI;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CSI_A:
+			if (processor) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvPutAck) {
+				s.forward_in[c].pop();
+				state = CI;
+			} else if (event == EvInv) {
+				send(s.response_in[in.sender], MInvAck, a, c, 0, 0);
+				s.forward_in[c].pop();
+				state = CII_A;
+			} else if (event == EvFAllocReq) {
+				send(s.directory_response_in, MStoFInvAck, a, c, 0, 0);
+				s.forward_in[c].pop();
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case CII_A:
+			if (processor) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvPutAck) {
+				s.forward_in[c].pop();
+				state = CI;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+	}
+	if (blocked) {
+		return FESIModel::RuleDisabled;
+	}
+	if (failed) {
+		return FESIModel::RuleFailed;
+	}
+	if (!holdsData(state)) {
+		data = 0;
+	}
+	return FESIModel::RuleTaken;
+}
+
+// The transitions of FESI-dir.sm; in is the message handled, from the request,
+// response or memory buffer
+FESIModel::RuleResult Transition::directoryTransition(int a, int event, const ModelMessage& in) {
+	unsigned char& state = s.directory_state[a];
+	unsigned char& owners = s.owners[a];
+	unsigned char& sharers = s.sharers[a];
+	at(MODEL_DIRECTORY, state, event, a);
+
+	bool get = event == EvGetS || event == EvGetMOwner || event == EvGetMNonOwner;
+	bool put_ack = event == EvPutSSharer || event == EvPutSNonSharer || event == EvPutENonOwner || event == EvPutFNonOwner;
+	bool put_f = event == EvPutFOwnerSharer || event == EvPutFOwnerNoSharer || event == EvPutFNonOwner;
+	bool sharer_ack = event == EvStoFAck || event == EvStoFInvAck || event == EvLastStoFInvAck;
+
+	// The PutF a replacement of the owner leaves at the head of the request buffer
+	ModelMessage put = s.request_in.length > 0 ? s.request_in.head() : in;
+	if (state == DF_AS || state == DFF_A) {
+		if (s.request_in.length == 0 || put.type != MPutF || put.address != a) {
+			fail(FailedAssertion);
+			return FESIModel::RuleFailed;
+		}
+	}
+
+	// The owner is a set in FESI-dir.sm, which must hold one cache to forward to
+	int owner = __builtin_ctz(owners | 0x100);
+	bool one_owner = __builtin_popcount(owners) == 1;
+
+	switch (state) {
+		case DI:
+			if (event == EvGetS || event == EvGetMNonOwner) {
+				send(s.memory_request_in, MMemoryRead, a, in.sender, 0, 0);
+				owners |= bit(in.sender);
+				s.request_in.pop();
+				state = event == EvGetS ? DE_m : DF_m;
+			} else if (put_ack) {
+				send(s.forward_in[in.sender], MPutAck, a, MODEL_DIRECTORY, 0, 0);
+				s.request_in.pop();
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case DE_m:
+		case DF_m:
+		case DFI_m:
+			if (get) {
+				return FESIModel::RuleDisabled;
+			} else if (put_ack) {
+				send(s.forward_in[in.sender], MPutAck, a, MODEL_DIRECTORY, 0, 0);
+				s.request_in.pop();
+			} else if (event == EvMemData && state == DE_m) {
+				send(s.response_in[in.sender], MExclusiveData, a, MODEL_DIRECTORY, 0, in.data);
+				s.memory_response_in.pop();
+				state = DE;
+			} else if (event == EvMemData && state == DF_m) {
+				send(s.response_in[in.sender], MData, a, MODEL_DIRECTORY, 0, in.data);
+				sharers = 0;
+				s.memory_response_in.pop();
+				state = DF;
+			} else if (event == EvMemAck && state == DFI_m) {
+				s.memory_response_in.pop();
+				state = DI;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case DE:
+		case DF:
+			if (event == EvGetS) {
+				if (!one_owner) {
+					fail(FailedAssertion);
+					break;
+				}
+				send(s.forward_in[owner], MGetS, a, in.sender, 0, 0);
+				sharers |= owners;
+				owners = bit(in.sender);
+				s.request_in.pop();
+				state = DF;
+			} else if (event == EvGetMNonOwner) {
+				if (!one_owner) {
+					fail(FailedAssertion);
+					break;
+				}
+				if (state == DF) {
+					sharers &= ~bit(in.sender);
+				}
+				send(s.forward_in[owner], MGetM, a, in.sender, __builtin_popcount(sharers), 0);
+				owners = bit(in.sender);
+				if (state == DF) {
+					for (int c=0; c < config.caches; c++) {
+						if (sharers & bit(c)) {
+							send(s.forward_in[c], MInv, a, in.sender, 0, 0);
+						}
+					}
+					sharers = 0;
+				}
+				s.request_in.pop();
+				state = DF;
+			} else if (event == EvGetMOwner) {
+				send(s.response_in[in.sender], MAckCount, a, MODEL_DIRECTORY, __builtin_popcount(sharers), 0);
+				if (state == DF) {
+					for (int c=0; c < config.caches; c++) {
+						if (sharers & bit(c)) {
+							send(s.forward_in[c], MInv, a, in.sender, 0, 0);
+						}
+					}
+					sharers = 0;
+				}
+				s.request_in.pop();
+			} else if (event == EvPutFOwnerNoSharer) {
+				send(s.memory_request_in, MMemoryWriteback, a, in.sender, 0, in.data);
+				owners = 0;
+				send(s.forward_in[in.sender], MPutAck, a, MODEL_DIRECTORY, 0, 0);
+				s.request_in.pop();
+				state = DFI_m;
+			} else if (event == EvPutEOwner && state == DE) {
+				owners = 0;
+				send(s.forward_in[in.sender], MPutAck, a, MODEL_DIRECTORY, 0, 0);
+				s.request_in.pop();
+				state = DI;
+			} else if (put_ack && state == DE) {
+				send(s.forward_in[in.sender], MPutAck, a, MODEL_DIRECTORY, 0, 0);
+				s.request_in.pop();
+			} else if (put_ack && state == DF) {
+				if (event != EvPutSNonSharer) {
+					sharers &= ~bit(in.sender);
+				}
+				send(s.forward_in[in.sender], MPutAck, a, MODEL_DIRECTORY, 0, 0);
+				s.request_in.pop();
+			} else if (event == EvPutFOwnerSharer && state == DF) {
+				// The PutF stays at the head of the buffer until a sharer takes F
+				owners = 0;
+				for (int c=0; c < config.caches; c++) {
+					if (sharers & bit(c)) {
+						send(s.forward_in[c], MFAllocReq, a, MODEL_DIRECTORY, 0, 0);
+					}
+				}
+				state = DF_AS;
+			} else if (sharer_ack && state == DF) {
+				s.directory_response_in.pop();
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case DF_AS:
+			if (put_f) {
+				return FESIModel::RuleDisabled;
+			} else if (event == EvStoFAck) {
+				owners |= bit(in.sender);
+				sharers &= ~bit(in.sender);
+				send(s.forward_in[in.sender], MAllocF, a, MODEL_DIRECTORY, 0, 0);
+				s.directory_response_in.pop();
+				state = DFF_A;
+			} else if (event == EvStoFInvAck) {
+				sharers &= ~bit(in.sender);
+				s.directory_response_in.pop();
+			} else if (event == EvLastStoFInvAck) {
+				send(s.memory_request_in, MMemoryWriteback, a, put.sender, 0, put.data);
+				sharers = 0;
+				send(s.forward_in[put.sender], MPutAck, a, MODEL_DIRECTORY, 0, 0);
+				s.request_in.pop();
+				s.directory_response_in.pop();
+				state = DFI_m;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+		case DFF_A:
+			if (put_f) {
+				return FESIModel::RuleDisabled;
+			} else if (sharer_ack) {
+				s.directory_response_in.pop();
+			} else if (event == EvSFDone) {
+				send(s.forward_in[put.sender], MPutAck, a, MODEL_DIRECTORY, 0, 0);
+				s.request_in.pop();
+				s.directory_response_in.pop();
+				state = DF;
+			} else {
+				fail(InvalidTransition);
+			}
+			break;
+	}
+	if (blocked) {
+		return FESIModel::RuleDisabled;
+	}
+	return failed ? FESIModel::RuleFailed : FESIModel::RuleTaken;
+}
+
+FESIModel::FESIModel(const ModelConfig& _config) {
+	config = _config;
+	std::vector<int> order;
+	for (int c=0; c < config.caches; c++) {
+		order.push_back(c);
+	}
+	do {
+		orders.push_back(order);
+	} while (config.symmetry && std::next_permutation(order.begin(), order.end()));
+}
+
+// Rules: Load, Store and Replacement per cache and address, then the forward and
+// response buffers of every cache, then the request, response and memory response
+// buffers of the directory and the request buffer of memory
+int FESIModel::numRules() const {
+	return 3 * config.caches * config.addresses + 2 * config.caches + 4;
+}
+
+bool FESIModel::isMessageRule(int rule) const {
+	return rule >= 3 * config.caches * config.addresses;
+}
+
+FESIModel::RuleResult FESIModel::apply(const ModelState& state, int rule, ModelState& next, ModelError& error) const {
+	int processor_rules = 3 * config.caches * config.addresses;
+	int cache_rules = processor_rules + 2 * config.caches;
+
+	// The buffer whose head the rule handles, checked before next is written
+	const ModelQueue* queue;
+	if (rule < processor_rules) {
+		queue = NULL;
+	} else if (rule < cache_rules) {
+		int c = (rule - processor_rules) / 2;
+		queue = (rule - processor_rules) % 2 == 0 ? &state.forward_in[c] : &state.response_in[c];
+	} else {
+		const ModelQueue* queues[4] = {&state.request_in, &state.directory_response_in, &state.memory_response_in, &state.memory_request_in};
+		queue = queues[rule - cache_rules];
+	}
+	if (queue != NULL && queue->length == 0) {
+		return RuleDisabled;
+	}
+
+	next = state;
+	Transition t(config, next, error);
+	ModelMessage in = queue != NULL ? queue->head() : ModelMessage();
+
+	if (rule < processor_rules) {
+		int c = rule / (3 * config.addresses);
+		int a = (rule / 3) % config.addresses;
+		return t.cacheTransition(c, a, EvLoad + rule % 3, in);
+	}
+
+	if (rule < cache_rules) {
+		int c = (rule - processor_rules) / 2;
+		int a = in.address;
+		int event;
+		if ((rule - processor_rules) % 2 == 0) {
+			const int FORWARD_EVENTS[] = {EvFwdGetS, EvFwdGetM, -1, -1, -1, EvInv, EvPutAck, EvFAllocReq, EvAllocF};
+			event = FORWARD_EVENTS[in.type];
+		} else {
+			int acks = state.acks[c][a];
+			if (in.sender == MODEL_DIRECTORY) {
+				if (in.type == MData) {
+					event = EvDataDir;
+				} else if (in.type == MExclusiveData) {
+					event = EvExclusiveData;
+				} else {
+					event = in.acks + acks == 0 ? EvNoAckCount : EvAckCount;
+				}
+			} else if (in.type == MData) {
+				event = in.acks + acks == 0 ? EvDataOwnerNoAcks : EvDataOwnerAcks;
+			} else {
+				event = acks == 1 ? EvLastInvAck : EvInvAck;
+			}
+			// Every response is for a request with a TBE, holding the acks expected
+			t.at(c, state.cache_state[c][a], event, a);
+			if (!hasTBE(state.cache_state[c][a]) || (in.type != MInvAck && in.acks + acks < 0)) {
+				t.fail(FailedAssertion);
+				return RuleFailed;
+			}
+		}
+		return t.cacheTransition(c, a, event, in);
+	}
+
+	int a = in.address;
+	int owners = state.owners[a];
+	int sharers = state.sharers[a];
+	int requestor = bit(in.sender);
+	switch (rule - cache_rules) {
+		case 0:
+		{
+			int event = EvGetS;
+			if (in.type == MGetM) {
+				event = (owners & requestor) ? EvGetMOwner : EvGetMNonOwner;
+			} else if (in.type == MPutS) {
+				event = (sharers & requestor) ? EvPutSSharer : EvPutSNonSharer;
+			} else if (in.type == MPutE) {
+				event = (owners & requestor) ? EvPutEOwner : EvPutENonOwner;
+			} else if (in.type == MPutF) {
+				if (owners & requestor) {
+					event = sharers == 0 ? EvPutFOwnerNoSharer : EvPutFOwnerSharer;
+				} else {
+					event = EvPutFNonOwner;
+				}
+			}
+			return t.directoryTransition(a, event, in);
+		}
+		case 1:
+		{
+			int event = EvSFDone;
+			if (in.type == MStoFAck) {
+				event = EvStoFAck;
+			} else if (in.type == MStoFInvAck) {
+				event = __builtin_popcount(sharers) == 1 ? EvLastStoFInvAck : EvStoFInvAck;
+				if (event == EvLastStoFInvAck && !(sharers & requestor)) {
+					t.at(MODEL_DIRECTORY, state.directory_state[a], event, a);
+					t.fail(FailedAssertion);
+					return RuleFailed;
+				}
+			}
+			return t.directoryTransition(a, event, in);
+		}
+		case 2:
+			return t.directoryTransition(a, in.type == MMemoryRead ? EvMemData : EvMemAck, in);
+		default:
+			// Memory answers every request in turn
+			t.at(MODEL_MEMORY, 0, -1, a);
+			if (in.type == MMemoryWriteback) {
+				next.memory[a] = in.data;
+			}
+			next.memory_request_in.pop();
+			t.send(next.memory_response_in, in.type, a, in.sender, 0, next.memory[a]);
+			return t.blocked ? RuleDisabled : RuleTaken;
+	}
+}
+
+bool FESIModel::checkInvariants(const ModelState& state, ModelError& error) const {
+	for (int a=0; a < config.addresses; a++) {
+		for (int c=0; c < config.caches; c++) {
+			int cache_state = state.cache_state[c][a];
+			if (cache_state == CE) {
+				for (int other=0; other < config.caches; other++) {
+					if (other != c && canRead(state.cache_state[other][a])) {
+						error.kind = SWMRViolation;
+						error.machine = c;
+						error.state = cache_state;
+						error.event = -1;
+						error.address = a;
+						error.other = other;
+						return false;
+					}
+				}
+			}
+			if (canRead(cache_state) && state.cache_data[c][a] != state.latest[a]) {
+				error.kind = DataValueViolation;
+				error.machine = c;
+				error.state = cache_state;
+				error.event = -1;
+				error.address = a;
+				return false;
+			}
+		}
+		if (state.directory_state[a] == DI && state.memory[a] != state.latest[a]) {
+			error.kind = MemoryValueViolation;
+			error.machine = -1;
+			error.address = a;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FESIModel::pending(const ModelState& state) const {
+	if (state.request_in.length || state.directory_response_in.length
+		|| state.memory_request_in.length || state.memory_response_in.length) {
+		return true;
+	}
+	for (int c=0; c < config.caches; c++) {
+		if (state.forward_in[c].length || state.response_in[c].length) {
+			return true;
+		}
+		for (int a=0; a < config.addresses; a++) {
+			if (!isStable(state.cache_state[c][a])) {
+				return true;
+			}
+		}
+	}
+	for (int a=0; a < config.addresses; a++) {
+		if (state.directory_state[a] > DF) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static std::string describeMessage(const ModelMessage& message, bool forward, const int* names) {
+	std::string text = std::string(forward && message.type <= MGetM ? "Fwd-" : "") + MESSAGE_NAMES[message.type]
+		+ " A" + std::to_string(message.address);
+	if (message.sender < MODEL_MEMORY) {
+		text += " of " + machineName(message.sender, names, true);
+	}
+	if (message.acks) {
+		text += " acks " + std::to_string(message.acks);
+	}
+	return text;
+}
+
+std::string FESIModel::describeRule(const ModelState& state, int rule, const int* names) const {
+	int processor_rules = 3 * config.caches * config.addresses;
+	int cache_rules = processor_rules + 2 * config.caches;
+	if (rule < processor_rules) {
+		return machineName(rule / (3 * config.addresses), names, true) + " " + CACHE_EVENT_NAMES[rule % 3]
+			+ " A" + std::to_string((rule / 3) % config.addresses);
+	}
+	if (rule < cache_rules) {
+		int c = (rule - processor_rules) / 2;
+		bool forward = (rule - processor_rules) % 2 == 0;
+		const ModelQueue& queue = forward ? state.forward_in[c] : state.response_in[c];
+		return machineName(c, names, true) + " handles " + describeMessage(queue.head(), forward, names);
+	}
+	switch (rule - cache_rules) {
+		case 0:
+			return "Dir handles " + describeMessage(state.request_in.head(), false, names);
+		case 1:
+			return "Dir handles " + describeMessage(state.directory_response_in.head(), false, names);
+		case 2:
+			return "Dir handles " + describeMessage(state.memory_response_in.head(), false, names) + " from memory";
+		default:
+			return "Memory handles " + describeMessage(state.memory_request_in.head(), false, names);
+	}
+}
+
+static void describeQueue(std::ostringstream& out, const char* to, const ModelQueue& queue, bool forward, const int* names) {
+	for (int i=0; i < queue.length; i++) {
+		out << "\n        -> " << to << ": " << describeMessage(queue.messages[i], forward, names);
+	}
+}
+
+std::string FESIModel::describeState(const ModelState& state, const int* names) const {
+	// The cache each name is given to
+	int cache_of[MODEL_MAX_CACHES];
+	for (int c=0; c < config.caches; c++) {
+		cache_of[names[c]] = c;
+	}
+	std::ostringstream out;
+	for (int a=0; a < config.addresses; a++) {
+		out << (a == 0 ? "" : "\n") << "        A" << a << ": caches";
+		for (int n=0; n < config.caches; n++) {
+			out << " " << CACHE_STATE_NAMES[state.cache_state[cache_of[n]][a]];
+		}
+		out << ", Dir " << DIRECTORY_STATE_NAMES[state.directory_state[a]] << ", latest " << (int) state.latest[a]
+			<< ", memory " << (int) state.memory[a];
+	}
+	for (int n=0; n < config.caches; n++) {
+		std::string name = machineName(cache_of[n], names, true);
+		describeQueue(out, name.c_str(), state.forward_in[cache_of[n]], true, names);
+		describeQueue(out, name.c_str(), state.response_in[cache_of[n]], false, names);
+	}
+	describeQueue(out, "Dir", state.request_in, false, names);
+	describeQueue(out, "Dir", state.directory_response_in, false, names);
+	describeQueue(out, "Dir", state.memory_response_in, false, names);
+	describeQueue(out, "Memory", state.memory_request_in, false, names);
+	return out.str();
+}
+
+// What a cache holds and receives, with the ids of the caches left out, so that
+// a cache has the same signature however the caches are numbered
+uint64_t FESIModel::signature(const ModelState& state, int cache) const {
+	uint64_t hash = 14695981039346656037ULL;
+	auto mix = [&hash](uint64_t value) {
+		hash = (hash ^ value) * 1099511628211ULL;
+	};
+	for (int a=0; a < config.addresses; a++) {
+		mix(state.cache_state[cache][a] | state.cache_data[cache][a] << 4 | (state.acks[cache][a] - MIN_ACKS) << 5);
+		mix(((state.owners[a] >> cache) & 1) | ((state.sharers[a] >> cache) & 1) << 1);
+	}
+	const ModelQueue* queues[2] = {&state.forward_in[cache], &state.response_in[cache]};
+	for (int q=0; q < 2; q++) {
+		mix(queues[q]->length);
+		for (int i=0; i < queues[q]->length; i++) {
+			const ModelMessage& message = queues[q]->messages[i];
+			int sender = message.sender == cache ? 8 : (message.sender < MODEL_MEMORY ? 9 : message.sender);
+			mix(message.type | message.address << 5 | message.data << 6 | sender << 8 | message.acks << 12);
+		}
+	}
+	return hash;
+}
+
+static void packQueue(const ModelQueue& queue, const int* number, std::string& key) {
+	key.push_back(queue.length);
+	for (int i=0; i < queue.length; i++) {
+		const ModelMessage& message = queue.messages[i];
+		int sender = message.sender < MODEL_MEMORY ? number[message.sender] : message.sender;
+		key.push_back(message.type | message.address << 5 | message.data << 6);
+		key.push_back(sender | message.acks << 3);
+	}
+}
+
+static void unpackQueue(const unsigned char* key, size_t& i, ModelQueue& queue) {
+	queue.length = key[i++];
+	for (int m=0; m < queue.length; m++) {
+		ModelMessage& message = queue.messages[m];
+		unsigned char first = key[i++];
+		unsigned char second = key[i++];
+		message.type = first & 31;
+		message.address = (first >> 5) & 1;
+		message.data = first >> 6;
+		message.sender = second & 7;
+		message.acks = second >> 3;
+	}
+}
+
+static unsigned char packMask(int mask, const int* number, int caches) {
+	unsigned char packed = 0;
+	for (int c=0; c < caches; c++) {
+		if (mask & bit(c)) {
+			packed |= bit(number[c]);
+		}
+	}
+	return packed;
+}
+
+void FESIModel::packWith(const ModelState& state, const int* order, std::string& key) const {
+	int number[MODEL_MAX_CACHES];
+	for (int p=0; p < config.caches; p++) {
+		number[order[p]] = p;
+	}
+	key.clear();
+	for (int p=0; p < config.caches; p++) {
+		int c = order[p];
+		for (int a=0; a < config.addresses; a++) {
+			key.push_back(state.cache_state[c][a] | state.cache_data[c][a] << 4 | (state.acks[c][a] - MIN_ACKS) << 5);
+		}
+		packQueue(state.forward_in[c], number, key);
+		packQueue(state.response_in[c], number, key);
+	}
+	for (int a=0; a < config.addresses; a++) {
+		key.push_back(state.directory_state[a] | state.memory[a] << 4 | state.latest[a] << 5);
+		key.push_back(packMask(state.owners[a], number, config.caches));
+		key.push_back(packMask(state.sharers[a], number, config.caches));
+	}
+	packQueue(state.request_in, number, key);
+	packQueue(state.directory_response_in, number, key);
+	packQueue(state.memory_request_in, number, key);
+	packQueue(state.memory_response_in, number, key);
+}
+
+void FESIModel::pack(const ModelState& state, std::string& key, int* order) const {
+	if (orders.size() == 1) {
+		packWith(state, orders[0].data(), key);
+		std::copy(orders[0].begin(), orders[0].end(), order);
+		return;
+	}
+
+	// The least key over the orders that sort the caches by signature
+	uint64_t signatures[MODEL_MAX_CACHES];
+	for (int c=0; c < config.caches; c++) {
+		signatures[c] = signature(state, c);
+	}
+	std::string candidate;
+	bool found = false;
+	for (size_t o=0; o < orders.size(); o++) {
+		const std::vector<int>& candidate_order = orders[o];
+		bool sorted = true;
+		for (int p=1; p < config.caches && sorted; p++) {
+			sorted = signatures[candidate_order[p - 1]] <= signatures[candidate_order[p]];
+		}
+		if (!sorted) {
+			continue;
+		}
+		packWith(state, candidate_order.data(), candidate);
+		if (!found || candidate < key) {
+			key.swap(candidate);
+			std::copy(candidate_order.begin(), candidate_order.end(), order);
+			found = true;
+		}
+	}
+}
+
+void FESIModel::unpack(const unsigned char* key, ModelState& state) const {
+	size_t i = 1;
+	for (int c=0; c < config.caches; c++) {
+		for (int a=0; a < config.addresses; a++) {
+			unsigned char block = key[i++];
+			state.cache_state[c][a] = block & 15;
+			state.cache_data[c][a] = (block >> 4) & 1;
+			state.acks[c][a] = (block >> 5) + MIN_ACKS;
+		}
+		unpackQueue(key, i, state.forward_in[c]);
+		unpackQueue(key, i, state.response_in[c]);
+	}
+	for (int a=0; a < config.addresses; a++) {
+		unsigned char directory = key[i++];
+		state.directory_state[a] = directory & 15;
+		state.memory[a] = (directory >> 4) & 1;
+		state.latest[a] = (directory >> 5) & 1;
+		state.owners[a] = key[i++];
+		state.sharers[a] = key[i++];
+	}
+	unpackQueue(key, i, state.request_in);
+	unpackQueue(key, i, state.directory_response_in);
+	unpackQueue(key, i, state.memory_request_in);
+	unpackQueue(key, i, state.memory_response_in);
+}
+
+// The packed states visited, each stored once as its length and bytes in blocks that
+// never move, and found through an open-addressing table of the hashes; the states are
+// split in shards of their own lock so the threads rarely wait
+#define VISITED_SHARDS 256
+#define VISITED_BLOCK (1 << 20)
+
+class VisitedSet {
+	public:
+		class Slot {
+			public:
+				uint64_t hash;
+				const unsigned char* key;
+		};
+
+		class Shard {
+			public:
+				std::mutex lock;
+				std::vector<Slot> slots;
+				size_t count;
+				std::vector<std::unique_ptr<unsigned char[]> > blocks;
+				size_t block_used;
+
+				Shard() : slots(1024) {
+					count = 0;
+					block_used = VISITED_BLOCK;
+				}
+
+				const unsigned char* store(const std::string& key) {
+					if (block_used + key.size() + 1 > VISITED_BLOCK) {
+						blocks.push_back(std::unique_ptr<unsigned char[]>(new unsigned char[VISITED_BLOCK]));
+						block_used = 0;
+					}
+					unsigned char* stored = blocks.back().get() + block_used;
+					stored[0] = key.size();
+					std::copy(key.begin(), key.end(), stored + 1);
+					block_used += key.size() + 1;
+					return stored;
+				}
+
+				// Doubles the table, keeping it at most half full
+				void grow() {
+					std::vector<Slot> old(slots.size() * 2);
+					old.swap(slots);
+					size_t mask = slots.size() - 1;
+					for (size_t i=0; i < old.size(); i++) {
+						if (old[i].key != NULL) {
+							size_t index = old[i].hash & mask;
+							while (slots[index].key != NULL) {
+								index = (index + 1) & mask;
+							}
+							slots[index] = old[i];
+						}
+					}
+				}
+		};
+
+		Shard shards[VISITED_SHARDS];
+
+		// Returns the key as stored, and whether it was not visited before
+		const unsigned char* insert(const std::string& key, bool& inserted) {
+			uint64_t hash = 14695981039346656037ULL;
+			for (size_t i=0; i < key.size(); i++) {
+				hash = (hash ^ (unsigned char) key[i]) * 1099511628211ULL;
+			}
+			hash ^= hash >> 29;
+			Shard& shard = shards[hash >> 56];
+			std::lock_guard<std::mutex> guard(shard.lock);
+			size_t mask = shard.slots.size() - 1;
+			for (size_t index = hash & mask; shard.slots[index].key != NULL; index = (index + 1) & mask) {
+				const Slot& slot = shard.slots[index];
+				if (slot.hash == hash && slot.key[0] == key.size() && memcmp(key.data(), slot.key + 1, key.size()) == 0) {
+					inserted = false;
+					return slot.key;
+				}
+			}
+			if (2 * (shard.count + 1) > shard.slots.size()) {
+				shard.grow();
+				mask = shard.slots.size() - 1;
+			}
+			size_t index = hash & mask;
+			while (shard.slots[index].key != NULL) {
+				index = (index + 1) & mask;
+			}
+			shard.slots[index].hash = hash;
+			shard.slots[index].key = shard.store(key);
+			shard.count++;
+			inserted = true;
+			return shard.slots[index].key;
+		}
+};
+
+// Whether stored key x comes before y, comparing their bytes
+static bool keyBefore(const unsigned char* x, const unsigned char* y) {
+	return std::lexicographical_compare(x + 1, x + 1 + x[0], y + 1, y + 1 + y[0]);
+}
+
+ModelChecker::ModelChecker(const ModelConfig& config) : model(config) {
+	num_states = 0;
+	num_transitions = 0;
+	depth = 0;
+	complete = true;
+	visited = new VisitedSet();
+}
+
+ModelChecker::~ModelChecker() {
+	delete visited;
+}
+
+bool ModelChecker::run() {
+	const ModelConfig& config = model.config;
+	std::string key;
+	int order[MODEL_MAX_CACHES];
+	bool inserted;
+	model.pack(ModelState(), key, order);
+	Node root;
+	root.key = visited->insert(key, inserted);
+	root.parent = 0;
+	nodes.push_back(root);
+
+	// Errors by their description without cache ids; the first level that finds one
+	// keeps it, and within the level the least state and rule
+	std::map<std::string, Found> found;
+	auto before = [this](const Found& x, const Found& y) {
+		return keyBefore(nodes[x.node].key, nodes[y.node].key) || (x.node == y.node && x.rule < y.rule);
+	};
+
+	size_t level_begin = 0, level_end = 1;
+	while (level_begin < level_end) {
+		class Worker {
+			public:
+				std::vector<Node> reached;
+				std::map<std::string, Found> found;
+				unsigned long long num_transitions;
+		};
+		std::vector<Worker> workers(config.threads);
+		std::atomic<size_t> next_node(level_begin);
+
+		auto expand = [&](Worker& worker) {
+			ModelState state, next;
+			ModelError error;
+			std::string next_key;
+			int next_order[MODEL_MAX_CACHES];
+			bool next_inserted;
+			worker.num_transitions = 0;
+			auto record = [&](unsigned int node, int rule) {
+				Found candidate;
+				candidate.error = error;
+				candidate.node = node;
+				candidate.rule = rule;
+				std::string signature = error.describe(NULL, false);
+				std::map<std::string, Found>::iterator iter = worker.found.find(signature);
+				if (iter == worker.found.end()) {
+					worker.found[signature] = candidate;
+				} else if (before(candidate, iter->second)) {
+					iter->second = candidate;
+				}
+			};
+			while (true) {
+				size_t begin = next_node.fetch_add(64);
+				if (begin >= level_end) {
+					break;
+				}
+				for (size_t node = begin; node < std::min(begin + 64, level_end); node++) {
+					model.unpack(nodes[node].key, state);
+					bool progress = false;
+					for (int rule=0; rule < model.numRules(); rule++) {
+						FESIModel::RuleResult result = model.apply(state, rule, next, error);
+						if (result == FESIModel::RuleDisabled) {
+							continue;
+						}
+						progress |= model.isMessageRule(rule);
+						worker.num_transitions++;
+						if (result == FESIModel::RuleFailed || !model.checkInvariants(next, error)) {
+							record(node, rule);
+							continue;
+						}
+						model.pack(next, next_key, next_order);
+						const unsigned char* stored = visited->insert(next_key, next_inserted);
+						if (next_inserted) {
+							Node reached;
+							reached.key = stored;
+							reached.parent = node;
+							worker.reached.push_back(reached);
+						}
+					}
+					if (!progress && model.pending(state)) {
+						error.kind = Deadlock;
+						error.machine = -1;
+						error.address = 0;
+						record(node, -1);
+					}
+				}
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (int t=1; t < config.threads; t++) {
+			threads.push_back(std::thread(expand, std::ref(workers[t])));
+		}
+		expand(workers[0]);
+		for (size_t t=0; t < threads.size(); t++) {
+			threads[t].join();
+		}
+
+		std::map<std::string, Found> level_found;
+		for (size_t w=0; w < workers.size(); w++) {
+			num_transitions += workers[w].num_transitions;
+			nodes.insert(nodes.end(), workers[w].reached.begin(), workers[w].reached.end());
+			for (std::map<std::string, Found>::iterator iter = workers[w].found.begin(); iter != workers[w].found.end(); iter++) {
+				std::map<std::string, Found>::iterator known = level_found.find(iter->first);
+				if (known == level_found.end()) {
+					level_found[iter->first] = iter->second;
+				} else if (before(iter->second, known->second)) {
+					known->second = iter->second;
+				}
+			}
+		}
+		for (std::map<std::string, Found>::iterator iter = level_found.begin(); iter != level_found.end(); iter++) {
+			found.insert(*iter);
+		}
+
+		level_begin = level_end;
+		level_end = nodes.size();
+		if (level_end > level_begin) {
+			depth++;
+		}
+		if (!found.empty() && !config.keep_going) {
+			break;
+		}
+		if (nodes.size() >= config.max_states) {
+			complete = level_begin == level_end;
+			break;
+		}
+	}
+
+	num_states = nodes.size();
+	for (std::map<std::string, Found>::iterator iter = found.begin(); iter != found.end(); iter++) {
+		errors.push_back(iter->second);
+	}
+	return errors.empty();
+}
+
+void ModelChecker::printTrace(const Found& error_found) {
+	std::vector<unsigned int> path;
+	for (unsigned int node = error_found.node; node != 0; node = nodes[node].parent) {
+		path.push_back(node);
+	}
+	path.push_back(0);
+	std::reverse(path.begin(), path.end());
+
+	// Each state is replayed in its own numbering of the caches; names gives the
+	// number every cache had in the first state
+	int names[MODEL_MAX_CACHES];
+	for (int c=0; c < model.config.caches; c++) {
+		names[c] = c;
+	}
+	ModelState state, next;
+	ModelError error;
+	std::string key;
+	int order[MODEL_MAX_CACHES];
+	model.unpack(nodes[0].key, state);
+	int steps = path.size() - 1 + (error_found.rule >= 0 ? 1 : 0);
+	std::cout << "Trace (" << steps << " steps):\n";
+	for (size_t p=1; p < path.size(); p++) {
+		const unsigned char* target = nodes[path[p]].key;
+		for (int rule=0; rule < model.numRules(); rule++) {
+			if (model.apply(state, rule, next, error) != FESIModel::RuleTaken) {
+				continue;
+			}
+			model.pack(next, key, order);
+			if (key.size() != target[0] || memcmp(key.data(), target + 1, key.size()) != 0) {
+				continue;
+			}
+			std::cout << std::setw(4) << p << ". " << model.describeRule(state, rule, names) << "\n";
+			std::cout << model.describeState(next, names) << "\n";
+			int next_names[MODEL_MAX_CACHES];
+			for (int c=0; c < model.config.caches; c++) {
+				next_names[c] = names[order[c]];
+			}
+			std::copy(next_names, next_names + model.config.caches, names);
+			break;
+		}
+		model.unpack(target, state);
+	}
+	if (error_found.rule >= 0) {
+		std::cout << std::setw(4) << steps << ". " << model.describeRule(state, error_found.rule, names) << "\n";
+	}
+	std::cout << error_found.error.describe(names, true) << "\n";
+}
+
+void ModelChecker::printReport(double seconds) {
+	const ModelConfig& config = model.config;
+	std::cout << std::dec;
+	std::cout << ">> FESI model checker (FESI_GEM5/FESI-cache.sm and FESI-dir.sm)\n";
+	std::cout << "Caches               : " << config.caches << '\n';
+	std::cout << "Addresses            : " << config.addresses << '\n';
+	std::cout << "Queue depth          : " << config.queue_depth << '\n';
+	std::cout << "Symmetry reduction   : " << (config.symmetry ? "on" : "off") << '\n';
+	std::cout << "Threads              : " << config.threads << '\n';
+	std::cout << "States               : " << num_states << '\n';
+	std::cout << "Transitions          : " << num_transitions << '\n';
+	std::cout << "Depth                : " << depth << '\n';
+	std::cout << "Search               : " << (complete ? (errors.empty() || config.keep_going ? "complete" : "stopped at the first error")
+		: "stopped at --max-states") << '\n';
+	std::cout << "Time                 : " << std::fixed << std::setprecision(2) << seconds << " s ("
+		<< std::setprecision(0) << (seconds > 0 ? num_states / seconds : 0.0) << " states/s)\n";
+	std::cout << "Errors               : " << errors.size() << '\n';
+	for (size_t e=0; e < errors.size(); e++) {
+		std::cout << "---- \n";
+		std::cout << errors[e].error.describe(NULL, false) << '\n';
+		printTrace(errors[e]);
+	}
+}
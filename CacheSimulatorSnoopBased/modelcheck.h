@@ -0,0 +1,252 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Explicit-state model checker of the FESI controllers in FESI_GEM5: the cache of
+// FESI-cache.sm and the directory of FESI-dir.sm, transient states included, with
+// their message buffers, for a few caches and addresses
+// Every reachable state is visited breadth first, so the trace to an error is a shortest one
+
+#define MODEL_MAX_CACHES 4
+#define MODEL_MAX_ADDRESSES 2
+#define MODEL_MAX_QUEUE 8
+
+// Sender of a message that is not a cache
+#define MODEL_DIRECTORY 7
+#define MODEL_MEMORY 6
+
+class VisitedSet;
+
+// States of a block in a cache, as in FESI-cache.sm
+typedef enum {
+	CI, CF, CS, CE,
+	CIE_D, CIF_AD, CIF_A, CSF_AD, CSF_A, CFF_AA, CFF_A,
+	CFI_A, CSI_A, CEI_A, CII_A,
+	NUM_MODEL_CACHE_STATES
+} ModelCacheState;
+
+// States of a block at the directory, as in FESI-dir.sm
+typedef enum {
+	DI, DE, DF, DF_AS, DFF_A, DF_m, DE_m, DFI_m,
+	NUM_MODEL_DIRECTORY_STATES
+} ModelDirectoryState;
+
+// Message types of FESI-msg.sm; the memory read and write back name both the request
+// to memory and its response (MemData and MemAck at the directory)
+typedef enum {
+	MGetS, MGetM, MPutS, MPutE, MPutF,
+	MInv, MPutAck, MFAllocReq, MAllocF,
+	MData, MExclusiveData, MInvAck, MAckCount, MStoFAck, MStoFInvAck, MSFDone,
+	MMemoryRead, MMemoryWriteback,
+	NUM_MODEL_MESSAGES
+} ModelMessageType;
+
+// Events of the cache controller
+typedef enum {
+	EvLoad, EvStore, EvReplacement,
+	EvFwdGetS, EvFwdGetM, EvInv, EvPutAck, EvFAllocReq, EvAllocF,
+	EvExclusiveData, EvDataDir, EvAckCount, EvNoAckCount, EvDataOwnerNoAcks, EvDataOwnerAcks,
+	EvInvAck, EvLastInvAck,
+	NUM_MODEL_CACHE_EVENTS
+} ModelCacheEvent;
+
+// Events of the directory controller
+typedef enum {
+	EvGetS, EvGetMNonOwner, EvGetMOwner, EvPutSSharer, EvPutSNonSharer,
+	EvPutFOwnerSharer, EvPutFOwnerNoSharer, EvPutFNonOwner, EvPutEOwner, EvPutENonOwner,
+	EvStoFAck, EvStoFInvAck, EvLastStoFInvAck, EvSFDone, EvMemData, EvMemAck,
+	NUM_MODEL_DIRECTORY_EVENTS
+} ModelDirectoryEvent;
+
+// A message in a buffer; sender is the Requestor of a request, the Sender of a response,
+// and the original requestor of a memory request or response
+class ModelMessage {
+	public:
+		unsigned char type;
+		unsigned char address;
+		unsigned char sender;
+		unsigned char acks;
+		unsigned char data;
+};
+
+// A FIFO message buffer of bounded depth; a transition that would send to a full
+// buffer stalls
+class ModelQueue {
+	public:
+		unsigned char length;
+		ModelMessage messages[MODEL_MAX_QUEUE];
+
+		const ModelMessage& head() const { return messages[0]; }
+		void pop();
+};
+
+// A state of the whole system
+// Every controller has one buffer per virtual network it receives on, shared by all
+// senders, as a gem5 MessageBuffer is: messages from different senders arrive in the
+// order they were sent, and a stalled message blocks the buffer behind it
+// Data is a single bit that every store flips, and latest is the value of the last store
+class ModelState {
+	public:
+		unsigned char cache_state[MODEL_MAX_CACHES][MODEL_MAX_ADDRESSES];
+		signed char acks[MODEL_MAX_CACHES][MODEL_MAX_ADDRESSES];
+		unsigned char cache_data[MODEL_MAX_CACHES][MODEL_MAX_ADDRESSES];
+		ModelQueue forward_in[MODEL_MAX_CACHES];
+		ModelQueue response_in[MODEL_MAX_CACHES];
+
+		unsigned char directory_state[MODEL_MAX_ADDRESSES];
+		unsigned char owners[MODEL_MAX_ADDRESSES];
+		unsigned char sharers[MODEL_MAX_ADDRESSES];
+		unsigned char memory[MODEL_MAX_ADDRESSES];
+		unsigned char latest[MODEL_MAX_ADDRESSES];
+		ModelQueue request_in;
+		ModelQueue directory_response_in;
+		ModelQueue memory_request_in;
+		ModelQueue memory_response_in;
+
+		// All blocks invalid, memory holding the data, no message in flight
+		ModelState();
+};
+
+typedef enum {
+	InvalidTransition,  // a message arrived in a state with no transition for it
+	FailedAssertion,    // an assert of the controller does not hold
+	SWMRViolation,      // a cache could read or write while another could write
+	DataValueViolation, // a cache could read a stale value
+	MemoryValueViolation, // no cache holds the block, and memory is stale
+	Deadlock            // work is pending and no message can be handled
+} ModelErrorKind;
+
+class ModelError {
+	public:
+		ModelErrorKind kind;
+
+		// Cache id, MODEL_DIRECTORY or MODEL_MEMORY, the state and event (of that machine)
+		int machine;
+		int state;
+		int event;
+		int address;
+
+		// The cache that could read, under SWMRViolation
+		int other;
+
+		// Describes the error, numbering the caches through names (NULL for their own ids)
+		// Without ids the description is the same for the error at any cache
+		std::string describe(const int* names, bool with_ids) const;
+};
+
+// The system checked, and how
+class ModelConfig {
+	public:
+		int caches;
+		int addresses;
+		int queue_depth;
+		int threads;
+
+		// Whether states that differ only in the numbering of the caches are visited once
+		bool symmetry;
+
+		// Whether to go on after the first level with an error, for every kind of error
+		bool keep_going;
+
+		// States after which the search stops, incomplete
+		unsigned long long max_states;
+
+		ModelConfig();
+};
+
+// The FESI controllers as a transition system
+// A rule is a processor request (Load, Store, Replacement of an address at a cache)
+// or the handling of the message at the head of one buffer
+class FESIModel {
+	public:
+		ModelConfig config;
+
+		FESIModel(const ModelConfig& _config);
+
+		typedef enum {
+			RuleDisabled, // nothing to handle, or the request stalls
+			RuleTaken,
+			RuleFailed    // the error is filled in
+		} RuleResult;
+
+		int numRules() const;
+
+		// Whether rule handles a message, rather than being a processor request
+		bool isMessageRule(int rule) const;
+
+		// Applies rule to state, into next; error is filled in when it fails
+		RuleResult apply(const ModelState& state, int rule, ModelState& next, ModelError& error) const;
+
+		// Checks SWMR and the data values in state; false, with the error, if one fails
+		bool checkInvariants(const ModelState& state, ModelError& error) const;
+
+		// Whether a message is in flight, or a controller in a transient state
+		bool pending(const ModelState& state) const;
+
+		// Describes the rule as applied to state
+		std::string describeRule(const ModelState& state, int rule, const int* names) const;
+
+		// The stable and transient states of every cache and of the directory
+		std::string describeState(const ModelState& state, const int* names) const;
+
+		// Packs state into key, numbering the caches so that states equal up to a
+		// renumbering pack the same, under symmetry; order receives the cache now numbered p
+		// at order[p]
+		void pack(const ModelState& state, std::string& key, int* order) const;
+		void unpack(const unsigned char* key, ModelState& state) const;
+
+	private:
+		// Every order of the caches
+		std::vector<std::vector<int> > orders;
+
+		uint64_t signature(const ModelState& state, int cache) const;
+		void packWith(const ModelState& state, const int* order, std::string& key) const;
+};
+
+// Breadth-first search of every state of a FESIModel, over threads that each expand
+// part of a level and insert the states they reach into a sharded visited set
+// The states and errors found do not depend on the threads, but which of the shortest
+// traces to an error is printed may
+class ModelChecker {
+	public:
+		FESIModel model;
+
+		unsigned long long num_states, num_transitions;
+		int depth;
+
+		// Whether every reachable state was visited
+		bool complete;
+
+		ModelChecker(const ModelConfig& config);
+		~ModelChecker();
+
+		// Returns true when no error was found
+		bool run();
+
+		// Prints the size of the search, and every error with its trace
+		void printReport(double seconds);
+
+	private:
+		class Node {
+			public:
+				// The packed state as stored: its length, then its bytes
+				const unsigned char* key;
+				unsigned int parent;
+		};
+
+		// An error, found applying rule to the state of node, or in that state with rule -1
+		class Found {
+			public:
+				ModelError error;
+				unsigned int node;
+				int rule;
+		};
+
+		// The states visited, which the nodes point into
+		VisitedSet* visited;
+		std::vector<Node> nodes;
+		std::vector<Found> errors;
+
+		void printTrace(const Found& found);
+};
@@ -0,0 +1,102 @@
+#include "pipeline.h"
+
+// Spins this many times on an empty or full queue before sleeping
+#define PIPELINE_SPINS 64
+
+BatchQueue::BatchQueue() : head(0), tail(0), waiting(false) {
+}
+
+// waiting and the index are both seq_cst, so either the sleeper sees the index move
+// or the other side sees waiting and takes the mutex before notifying
+void BatchQueue::wait(const std::atomic<size_t>& index, size_t seen, int& spins) {
+	if (++spins < PIPELINE_SPINS) {
+		return;
+	}
+	spins = 0;
+	std::unique_lock<std::mutex> lock(mutex);
+	waiting = true;
+	while (index.load() == seen) {
+		moved.wait(lock);
+	}
+	waiting = false;
+}
+
+void BatchQueue::wake() {
+	if (waiting.load()) {
+		std::lock_guard<std::mutex> lock(mutex);
+		moved.notify_one();
+	}
+}
+
+void BatchQueue::push(TraceBatch* batch) {
+	size_t t = tail.load(std::memory_order_relaxed);
+	int spins = 0;
+	size_t h;
+	while (t - (h = head.load(std::memory_order_acquire)) == PIPELINE_DEPTH) {
+		wait(head, h, spins);
+	}
+	slots[t % PIPELINE_DEPTH] = batch;
+	tail.store(t + 1);
+	wake();
+}
+
+TraceBatch* BatchQueue::pop() {
+	size_t h = head.load(std::memory_order_relaxed);
+	int spins = 0;
+	while (tail.load(std::memory_order_acquire) == h) {
+		wait(tail, h, spins);
+	}
+	TraceBatch* batch = slots[h % PIPELINE_DEPTH];
+	head.store(h + 1);
+	wake();
+	return batch;
+}
+
+TracePipeline::TracePipeline(TraceReader& _reader) : reader(_reader), stopping(false) {
+	finished = false;
+	batches = new TraceBatch[PIPELINE_DEPTH];
+	for (int i=0; i < PIPELINE_DEPTH; i++) {
+		empty.push(&batches[i]);
+	}
+	thread = std::thread(&TracePipeline::produce, this);
+}
+
+TracePipeline::~TracePipeline() {
+	// Unblock the reader if the trace was not consumed to the end
+	stopping = true;
+	TraceBatch* batch;
+	while ((batch = next()) != NULL) {
+		release(batch);
+	}
+	thread.join();
+	delete[] batches;
+}
+
+// Reader thread: fills empty batches until the trace ends, then sends an empty batch as the end marker
+void TracePipeline::produce() {
+	while (true) {
+		TraceBatch* batch = empty.pop();
+		batch->count = stopping ? 0 : reader.read(batch->records, PIPELINE_BATCH_SIZE);
+		full.push(batch);
+		if (batch->count == 0) {
+			return;
+		}
+	}
+}
+
+TraceBatch* TracePipeline::next() {
+	if (finished) {
+		return NULL;
+	}
+	TraceBatch* batch = full.pop();
+	if (batch->count == 0) {
+		finished = true;
+		empty.push(batch);
+		return NULL;
+	}
+	return batch;
+}
+
+void TracePipeline::release(TraceBatch* batch) {
+	empty.push(batch);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include "trace.h"
+
+// Records per batch, and batches in flight between the reader and the simulation
+#define PIPELINE_BATCH_SIZE 4096
+#define PIPELINE_DEPTH 8 // a power of two
+
+// A fixed-size batch of decoded accesses; batches are recycled, never reallocated
+class TraceBatch {
+	public:
+		TraceRecord records[PIPELINE_BATCH_SIZE];
+		size_t count;
+};
+
+// Bounded single producer, single consumer queue of batches
+// The producer only writes tail and the consumer only writes head, so no lock is needed
+// while the queue is neither full nor empty; the mutex is only taken to sleep and wake
+class BatchQueue {
+	public:
+		BatchQueue();
+
+		// Both wait while the queue is full or empty
+		void push(TraceBatch* batch);
+		TraceBatch* pop();
+
+	private:
+		TraceBatch* slots[PIPELINE_DEPTH];
+		alignas(64) std::atomic<size_t> head;
+		alignas(64) std::atomic<size_t> tail;
+
+		// Set while a side sleeps; the queue cannot be full and empty at once, so at most one does
+		std::atomic<bool> waiting;
+		std::mutex mutex;
+		std::condition_variable moved;
+
+		// Spins, then sleeps until the other side moves index from seen
+		void wait(const std::atomic<size_t>& index, size_t seen, int& spins);
+
+		// Wakes the other side if it sleeps
+		void wake();
+};
+
+// Two stage pipeline: a thread reads and decodes the trace into batches while
+// the caller simulates the previous ones
+// Empty batches go back to the reader through a second queue
+class TracePipeline {
+	public:
+		// Starts the reader thread; the protocol must already have been read
+		TracePipeline(TraceReader& _reader);
+		~TracePipeline();
+
+		// Returns the next batch, or NULL at the end of the trace (check reader.error() then)
+		// The batch stays valid until it is released
+		TraceBatch* next();
+		void release(TraceBatch* batch);
+
+	private:
+		TraceReader& reader;
+		TraceBatch* batches;
+		BatchQueue full, empty;
+		std::atomic<bool> stopping;
+		bool finished;
+		std::thread thread;
+
+		void produce();
+};
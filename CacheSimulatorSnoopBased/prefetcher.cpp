@@ -0,0 +1,189 @@
+#include <iostream>
+#include "prefetcher.h"
+#include "stats.h"
+
+static const char* PREFETCH_POLICY_NAMES[] = {"none", "next-line", "stride", "stream"};
+
+bool prefetchPolicyFromName(const std::string& name, PrefetchPolicy& policy) {
+	for (int i=0; i <= PrefetchPolicy::StreamPrefetch; i++) {
+		if (name == PREFETCH_POLICY_NAMES[i]) {
+			policy = (PrefetchPolicy) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* prefetchPolicyName(PrefetchPolicy policy) {
+	return PREFETCH_POLICY_NAMES[policy];
+}
+
+PrefetchConfig::PrefetchConfig() {
+	policy = PrefetchPolicy::NoPrefetch;
+	degree = DEFAULT_PREFETCH_DEGREE;
+	distance = DEFAULT_PREFETCH_DISTANCE;
+}
+
+Prefetcher::Prefetcher(const PrefetchConfig& _config) {
+	config = _config;
+	candidates.reserve(config.degree);
+	StrideEntry empty_entry = {false, 0, 0, 0, 0};
+	strides.assign(PREFETCH_STRIDE_ENTRIES, empty_entry);
+	Stream empty_stream = {false, 0, 0, 0, 0};
+	streams.assign(PREFETCH_STREAMS, empty_stream);
+	stream_clock = 0;
+	num_issued = 0;
+	num_useful = 0;
+	num_late = 0;
+	num_useless = 0;
+	num_invalidated = 0;
+	num_ownership_taken = 0;
+}
+
+unsigned long long Prefetcher::demand(unsigned long long block_address, unsigned long long now, bool& prefetched) {
+	prefetched = false;
+	if (pending.empty()) {
+		return 0;
+	}
+	std::unordered_map<unsigned long long, unsigned long long>::iterator iter = pending.find(block_address);
+	if (iter == pending.end()) {
+		return 0;
+	}
+	// A pending block is still in the cache, so the access hit it
+	unsigned long long ready = iter->second;
+	pending.erase(iter);
+	prefetched = true;
+	if (now >= ready) {
+		num_useful++;
+		return 0;
+	}
+	num_late++;
+	return ready - now;
+}
+
+void Prefetcher::addCandidate(unsigned long long block_address, long long offset) {
+	if (offset < 0 && block_address < (unsigned long long) -offset) {
+		return;
+	}
+	candidates.push_back(block_address + offset);
+}
+
+void Prefetcher::train(unsigned long long block_address, bool trigger) {
+	candidates.clear();
+	switch (config.policy) {
+		case PrefetchPolicy::NoPrefetch:
+			break;
+		case PrefetchPolicy::NextLinePrefetch:
+			if (trigger) {
+				for (int i=1; i <= config.degree; i++) {
+					addCandidate(block_address, i);
+				}
+			}
+			break;
+		case PrefetchPolicy::StridePrefetch:
+			trainStride(block_address);
+			break;
+		case PrefetchPolicy::StreamPrefetch:
+			if (trigger) {
+				trainStream(block_address);
+			}
+			break;
+	}
+}
+
+// The trace has no instruction addresses, so the table is indexed by the region of the
+// block instead of the PC: interleaved strided walks stay apart as long as they are in
+// different regions
+void Prefetcher::trainStride(unsigned long long block_address) {
+	unsigned long long region = block_address >> PREFETCH_REGION_BITS;
+	StrideEntry& entry = strides[region % PREFETCH_STRIDE_ENTRIES];
+	if (!entry.valid || entry.region != region) {
+		entry.valid = true;
+		entry.region = region;
+		entry.last_block = block_address;
+		entry.stride = 0;
+		entry.confidence = 0;
+		return;
+	}
+	long long stride = (long long) (block_address - entry.last_block);
+	if (stride == 0) {
+		return;
+	}
+	if (stride == entry.stride) {
+		if (entry.confidence < PREFETCH_CONFIDENCE_MAX) {
+			entry.confidence++;
+		}
+	} else if (entry.confidence > 0) {
+		entry.confidence--;
+	} else {
+		entry.stride = stride;
+	}
+	entry.last_block = block_address;
+	if (entry.confidence >= PREFETCH_CONFIDENCE_TRAINED) {
+		for (int i=1; i <= config.degree; i++) {
+			addCandidate(block_address, entry.stride * i);
+		}
+	}
+}
+
+void Prefetcher::trainStream(unsigned long long block_address) {
+	stream_clock++;
+	Stream* stream = NULL;
+	Stream* victim = &streams[0];
+	for (int i=0; i < PREFETCH_STREAMS; i++) {
+		Stream& candidate = streams[i];
+		if (candidate.valid) {
+			long long distance = (long long) (block_address - candidate.last_block);
+			if (distance != 0 && distance >= -PREFETCH_STREAM_WINDOW && distance <= PREFETCH_STREAM_WINDOW) {
+				stream = &candidate;
+				break;
+			}
+		}
+		if (!candidate.valid || (victim->valid && candidate.last_use < victim->last_use)) {
+			victim = &candidate;
+		}
+	}
+	if (stream == NULL) {
+		victim->valid = true;
+		victim->last_block = block_address;
+		victim->direction = 0;
+		victim->confidence = 0;
+		victim->last_use = stream_clock;
+		return;
+	}
+
+	int direction = block_address > stream->last_block ? 1 : -1;
+	if (direction == stream->direction) {
+		if (stream->confidence < PREFETCH_CONFIDENCE_MAX) {
+			stream->confidence++;
+		}
+	} else {
+		stream->direction = direction;
+		stream->confidence = 0;
+	}
+	stream->last_block = block_address;
+	stream->last_use = stream_clock;
+	if (stream->confidence >= PREFETCH_CONFIDENCE_TRAINED) {
+		for (int i=0; i < config.degree; i++) {
+			addCandidate(block_address, (long long) direction * (config.distance + i));
+		}
+	}
+}
+
+void Prefetcher::printStats() {
+	std::cout << "Prefetches      : " << num_issued << '\n';
+	std::cout << "Useful          : " << num_useful << '\n';
+	std::cout << "Late            : " << num_late << '\n';
+	std::cout << "Useless         : " << num_useless << '\n';
+	std::cout << "Invalidated     : " << num_invalidated << '\n';
+	std::cout << "Took ownership  : " << num_ownership_taken << '\n';
+}
+
+void Prefetcher::registerStats(StatsRegistry& stats, const std::string& group) {
+	stats.add(group, "issued", &num_issued);
+	stats.add(group, "useful", &num_useful);
+	stats.add(group, "late", &num_late);
+	stats.add(group, "useless", &num_useless);
+	stats.add(group, "invalidated", &num_invalidated);
+	stats.add(group, "ownership_taken", &num_ownership_taken);
+}
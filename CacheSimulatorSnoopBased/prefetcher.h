@@ -0,0 +1,142 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include "request.h"
+
+class StatsRegistry;
+
+// Defaults of the prefetchers, see PrefetchConfig
+#define DEFAULT_PREFETCH_DEGREE 2
+#define DEFAULT_PREFETCH_DISTANCE 4
+
+// Stride prefetcher: entries of its reference prediction table, each covering a region
+// of 2^PREFETCH_REGION_BITS blocks, and the confidence at which it starts prefetching
+#define PREFETCH_STRIDE_ENTRIES 64
+#define PREFETCH_REGION_BITS 6
+#define PREFETCH_CONFIDENCE_MAX 3
+#define PREFETCH_CONFIDENCE_TRAINED 2
+
+// Stream prefetcher: streams tracked at once, and how far (in blocks) a miss can be
+// from the last miss of a stream to extend it
+#define PREFETCH_STREAMS 16
+#define PREFETCH_STREAM_WINDOW 16
+
+typedef enum {
+	NoPrefetch,
+	NextLinePrefetch, // the next degree blocks after a miss or the first use of a prefetched block
+	StridePrefetch,   // per region of memory, the next degree blocks along a stride seen repeatedly
+	StreamPrefetch    // distance blocks ahead of a run of misses in one direction, degree at a time
+} PrefetchPolicy;
+
+// Converts a policy name ("none", "next-line", "stride", "stream") to the PrefetchPolicy value
+// Returns false if the name is not a known policy
+bool prefetchPolicyFromName(const std::string& name, PrefetchPolicy& policy);
+
+// Returns the name of the policy
+const char* prefetchPolicyName(PrefetchPolicy policy);
+
+// Prefetcher of every core, chosen on the command line
+class PrefetchConfig {
+	public:
+		PrefetchPolicy policy;
+
+		// Blocks prefetched per trigger
+		int degree;
+
+		// Blocks the stream prefetcher runs ahead of the stream
+		int distance;
+
+		PrefetchConfig();
+};
+
+// Prefetcher of one core, which watches the accesses of the core and picks the blocks
+// its cache reads ahead with BusRd (see Simulator::prefetch)
+// It also follows every prefetched block until the core first uses it or the block
+// leaves the cache, which sorts the prefetches into:
+//  - useful: the core used the block after it arrived
+//  - late: the core used the block before it would have arrived; the core is charged the rest
+//  - useless: the block was evicted, or invalidated by another core, before it was used
+// Each prefetch is also counted when it took a block out of another core's M, E or F state,
+// and when its block was invalidated unused, which cost the writer an invalidation it
+// would not have needed
+class Prefetcher {
+	public:
+		PrefetchConfig config;
+
+		// Blocks picked by the last call to train
+		std::vector<unsigned long long> candidates;
+
+		// Counters
+		unsigned long long num_issued, num_useful, num_late, num_useless, num_invalidated, num_ownership_taken;
+
+		Prefetcher(const PrefetchConfig& _config);
+
+		// Settles the prefetch of the block the core accesses at cycle now, if there is one
+		// Returns the cycles the core still has to wait for the block, and sets prefetched
+		// if the access is the first use of a prefetched block
+		unsigned long long demand(unsigned long long block_address, unsigned long long now, bool& prefetched);
+
+		// Trains on an access and fills candidates with the blocks to prefetch
+		// trigger is set for the accesses that the next-line and stream prefetchers follow:
+		// misses, and first uses of prefetched blocks
+		void train(unsigned long long block_address, bool trigger);
+
+		// Records a prefetch that was issued, and the cycle its block arrives
+		void issued(unsigned long long block_address, unsigned long long ready) {
+			pending[block_address] = ready;
+			num_issued++;
+		}
+
+		// Records that the block left the cache; invalidated if another core took it
+		void removed(unsigned long long block_address, bool invalidated) {
+			if (pending.empty()) {
+				return;
+			}
+			std::unordered_map<unsigned long long, unsigned long long>::iterator iter = pending.find(block_address);
+			if (iter != pending.end()) {
+				pending.erase(iter);
+				num_useless++;
+				if (invalidated) {
+					num_invalidated++;
+				}
+			}
+		}
+
+		// Prints the counters, below those of the cache
+		void printStats();
+
+		// Registers the counters under group
+		void registerStats(StatsRegistry& stats, const std::string& group);
+
+	private:
+		// Prefetched blocks not used yet, and the cycle each arrives
+		std::unordered_map<unsigned long long, unsigned long long> pending;
+
+		// A region of the stride prefetcher
+		struct StrideEntry {
+			bool valid;
+			unsigned long long region;
+			unsigned long long last_block;
+			long long stride;
+			int confidence;
+		};
+		std::vector<StrideEntry> strides;
+
+		// A stream: its last miss, direction (+1, -1, or 0 until known), confidence and age
+		struct Stream {
+			bool valid;
+			unsigned long long last_block;
+			int direction;
+			int confidence;
+			unsigned long long last_use;
+		};
+		std::vector<Stream> streams;
+		unsigned long long stream_clock;
+
+		// Adds the block offset blocks from block_address to candidates, unless it wraps
+		void addCandidate(unsigned long long block_address, long long offset);
+
+		void trainStride(unsigned long long block_address);
+		void trainStream(unsigned long long block_address);
+};
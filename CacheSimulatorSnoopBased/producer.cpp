@@ -0,0 +1,81 @@
+// Test producer for the shared-memory ring of sim --shm, standing in for an
+// instrumentation tool
+//
+// Usage: producer NAME [options]
+// Writes the accesses of a trace (--trace FILE, or stdin) or of a generated workload
+// (--workload NAME ...) into the ring a simulator created under NAME, then closes it.
+// The options are those of sim; the protocol is the trace's, or --protocol for a workload.
+// Start the simulator first:  sim --shm /fesi & producer /fesi --trace trace.in
+// A one line summary goes to stderr.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "shmring.h"
+#include "trace.h"
+#include "workload.h"
+using namespace std;
+
+// Records read or generated at a time, and written to the ring as one batch
+#define PRODUCER_BATCH_SIZE 4096
+
+int main(int argc, char* argv[]) {
+	if (argc < 2 || argv[1][0] == '-') {
+		cout << "Usage: " << argv[0] << " NAME [options of sim]" << endl;
+		return 1;
+	}
+	const char* name = argv[1];
+	vector<char*> args;
+	args.push_back(argv[0]);
+	for (int i=2; i < argc; i++) {
+		args.push_back(argv[i]);
+	}
+	SimConfig config;
+	if (!parseArgs(args.size(), args.data(), config)) {
+		return 1;
+	}
+
+	WorkloadSpec spec = config.workload;
+	spec.cores = config.cores;
+	spec.block_size = config.geometry.blockSize();
+	WorkloadGenerator generator(spec);
+	TraceReader reader;
+	Protocol protocol = config.protocol;
+	if (!config.use_workload) {
+		if (!reader.open(config.trace_path.empty() ? "-" : config.trace_path.c_str())) {
+			return 1;
+		}
+		string protocol_name;
+		if (!reader.readProtocol(protocol, protocol_name)) {
+			cout << "Unknown protocol " << protocol_name << endl;
+			return 1;
+		}
+	}
+
+	ShmProducer ring;
+	if (!ring.open(name, protocol)) {
+		return 1;
+	}
+	vector<TraceRecord> batch(PRODUCER_BATCH_SIZE);
+	size_t count;
+	unsigned long long total = 0;
+	while ((count = config.use_workload ? generator.fill(batch.data(), batch.size()) : reader.read(batch.data(), batch.size())) > 0) {
+		if (!ring.write(batch.data(), count)) {
+			cout << "The simulator exited before reading every access" << endl;
+			return 1;
+		}
+		total += count;
+	}
+
+	// On an error the ring is left open, and the simulator fails as it would on the trace
+	if (reader.error()) {
+		if (reader.has_bad_core) {
+			cout << "Incorrect core number " << reader.bad_core << endl;
+		}
+		return 1;
+	}
+	ring.close();
+	cerr << "Wrote " << total << " accesses to " << name << endl;
+	return 0;
+}
@@ -0,0 +1,238 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include "profiler.h"
+
+// Odd multipliers of the row hashes
+static const unsigned long long PROFILE_HASH[PROFILE_DEPTH] = {
+	0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL, 0xd6e8feb86659fd93ULL
+};
+
+ProfilerConfig::ProfilerConfig() {
+	enabled = false;
+	top = DEFAULT_PROFILE_TOP;
+	width_bits = DEFAULT_PROFILE_WIDTH_BITS;
+}
+
+SharingProfiler::SharingProfiler(const ProfilerConfig& config, const CacheGeometry& _geometry, int _num_cores) {
+	geometry = _geometry;
+	num_cores = _num_cores;
+	// Blocks of up to PROFILE_CHUNKS bytes are tracked byte by byte
+	chunk_bits = std::max(0, geometry.offset_bits - 6);
+	top = config.top;
+	width_bits = config.width_bits;
+	sketch.assign((size_t) PROFILE_DEPTH * NUM_PROFILE_EVENTS << width_bits, 0);
+	total_traffic = 0;
+	hot.reserve(top);
+	heap.reserve(top);
+}
+
+int SharingProfiler::cellIndex(int row, unsigned long long block_address) {
+	unsigned long long x = (block_address ^ (block_address >> 29)) * PROFILE_HASH[row];
+	return (row << width_bits) + (int) (x >> (64 - width_bits));
+}
+
+unsigned long long SharingProfiler::count(unsigned long long block_address, const unsigned long long* events) {
+	unsigned long long traffic = ~0ULL;
+	for (int row=0; row < PROFILE_DEPTH; row++) {
+		unsigned long long* cell = &sketch[(size_t) cellIndex(row, block_address) * NUM_PROFILE_EVENTS];
+		unsigned long long sum = 0;
+		for (int e=0; e < NUM_PROFILE_EVENTS; e++) {
+			cell[e] += events[e];
+			sum += cell[e];
+		}
+		traffic = std::min(traffic, sum);
+	}
+	return traffic;
+}
+
+unsigned long long SharingProfiler::estimate(unsigned long long block_address, ProfileEvent event) {
+	unsigned long long value = ~0ULL;
+	for (int row=0; row < PROFILE_DEPTH; row++) {
+		value = std::min(value, sketch[(size_t) cellIndex(row, block_address) * NUM_PROFILE_EVENTS + event]);
+	}
+	return value;
+}
+
+void SharingProfiler::record(int core, ProcRequest request, unsigned long long address, const AccessOutcome& outcome) {
+	unsigned long long block_address = geometry.blockAddressOf(address);
+
+	// Hits that stay in the cache cause no traffic, and leave the sketch alone
+	if (!outcome.hit || outcome.upgrade) {
+		unsigned long long events[NUM_PROFILE_EVENTS] = {0};
+		if (!outcome.hit) {
+			events[request == ProcRequest::ProcRd ? ProfileBusRd : ProfileBusRdX] = 1;
+			events[ProfileTransfers] = outcome.supplied;
+		}
+		events[ProfileBusUpgr] = outcome.upgrade;
+		events[ProfileInvalidations] = outcome.invalidations;
+		total_traffic += events[ProfileBusRd] + events[ProfileBusRdX] + events[ProfileBusUpgr]
+			+ events[ProfileInvalidations] + events[ProfileTransfers];
+		track(block_address, count(block_address, events));
+	}
+
+	std::unordered_map<unsigned long long, int>::iterator iter = hot_index.find(block_address);
+	if (iter != hot_index.end()) {
+		int chunk = (address & (geometry.blockSize() - 1)) >> chunk_bits;
+		HotBlock& block = hot[iter->second];
+		block.chunks[2 * core + request] |= 1ULL << chunk;
+		block.accesses++;
+	}
+}
+
+void SharingProfiler::track(unsigned long long block_address, unsigned long long traffic) {
+	std::unordered_map<unsigned long long, int>::iterator iter = hot_index.find(block_address);
+	if (iter != hot_index.end()) {
+		HotBlock& block = hot[iter->second];
+		block.traffic = traffic;
+		siftDown(block.heap_index);
+		return;
+	}
+
+	int index;
+	if ((int) hot.size() < top) {
+		index = hot.size();
+		hot.push_back(HotBlock());
+		hot[index].heap_index = heap.size();
+		heap.push_back(index);
+	} else {
+		// Replace the coolest block, if this one is hotter
+		index = heap[0];
+		if (hot[index].traffic >= traffic) {
+			return;
+		}
+		hot_index.erase(hot[index].block_address);
+	}
+	HotBlock& block = hot[index];
+	block.block_address = block_address;
+	block.traffic = traffic;
+	block.accesses = 0;
+	block.chunks.assign(2 * num_cores, 0);
+	hot_index[block_address] = index;
+	siftUp(block.heap_index);
+	siftDown(block.heap_index);
+}
+
+void SharingProfiler::swapHeap(int a, int b) {
+	std::swap(heap[a], heap[b]);
+	hot[heap[a]].heap_index = a;
+	hot[heap[b]].heap_index = b;
+}
+
+void SharingProfiler::siftUp(int position) {
+	while (position > 0) {
+		int parent = (position - 1) / 2;
+		if (hot[heap[parent]].traffic <= hot[heap[position]].traffic) {
+			return;
+		}
+		swapHeap(parent, position);
+		position = parent;
+	}
+}
+
+void SharingProfiler::siftDown(int position) {
+	int size = heap.size();
+	while (true) {
+		int smallest = position;
+		int left = 2 * position + 1, right = left + 1;
+		if (left < size && hot[heap[left]].traffic < hot[heap[smallest]].traffic) {
+			smallest = left;
+		}
+		if (right < size && hot[heap[right]].traffic < hot[heap[smallest]].traffic) {
+			smallest = right;
+		}
+		if (smallest == position) {
+			return;
+		}
+		swapHeap(smallest, position);
+		position = smallest;
+	}
+}
+
+int SharingProfiler::sharers(const HotBlock& block) {
+	int cores = 0;
+	for (int c=0; c < num_cores; c++) {
+		cores += (block.chunks[2 * c] | block.chunks[2 * c + 1]) != 0;
+	}
+	return cores;
+}
+
+SharingProfiler::Sharing SharingProfiler::sharing(const HotBlock& block) {
+	if (sharers(block) < 2) {
+		return Private;
+	}
+	uint64_t all_touched = 0, all_written = 0, touched_twice = 0;
+	for (int c=0; c < num_cores; c++) {
+		uint64_t touched = block.chunks[2 * c] | block.chunks[2 * c + 1];
+		touched_twice |= all_touched & touched;
+		all_touched |= touched;
+		all_written |= block.chunks[2 * c + 1];
+	}
+	if (all_written == 0) {
+		return ReadShared;
+	}
+	// A chunk touched by two cores and written by any core is truly shared
+	return (touched_twice & all_written) != 0 ? TrueShared : FalseShared;
+}
+
+void SharingProfiler::printReport() {
+	static const char* sharing_names[] = {"private", "read-shared", "true", "false"};
+
+	// Hottest first, on the final estimates
+	std::vector<int> order;
+	std::vector<unsigned long long> traffic(hot.size());
+	unsigned long long none[NUM_PROFILE_EVENTS] = {0};
+	for (size_t i=0; i < hot.size(); i++) {
+		order.push_back(i);
+		traffic[i] = count(hot[i].block_address, none);
+	}
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return traffic[a] != traffic[b] ? traffic[a] > traffic[b] : hot[a].block_address < hot[b].block_address;
+	});
+
+	// Count-Min: every estimate exceeds its true count by at most e / width of the total,
+	// except with probability e^-depth
+	unsigned long long error = (unsigned long long) std::ceil(std::exp(1.0) * total_traffic / (1 << width_bits));
+
+	std::cout << std::dec;
+	std::cout << ">> Sharing profile: top " << hot.size() << " blocks by coherence traffic\n";
+	std::cout << "Traffic is BusRd + BusRdX + BusUpgr + invalidations + transfers, " << total_traffic << " in all\n";
+	std::cout << "Cores and sharing cover the accesses profiled since the block entered the top\n";
+	std::cout << "Estimates are at most " << error << " over the true counts (" << PROFILE_DEPTH << " x " << (1 << width_bits)
+		<< " sketch, " << std::fixed << std::setprecision(0) << 100 * (1 - std::exp(-(double) PROFILE_DEPTH)) << "% confidence)\n";
+	std::cout << std::setw(18) << std::left << "Address" << std::right << std::setw(12) << "Traffic" << std::setw(11) << "BusRd"
+		<< std::setw(11) << "BusRdX" << std::setw(11) << "BusUpgr" << std::setw(11) << "Invalid." << std::setw(11) << "Transfers"
+		<< std::setw(12) << "Profiled" << std::setw(7) << "Cores" << "  Sharing\n";
+	for (size_t i=0; i < order.size(); i++) {
+		const HotBlock& block = hot[order[i]];
+		std::cout << "0x" << std::setw(16) << std::left << std::hex << (block.block_address << geometry.offset_bits)
+			<< std::right << std::dec << std::setw(12) << traffic[order[i]];
+		for (int e=0; e < NUM_PROFILE_EVENTS; e++) {
+			std::cout << std::setw(11) << estimate(block.block_address, (ProfileEvent) e);
+		}
+		std::cout << std::setw(12) << block.accesses << std::setw(7) << sharers(block) << "  " << sharing_names[sharing(block)] << '\n';
+	}
+
+	std::cout << ">> False sharing: hot blocks whose cores touch disjoint chunks of " << (1 << chunk_bits) << " byte(s)\n";
+	bool any = false;
+	for (size_t i=0; i < order.size(); i++) {
+		const HotBlock& block = hot[order[i]];
+		if (sharing(block) != FalseShared) {
+			continue;
+		}
+		any = true;
+		std::cout << "0x" << std::hex << (block.block_address << geometry.offset_bits) << std::dec << '\n';
+		for (int c=0; c < num_cores; c++) {
+			if ((block.chunks[2 * c] | block.chunks[2 * c + 1]) == 0) {
+				continue;
+			}
+			std::cout << "  Core " << std::setw(4) << std::left << c << std::right << std::hex << std::setfill('0')
+				<< " read chunks 0x" << std::setw(16) << block.chunks[2 * c]
+				<< ", wrote chunks 0x" << std::setw(16) << block.chunks[2 * c + 1] << std::setfill(' ') << std::dec << '\n';
+		}
+	}
+	if (!any) {
+		std::cout << "None\n";
+	}
+}
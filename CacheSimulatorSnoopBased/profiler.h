@@ -0,0 +1,114 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "request.h"
+#include "geometry.h"
+#include "latency.h"
+
+// Defaults of the sharing profiler
+#define DEFAULT_PROFILE_TOP 16
+#define DEFAULT_PROFILE_WIDTH_BITS 14
+
+// Rows of the Count-Min sketch, each with its own hash
+#define PROFILE_DEPTH 4
+
+// Chunks a block is split into to tell which parts of it each core touches
+#define PROFILE_CHUNKS 64
+
+// Coherence events counted per block
+typedef enum {
+	ProfileBusRd,
+	ProfileBusRdX,
+	ProfileBusUpgr,
+	ProfileInvalidations, // copies invalidated in other caches
+	ProfileTransfers,     // misses served by another cache
+	NUM_PROFILE_EVENTS
+} ProfileEvent;
+
+// Shape of the profiler, chosen on the command line
+class ProfilerConfig {
+	public:
+		bool enabled;
+
+		// Hot blocks tracked and reported
+		int top;
+
+		// Columns of every sketch row, a power of two
+		int width_bits;
+
+		ProfilerConfig();
+};
+
+// Finds the blocks causing the coherence traffic, in bounded memory
+// The events of every block go into a Count-Min sketch, whose estimates never fall
+// below the true counts; a min-heap keeps the top blocks by estimated traffic. Only
+// those blocks are tracked in detail: which cores touched them, and which chunks each
+// core read and wrote, from which the report tells true from false sharing.
+// The details of a block start when it enters the top, so they cover its hottest part.
+class SharingProfiler {
+	public:
+		SharingProfiler(const ProfilerConfig& config, const CacheGeometry& _geometry, int num_cores);
+
+		// Records an access of the core given, and what it did
+		void record(int core, ProcRequest request, unsigned long long address, const AccessOutcome& outcome);
+
+		// Prints the hot blocks, hottest first, and those of them falsely shared
+		void printReport();
+
+	private:
+		// A block in the top, and what it has been doing since it entered
+		class HotBlock {
+			public:
+				unsigned long long block_address;
+				unsigned long long traffic;
+				int heap_index;
+
+				// Accesses since it entered the top
+				unsigned long long accesses;
+
+				// Per core: a bit per chunk read, then a bit per chunk written
+				std::vector<uint64_t> chunks;
+		};
+
+		// Sharing of a hot block, from the chunks its cores touched
+		typedef enum {
+			Private,    // one core
+			ReadShared, // several cores, no writes
+			TrueShared, // a core writes a chunk another core touches
+			FalseShared // several cores, at least one writer, no chunk in common
+		} Sharing;
+
+		CacheGeometry geometry;
+		int num_cores;
+		int chunk_bits;
+		int top;
+
+		// Count-Min sketch: PROFILE_DEPTH rows of width cells, each a counter per event
+		int width_bits;
+		std::vector<unsigned long long> sketch;
+		unsigned long long total_traffic;
+
+		// The top blocks, a min-heap on traffic over hot
+		std::vector<HotBlock> hot;
+		std::vector<int> heap;
+		std::unordered_map<unsigned long long, int> hot_index;
+
+		int cellIndex(int row, unsigned long long block_address);
+
+		// Adds the events (which may all be zero) to the sketch and returns the block's estimated traffic
+		unsigned long long count(unsigned long long block_address, const unsigned long long* events);
+
+		// Returns the estimated count of the event for the block
+		unsigned long long estimate(unsigned long long block_address, ProfileEvent event);
+
+		// Admits the block into the top if it is hotter than the coolest block there
+		void track(unsigned long long block_address, unsigned long long traffic);
+
+		void siftUp(int position);
+		void siftDown(int position);
+		void swapHeap(int a, int b);
+
+		int sharers(const HotBlock& block);
+		Sharing sharing(const HotBlock& block);
+};
@@ -0,0 +1,35 @@
+#include <string>
+#include "protocol.h"
+
+bool protocolFromName(const std::string& name, Protocol& protocol) {
+	if (name == "MSI") {
+		protocol = Protocol::MSI;
+	} else if (name == "MESI") {
+		protocol = Protocol::MESI;
+	} else if (name == "MESIF") {
+		protocol = Protocol::MESIF;
+	} else if (name == "MOESI") {
+		protocol = Protocol::MOESI;
+	} else if (name == "FESI") {
+		protocol = Protocol::FESI;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+const char* protocolName(Protocol protocol) {
+	switch (protocol) {
+		case Protocol::MSI:
+			return "MSI";
+		case Protocol::MESI:
+			return "MESI";
+		case Protocol::MESIF:
+			return "MESIF";
+		case Protocol::MOESI:
+			return "MOESI";
+		case Protocol::FESI:
+			return "FESI";
+	}
+	return "Unknown";
+}
@@ -0,0 +1,183 @@
+#pragma once
+#include <string>
+#include "request.h"
+#include "cacheset.h"
+
+// Converts a protocol name ("MSI", "MESI", ...) to the Protocol value
+// Returns false if the name is not a known protocol
+bool protocolFromName(const std::string& name, Protocol& protocol);
+
+// Returns the name of the protocol
+const char* protocolName(Protocol protocol);
+
+// Each protocol is described by a ProtocolTable; coherence.cpp instantiates the
+// request handlers once per protocol from these tables.
+// Adding a protocol means adding a Protocol value, its name and its table.
+
+// Effects of a transition, applied in the order listed
+typedef enum {
+	SendFlush = 1 << 0,          // put the block on the bus with a write back to memory
+	SendFlushPrime = 1 << 1,     // put the block on the bus for the requesting cache only
+	SendBusUpgr = 1 << 2,        // (processor hits) invalidate the other copies
+	RaiseShared = 1 << 3,        // raise the shared line
+	RaiseSupplied = 1 << 4,      // raise the supplied line
+	CountWriteback = 1 << 5,
+	CountInvalidation = 1 << 6,
+	CountProvided = 1 << 7,
+	SupplyIfUnsupplied = 1 << 8, // if no cache supplied the block yet: raise supplied, Flush_prime, count provided and random
+	TakeFIfUnsupplied = 1 << 9   // if no cache took the F tag yet: raise supplied, go to Forward, count random
+} TransitionEffect;
+
+// KeepState as the next state leaves the state of the block unchanged
+#define KeepState (-1)
+
+class Transition {
+	public:
+		signed char next;
+		unsigned short effects;
+};
+
+// What happens to a block evicted to make room for a miss
+typedef enum {
+	DropVictim,      // clean, silently dropped
+	WritebackVictim, // dirty, Flush to memory
+	HandOffF         // FESI: offer the F tag to a sharer with setF, Flush to memory if nobody takes it
+} VictimAction;
+
+#define NUM_SNOOPED_REQUESTS 4 // BusRd, BusRdX, BusUpgr and setF reach the other caches
+#define NUM_BLOCK_STATES 6
+
+class ProtocolTable {
+	public:
+		// Reaction of a cache holding the block in a state to a request snooped on the bus
+		Transition snoop[NUM_SNOOPED_REQUESTS][NUM_BLOCK_STATES];
+
+		// Processor hits; the block is always moved to the MRU position first
+		Transition hit[2][NUM_BLOCK_STATES];
+
+		// State of a block filled by a read miss, depending on the shared line, and by a write miss
+		CacheBlockState read_fill_shared, read_fill_alone, write_fill;
+
+		// Handling of the victim of a miss, by its state
+		VictimAction victim[NUM_BLOCK_STATES];
+};
+
+// Shorthands for the tables below
+#define T(next, effects) Transition{(signed char) (next), (unsigned short) (effects)}
+#define NONE T(KeepState, 0)
+#define SUPPLY_DIRTY (SendFlush | RaiseSupplied | CountWriteback | CountProvided)
+#define SUPPLY_CLEAN (SendFlushPrime | RaiseSupplied | CountProvided)
+
+// Rows are in CacheBlockState order: Modified, Exclusive, Shared, Invalid, Owned, Forward
+constexpr ProtocolTable PROTOCOL_TABLES[] = {
+	// MSI
+	{
+		{
+			// BusRd
+			{T(Shared, SUPPLY_DIRTY), NONE, T(KeepState, SupplyIfUnsupplied), NONE, NONE, NONE},
+			// BusRdX
+			{T(Invalid, SUPPLY_DIRTY | CountInvalidation), NONE, T(Invalid, CountInvalidation | SupplyIfUnsupplied), NONE, NONE, NONE},
+			// BusUpgr
+			{T(Invalid, SendFlush | CountWriteback | CountInvalidation), NONE, T(Invalid, CountInvalidation), NONE, NONE, NONE},
+			// setF
+			{NONE, NONE, T(KeepState, TakeFIfUnsupplied), NONE, NONE, NONE}
+		},
+		{
+			// ProcRd
+			{NONE, NONE, NONE, NONE, NONE, NONE},
+			// ProcWr
+			{NONE, NONE, T(Modified, SendBusUpgr), NONE, NONE, NONE}
+		},
+		Shared, Shared, Modified,
+		{WritebackVictim, DropVictim, DropVictim, DropVictim, DropVictim, DropVictim}
+	},
+	// MESI
+	{
+		{
+			// BusRd
+			{T(Shared, SUPPLY_DIRTY | RaiseShared), T(Shared, SUPPLY_CLEAN | RaiseShared), T(KeepState, RaiseShared | SupplyIfUnsupplied), NONE, NONE, NONE},
+			// BusRdX
+			{T(Invalid, SUPPLY_DIRTY | CountInvalidation), T(Invalid, SUPPLY_CLEAN | CountInvalidation), T(Invalid, SendFlush | CountInvalidation | SupplyIfUnsupplied), NONE, NONE, NONE},
+			// BusUpgr
+			{T(Invalid, SendFlush | CountWriteback | CountInvalidation), T(Invalid, CountInvalidation), T(Invalid, CountInvalidation), NONE, NONE, NONE},
+			// setF
+			{NONE, NONE, T(KeepState, TakeFIfUnsupplied), NONE, NONE, NONE}
+		},
+		{
+			// ProcRd
+			{NONE, NONE, NONE, NONE, NONE, NONE},
+			// ProcWr
+			{NONE, T(Modified, 0), T(Modified, SendBusUpgr), NONE, NONE, NONE}
+		},
+		Shared, Exclusive, Modified,
+		{WritebackVictim, DropVictim, DropVictim, DropVictim, DropVictim, DropVictim}
+	},
+	// MESIF
+	{
+		{
+			// BusRd
+			{T(Shared, SUPPLY_DIRTY | RaiseShared), T(Shared, SUPPLY_CLEAN | RaiseShared), T(KeepState, RaiseShared), NONE, NONE, T(Shared, SUPPLY_CLEAN | RaiseShared)},
+			// BusRdX
+			{T(Invalid, SUPPLY_DIRTY | CountInvalidation), T(Invalid, SUPPLY_CLEAN | CountInvalidation), T(Invalid, CountInvalidation), NONE, NONE, T(Invalid, SUPPLY_CLEAN | CountInvalidation)},
+			// BusUpgr
+			{T(Invalid, SendFlush | CountWriteback | CountInvalidation), T(Invalid, CountInvalidation), T(Invalid, CountInvalidation), NONE, NONE, T(Invalid, CountInvalidation)},
+			// setF
+			{NONE, NONE, T(KeepState, TakeFIfUnsupplied), NONE, NONE, NONE}
+		},
+		{
+			// ProcRd
+			{NONE, NONE, NONE, NONE, NONE, NONE},
+			// ProcWr
+			{NONE, T(Modified, 0), T(Modified, SendBusUpgr), NONE, NONE, T(Modified, SendBusUpgr)}
+		},
+		Forward, Exclusive, Modified,
+		{WritebackVictim, DropVictim, DropVictim, DropVictim, DropVictim, DropVictim}
+	},
+	// MOESI
+	{
+		{
+			// BusRd: M keeps the dirty block as Owned instead of writing it back
+			{T(Owned, SUPPLY_CLEAN | RaiseShared), T(Shared, SUPPLY_CLEAN | RaiseShared), T(KeepState, RaiseShared), NONE, T(KeepState, SUPPLY_CLEAN | RaiseShared), NONE},
+			// BusRdX
+			{T(Invalid, SUPPLY_DIRTY | CountInvalidation), T(Invalid, SUPPLY_CLEAN | CountInvalidation), T(Invalid, CountInvalidation), NONE, T(Invalid, SUPPLY_DIRTY | CountInvalidation), NONE},
+			// BusUpgr
+			{T(Invalid, SendFlush | CountWriteback | CountInvalidation), T(Invalid, CountInvalidation), T(Invalid, CountInvalidation), NONE, T(Invalid, SendFlush | CountWriteback | CountInvalidation), NONE},
+			// setF
+			{NONE, NONE, T(KeepState, TakeFIfUnsupplied), NONE, NONE, NONE}
+		},
+		{
+			// ProcRd
+			{NONE, NONE, NONE, NONE, NONE, NONE},
+			// ProcWr
+			{NONE, T(Modified, 0), T(Modified, SendBusUpgr), NONE, T(Modified, SendBusUpgr), NONE}
+		},
+		Shared, Exclusive, Modified,
+		{WritebackVictim, DropVictim, DropVictim, DropVictim, WritebackVictim, DropVictim}
+	},
+	// FESI: F is the single owner of a (possibly dirty) block, S copies never answer the bus
+	{
+		{
+			// BusRd
+			{NONE, T(Shared, SUPPLY_CLEAN | RaiseShared), NONE, NONE, NONE, T(Shared, SUPPLY_CLEAN | RaiseShared)},
+			// BusRdX
+			{NONE, T(Invalid, SUPPLY_CLEAN | CountInvalidation), T(Invalid, CountInvalidation), NONE, NONE, T(Invalid, SUPPLY_CLEAN | CountInvalidation)},
+			// BusUpgr
+			{NONE, T(Invalid, CountInvalidation), T(Invalid, CountInvalidation), NONE, NONE, T(Invalid, CountInvalidation)},
+			// setF
+			{NONE, NONE, T(KeepState, TakeFIfUnsupplied), NONE, NONE, NONE}
+		},
+		{
+			// ProcRd
+			{NONE, NONE, NONE, NONE, NONE, NONE},
+			// ProcWr
+			{NONE, T(Forward, 0), T(Forward, SendBusUpgr), NONE, NONE, T(KeepState, SendBusUpgr)}
+		},
+		Forward, Exclusive, Forward,
+		{DropVictim, DropVictim, DropVictim, DropVictim, DropVictim, HandOffF}
+	}
+};
+
+#undef T
+#undef NONE
+#undef SUPPLY_DIRTY
+#undef SUPPLY_CLEAN
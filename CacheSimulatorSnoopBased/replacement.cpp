@@ -0,0 +1,33 @@
+#include "replacement.h"
+
+static const char* POLICY_NAMES[] = {"lru", "tree-plru", "srrip", "brrip", "drrip", "random", "coherence-lru"};
+
+bool policyFromName(const std::string& name, ReplacementPolicy& policy) {
+	for (int i=0; i <= ReplacementPolicy::CoherenceLRU; i++) {
+		if (name == POLICY_NAMES[i]) {
+			policy = (ReplacementPolicy) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* policyName(ReplacementPolicy policy) {
+	return POLICY_NAMES[policy];
+}
+
+ReplacementState::ReplacementState() {
+	rng = 0x2545f4914f6cdd1dULL;
+	brrip_inserts = 0;
+	psel = 1 << (PSEL_BITS - 1);
+}
+
+DuelRole ReplacementState::roleOf(int set_index) {
+	switch (set_index % DUEL_SPACING) {
+		case 0:
+			return DuelRole::SRRIPLeader;
+		case 1:
+			return DuelRole::BRRIPLeader;
+	}
+	return DuelRole::Follower;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+typedef enum {
+	LRU,          // true LRU, the default
+	TreePLRU,     // a binary tree of ways-1 bits points at the pseudo-LRU way
+	SRRIP,        // static re-reference interval prediction, 2-bit RRPVs
+	BRRIP,        // bimodal RRIP: inserts at distant re-reference, rarely at long
+	DRRIP,        // SRRIP or BRRIP, whichever misses less in its leader sets (set dueling)
+	RandomVictim, // a pseudo-random way
+	CoherenceLRU  // LRU among the Shared (clean, not the only copy) blocks, LRU otherwise
+} ReplacementPolicy;
+
+// Converts a policy name ("lru", "tree-plru", ...) to the ReplacementPolicy value
+// Returns false if the name is not a known policy
+bool policyFromName(const std::string& name, ReplacementPolicy& policy);
+
+// Returns the name of the policy
+const char* policyName(ReplacementPolicy policy);
+
+// Re-reference prediction values are 2 bits: 0 is near-immediate reuse, RRPV_MAX distant
+#define RRPV_MAX 3
+
+// BRRIP inserts one block in this many at the long instead of the distant interval
+#define BRRIP_LONG_INTERVAL 32
+
+// DRRIP: one set in DUEL_SPACING is an SRRIP leader and the next one a BRRIP leader;
+// PSEL is a saturating counter of PSEL_BITS bits
+#define DUEL_SPACING 32
+#define PSEL_BITS 10
+
+// Role of a set under DRRIP
+typedef enum {
+	Follower,
+	SRRIPLeader,
+	BRRIPLeader
+} DuelRole;
+
+// State a policy shares among all sets of a cache
+class ReplacementState {
+	public:
+		// Random victims; the sequence is fixed so that runs are reproducible
+		uint64_t rng;
+
+		// BRRIP insertions, to pick every BRRIP_LONG_INTERVAL-th one
+		unsigned int brrip_inserts;
+
+		// DRRIP selector: SRRIP leader misses count up, BRRIP leader misses count down,
+		// and the followers use BRRIP while it is in the upper half
+		int psel;
+
+		ReplacementState();
+
+		// xorshift64
+		uint64_t nextRandom() {
+			rng ^= rng << 13;
+			rng ^= rng >> 7;
+			rng ^= rng << 17;
+			return rng;
+		}
+
+		// Returns the DuelRole of a set under DRRIP
+		static DuelRole roleOf(int set_index);
+};
@@ -0,0 +1,263 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <cmath>
+#include "sampling.h"
+#include "simulator.h"
+
+// Records pulled from the source at a time
+#define SAMPLER_BATCH_SIZE 4096
+
+// Two-sided 95% quantile of the normal distribution
+#define Z_95 1.96
+
+static const char* SAMPLED_STAT_NAMES[NUM_SAMPLED_STATS] = {"Reads", "Read misses", "Writes", "Write misses",
+	"Invalidations", "Writebacks", "Provided", "From LLC", "Random", "BusRd", "BusRdX", "BusUpgr", "Flushes", "Cycles"};
+
+SamplingConfig::SamplingConfig() {
+	enabled = false;
+	period = DEFAULT_SAMPLE_PERIOD;
+	window = DEFAULT_SAMPLE_WINDOW;
+	warmup = DEFAULT_SAMPLE_WARMUP;
+}
+
+bool loadSimPoints(const SamplingConfig& config, std::vector<SimPoint>& simpoints) {
+	std::ifstream points_in(config.simpoints_path);
+	std::ifstream weights_in(config.weights_path);
+	if (!points_in) {
+		std::cout << "Cannot open SimPoint file " << config.simpoints_path << std::endl;
+		return false;
+	}
+	if (!weights_in) {
+		std::cout << "Cannot open SimPoint weights file " << config.weights_path << std::endl;
+		return false;
+	}
+
+	// Both files are matched up by cluster
+	std::map<long long, double> weights;
+	std::string line;
+	while (std::getline(weights_in, line)) {
+		std::istringstream fields(line);
+		double weight;
+		long long cluster;
+		if (fields >> weight >> cluster) {
+			weights[cluster] = weight;
+		}
+	}
+	simpoints.clear();
+	while (std::getline(points_in, line)) {
+		std::istringstream fields(line);
+		long long interval, cluster;
+		if (!(fields >> interval >> cluster)) {
+			continue;
+		}
+		if (interval < 0 || weights.count(cluster) == 0) {
+			std::cout << "SimPoint interval " << interval << " of cluster " << cluster << " has no weight" << std::endl;
+			return false;
+		}
+		simpoints.push_back(SimPoint{(uint64_t) interval, weights[cluster]});
+	}
+	if (simpoints.empty()) {
+		std::cout << "No simulation points in " << config.simpoints_path << std::endl;
+		return false;
+	}
+	std::sort(simpoints.begin(), simpoints.end(), [](const SimPoint& a, const SimPoint& b) {
+		return a.interval < b.interval;
+	});
+	// Windows are measured in order, and a window cannot start before the previous one ended
+	for (size_t i=1; i < simpoints.size(); i++) {
+		if (simpoints[i].interval == simpoints[i - 1].interval) {
+			std::cout << "SimPoint interval " << simpoints[i].interval << " is listed more than once" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+Sampler::Sampler(Simulator& _sim, const SamplingConfig& _config, const std::vector<SimPoint>& _simpoints) : sim(_sim) {
+	config = _config;
+	simpoints = _simpoints;
+	position = 0;
+	next_unit = 0;
+	window_end = 0;
+	detailed_accesses = 0;
+	if (nextWindow()) {
+		phase = Phase::FastForward;
+		next_change = warmup_start;
+	} else {
+		phase = Phase::Skip;
+		next_change = UINT64_MAX;
+	}
+}
+
+bool Sampler::nextWindow() {
+	uint64_t previous_end = window_end;
+	if (simpoints.empty()) {
+		window_end = (next_unit + 1) * config.period;
+		measure_start = window_end - config.window;
+		window_weight = 1;
+	} else {
+		if (next_unit >= simpoints.size()) {
+			return false;
+		}
+		measure_start = simpoints[next_unit].interval * config.period;
+		window_end = measure_start + config.period;
+		window_weight = simpoints[next_unit].weight;
+	}
+	next_unit++;
+	// The warm-up never reaches back into the previous window
+	warmup_start = measure_start - std::min(config.warmup, measure_start - previous_end);
+	return true;
+}
+
+void Sampler::nextPhase() {
+	switch (phase) {
+		case Phase::FastForward:
+			phase = Phase::Warmup;
+			next_change = measure_start;
+			break;
+		case Phase::Warmup:
+			phase = Phase::Measure;
+			readCounters(window_start_values);
+			next_change = window_end;
+			break;
+		case Phase::Measure:
+			endWindow();
+			if (nextWindow()) {
+				phase = Phase::FastForward;
+				next_change = warmup_start;
+			} else {
+				phase = Phase::Skip;
+				next_change = UINT64_MAX;
+			}
+			break;
+		case Phase::Skip:
+			break;
+	}
+}
+
+void Sampler::readCounters(unsigned long long* values) {
+	for (int stat=0; stat <= CacheStats::Random; stat++) {
+		values[stat] = sim.totalStats((CacheStats) stat);
+	}
+	values[SAMPLED_BUSRD] = sim.bus->num_busrd;
+	values[SAMPLED_BUSRDX] = sim.bus->num_busrdx;
+	values[SAMPLED_BUSUPGR] = sim.bus->num_busupgr;
+	values[SAMPLED_FLUSHES] = sim.bus->num_flushes;
+	values[SAMPLED_CYCLES] = sim.totalCycles();
+}
+
+void Sampler::endWindow() {
+	Sample sample;
+	sample.weight = window_weight;
+	readCounters(sample.values);
+	for (int stat=0; stat < NUM_SAMPLED_STATS; stat++) {
+		sample.values[stat] -= window_start_values[stat];
+	}
+	// A window cut short by the end of the trace may have measured nothing
+	if (sample.values[CacheStats::Reads] + sample.values[CacheStats::Writes] > 0) {
+		samples.push_back(sample);
+	}
+}
+
+bool Sampler::run(RecordSource source, int& bad_core) {
+	std::vector<TraceRecord> batch(SAMPLER_BATCH_SIZE);
+	int num_cores = sim.numCores();
+	size_t count;
+	while ((count = source(batch.data(), batch.size())) > 0) {
+		for (size_t i=0; i < count; i++) {
+			if (batch[i].core >= num_cores) {
+				bad_core = batch[i].core;
+				return false;
+			}
+		}
+		// The batch is cut into runs of accesses in the same phase
+		size_t i = 0;
+		while (i < count) {
+			while (position == next_change) {
+				nextPhase();
+			}
+			size_t start = i;
+			size_t end = i + std::min<uint64_t>(count - i, next_change - position);
+			switch (phase) {
+				case Phase::FastForward:
+					for (; i < end; i++) {
+						sim.warm(batch[i].core, (ProcRequest) batch[i].op, batch[i].address);
+					}
+					break;
+				case Phase::Warmup:
+				case Phase::Measure:
+					detailed_accesses += end - start;
+					for (; i < end; i++) {
+						sim.access(batch[i].core, (ProcRequest) batch[i].op, batch[i].address);
+					}
+					break;
+				case Phase::Skip:
+					i = end;
+					break;
+			}
+			position += end - start;
+		}
+	}
+	if (phase == Phase::Measure) {
+		endWindow();
+	}
+	return true;
+}
+
+void Sampler::printStats() {
+	std::cout << std::dec << std::fixed;
+	if (simpoints.empty()) {
+		std::cout << ">>>> Sampled simulation (periodic: the last " << config.window << " of every " << config.period
+			<< " accesses, after " << config.warmup << " of detailed warm-up)\n";
+	} else {
+		std::cout << ">>>> Sampled simulation (SimPoint: " << simpoints.size() << " intervals of " << config.period
+			<< " accesses, after " << config.warmup << " of detailed warm-up)\n";
+	}
+	unsigned long long measured = 0;
+	double total_weight = 0;
+	for (size_t i=0; i < samples.size(); i++) {
+		measured += samples[i].values[CacheStats::Reads] + samples[i].values[CacheStats::Writes];
+		total_weight += samples[i].weight;
+	}
+	std::cout << std::setprecision(2);
+	std::cout << "Accesses      : " << position << '\n';
+	std::cout << "Detailed      : " << detailed_accesses << " (" << (position ? 100.0 * detailed_accesses / position : 0.0) << "%)\n";
+	std::cout << "Measured      : " << measured << " in " << samples.size() << " windows\n";
+	if (samples.empty() || total_weight <= 0) {
+		std::cout << "No window was measured\n";
+		return;
+	}
+
+	// Each counter is estimated from its rate per access in the windows, weighted
+	// by the SimPoint weights; periodic windows are a systematic sample of equal weight,
+	// and their spread gives the confidence interval
+	std::cout << std::left << std::setw(16) << "Counter" << std::right << std::setw(18) << "Estimate"
+		<< std::setw(16) << "+-95%" << std::setw(14) << "Per access\n";
+	for (int stat=0; stat < NUM_SAMPLED_STATS; stat++) {
+		std::vector<double> rates(samples.size());
+		double mean = 0;
+		for (size_t i=0; i < samples.size(); i++) {
+			const Sample& sample = samples[i];
+			rates[i] = (double) sample.values[stat] / (sample.values[CacheStats::Reads] + sample.values[CacheStats::Writes]);
+			mean += sample.weight * rates[i];
+		}
+		mean /= total_weight;
+		std::cout << std::left << std::setw(16) << SAMPLED_STAT_NAMES[stat] << std::right
+			<< std::setprecision(0) << std::setw(18) << mean * position;
+		if (simpoints.empty() && samples.size() > 1) {
+			double variance = 0;
+			for (size_t i=0; i < samples.size(); i++) {
+				variance += (rates[i] - mean) * (rates[i] - mean);
+			}
+			variance /= samples.size() - 1;
+			std::cout << std::setw(16) << Z_95 * sqrt(variance / samples.size()) * position;
+		} else {
+			std::cout << std::setw(16) << "-";
+		}
+		std::cout << std::setprecision(6) << std::setw(14) << mean << '\n';
+	}
+}
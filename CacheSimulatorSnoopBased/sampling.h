@@ -0,0 +1,114 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "request.h"
+#include "trace.h"
+
+class Simulator;
+
+// Defaults of periodic sampling, in accesses
+#define DEFAULT_SAMPLE_PERIOD 1000000
+#define DEFAULT_SAMPLE_WINDOW 10000
+#define DEFAULT_SAMPLE_WARMUP 10000
+
+// Counters measured in every window: the CacheStats, then these
+#define SAMPLED_BUSRD (CacheStats::Random + 1)
+#define SAMPLED_BUSRDX (CacheStats::Random + 2)
+#define SAMPLED_BUSUPGR (CacheStats::Random + 3)
+#define SAMPLED_FLUSHES (CacheStats::Random + 4)
+#define SAMPLED_CYCLES (CacheStats::Random + 5)
+#define NUM_SAMPLED_STATS (CacheStats::Random + 6)
+
+// An interval SimPoint picked to represent its cluster, and the cluster's weight
+class SimPoint {
+	public:
+		uint64_t interval;
+		double weight;
+};
+
+// How a sampled run picks the accesses it simulates in detail
+// Periodic sampling measures the last window accesses of every period, SimPoint sampling
+// the intervals (of period accesses) listed in simpoints. Either way the warmup accesses
+// before a window are simulated in detail but not measured, and every other access only
+// warms the caches (see Simulator::warm).
+class SamplingConfig {
+	public:
+		bool enabled;
+		uint64_t period;
+		uint64_t window;
+		uint64_t warmup;
+
+		// SimPoint output files: "interval cluster" and "weight cluster" per line
+		// Both empty for periodic sampling
+		std::string simpoints_path;
+		std::string weights_path;
+
+		SamplingConfig();
+};
+
+// Reads the SimPoint files of config into simpoints, sorted by interval
+// Returns false (after printing the reason) if they cannot be read, an interval has no
+// weight, or an interval is listed twice
+bool loadSimPoints(const SamplingConfig& config, std::vector<SimPoint>& simpoints);
+
+// Runs a Simulator over a trace, switching between functional warming, detailed
+// warm-up and measured windows, and extrapolates the counters of the windows to
+// the whole trace
+class Sampler {
+	public:
+		// simpoints is empty for periodic sampling
+		Sampler(Simulator& _sim, const SamplingConfig& _config, const std::vector<SimPoint>& _simpoints);
+
+		// Simulates every access from source
+		// Returns false, with the core in bad_core, on a core the simulator does not have
+		bool run(RecordSource source, int& bad_core);
+
+		// Prints the estimate of every counter over the whole trace, with its 95%
+		// confidence interval under periodic sampling
+		void printStats();
+
+	private:
+		typedef enum {
+			FastForward, // functional warming only
+			Warmup,      // detailed, not measured
+			Measure,     // detailed and measured
+			Skip         // past the last SimPoint, the accesses are only counted
+		} Phase;
+
+		// Counters of one measured window, and its weight
+		class Sample {
+			public:
+				double weight;
+				unsigned long long values[NUM_SAMPLED_STATS];
+		};
+
+		Simulator& sim;
+		SamplingConfig config;
+		std::vector<SimPoint> simpoints;
+
+		// Accesses seen so far, and the one where the phase changes next
+		uint64_t position;
+		uint64_t next_change;
+		Phase phase;
+
+		// The next window: its warm-up start, its measurement start and its end
+		uint64_t warmup_start, measure_start, window_end;
+		double window_weight;
+		uint64_t next_unit;
+
+		uint64_t detailed_accesses;
+		unsigned long long window_start_values[NUM_SAMPLED_STATS];
+		std::vector<Sample> samples;
+
+		// Moves on to the next window; returns false if there is none
+		bool nextWindow();
+
+		// Moves on to the next phase at position == next_change
+		void nextPhase();
+
+		// Records the counters at the end of a window less those at its start
+		void endWindow();
+
+		void readCounters(unsigned long long* values);
+};
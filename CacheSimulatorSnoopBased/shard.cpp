@@ -0,0 +1,141 @@
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include "shard.h"
+
+// Records partitioned at a time; the offsets of a chunk fit in 32 bits
+#define SHARD_CHUNK_RECORDS (1 << 20)
+
+// Per chunk of the trace, and per shard, the offsets in the chunk of the records of the shard
+typedef std::vector<std::vector<std::vector<uint32_t> > > ShardLists;
+
+// Sorts the records of every step-th chunk, from the first one given, by shard
+static void partitionChunks(ShardLists& lists, const TraceRecord* records, uint64_t num_records, const CacheGeometry& geometry, size_t first, size_t step) {
+	int num_shards = lists[0].size();
+	for (size_t c=first; c < lists.size(); c += step) {
+		uint64_t start = (uint64_t) c * SHARD_CHUNK_RECORDS;
+		uint32_t count = std::min<uint64_t>(num_records - start, SHARD_CHUNK_RECORDS);
+		for (uint32_t i=0; i < count; i++) {
+			int set = geometry.setIndex(geometry.blockAddressOf(records[start + i].address));
+			lists[c][shardOf(set, num_shards)].push_back(i);
+		}
+	}
+}
+
+// Simulates the records of the shard, chunk by chunk, which keeps them in trace order
+static void simulateShard(Simulator& shard, ShardLists& lists, const TraceRecord* records, int index) {
+	for (size_t c=0; c < lists.size(); c++) {
+		const TraceRecord* chunk = records + (uint64_t) c * SHARD_CHUNK_RECORDS;
+		std::vector<uint32_t>& list = lists[c][index];
+		for (size_t i=0; i < list.size(); i++) {
+			const TraceRecord& record = chunk[list[i]];
+			shard.access(record.core, (ProcRequest) record.op, record.address);
+		}
+		std::vector<uint32_t>().swap(list);
+	}
+}
+
+// Adds the counters of the shard to sim, and copies the sets the shard owns
+static void mergeShard(Simulator& sim, Simulator& shard, int index, int num_shards) {
+	for (int c=0; c < sim.numCores(); c++) {
+		Cache& cache = *sim.caches[c];
+		Cache& from = *shard.caches[c];
+		int ways = cache.geometry.associativity;
+		for (int set=index; set < cache.geometry.numSets(); set += num_shards) {
+			int from_way = (set >> from.shard_bits) * ways;
+			for (int w=set * ways; w < (set + 1) * ways; w++, from_way++) {
+				cache.tag_store[w] = from.tag_store[from_way];
+				cache.state_store[w] = from.state_store[from_way];
+				cache.repl_store[w] = from.repl_store[from_way];
+			}
+		}
+		cache.num_reads += from.num_reads;
+		cache.num_read_misses += from.num_read_misses;
+		cache.num_writes += from.num_writes;
+		cache.num_write_misses += from.num_write_misses;
+		cache.num_writebacks += from.num_writebacks;
+		cache.num_invalidations += from.num_invalidations;
+		cache.num_provided += from.num_provided;
+		cache.num_fromLLC += from.num_fromLLC;
+		cache.num_random += from.num_random;
+		cache.num_cycles += from.num_cycles;
+	}
+
+	Bus& bus = *sim.bus;
+	Bus& from_bus = *shard.bus;
+	bus.num_busrd += from_bus.num_busrd;
+	bus.num_busrdx += from_bus.num_busrdx;
+	bus.num_flushes += from_bus.num_flushes;
+	bus.num_flush_primes += from_bus.num_flush_primes;
+	bus.num_busupgr += from_bus.num_busupgr;
+	bus.num_setF += from_bus.num_setF;
+	for (size_t b=0; b < bus.banks.size(); b++) {
+		BusBank& bank = bus.banks[b];
+		const BusBank& from_bank = from_bus.banks[b];
+		bank.num_busrd += from_bank.num_busrd;
+		bank.num_busrdx += from_bank.num_busrdx;
+		bank.num_flushes += from_bank.num_flushes;
+		bank.num_flush_primes += from_bank.num_flush_primes;
+		bank.num_busupgr += from_bank.num_busupgr;
+		bank.num_setF += from_bank.num_setF;
+		bank.num_shared += from_bank.num_shared;
+	}
+
+	if (sim.snoop_filter != NULL) {
+		// The shards track disjoint blocks, so their masks are copied over whole
+		SnoopFilter& filter = *sim.snoop_filter;
+		SnoopFilter& from_filter = *shard.snoop_filter;
+		std::unordered_map<unsigned long long, unsigned int>::iterator iter;
+		for (iter = from_filter.entries.begin(); iter != from_filter.entries.end(); ++iter) {
+			const uint64_t* mask = &from_filter.masks[iter->second * from_filter.words];
+			for (int w=0; w < from_filter.words; w++) {
+				uint64_t bits = mask[w];
+				while (bits != 0) {
+					filter.addSharer(iter->first, w * 64 + __builtin_ctzll(bits));
+					bits &= bits - 1;
+				}
+			}
+		}
+		filter.num_lookups += from_filter.num_lookups;
+		filter.num_snoops_sent += from_filter.num_snoops_sent;
+		filter.num_snoops_filtered += from_filter.num_snoops_filtered;
+	}
+
+	sim.num_accesses += shard.num_accesses;
+}
+
+void runSharded(Simulator& sim, const TraceRecord* records, uint64_t num_records, const SimConfig& config) {
+	int num_shards = config.shards;
+	int shard_bits = __builtin_ctz(num_shards);
+	CacheGeometry geometry = sim.caches[0]->geometry;
+
+	// One pass over the trace, split between the threads by chunk
+	size_t num_chunks = (num_records + SHARD_CHUNK_RECORDS - 1) / SHARD_CHUNK_RECORDS;
+	ShardLists lists(num_chunks, std::vector<std::vector<uint32_t> >(num_shards));
+	std::vector<std::thread> workers;
+	for (int s=0; s < num_shards; s++) {
+		workers.push_back(std::thread(partitionChunks, std::ref(lists), records, num_records, std::cref(geometry), s, num_shards));
+	}
+	for (int s=0; s < num_shards; s++) {
+		workers[s].join();
+	}
+
+	// Every shard only has the sets it owns
+	std::vector<Simulator*> shards;
+	for (int s=0; s < num_shards; s++) {
+		shards.push_back(new Simulator(sim.protocol, geometry, config, shard_bits, s));
+	}
+	workers.clear();
+	for (int s=0; s < num_shards; s++) {
+		workers.push_back(std::thread(simulateShard, std::ref(*shards[s]), std::ref(lists), records, s));
+	}
+	for (int s=0; s < num_shards; s++) {
+		workers[s].join();
+	}
+
+	for (int s=0; s < num_shards; s++) {
+		mergeShard(sim, *shards[s], s, num_shards);
+		delete shards[s];
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstdint>
+#include "trace.h"
+#include "config.h"
+#include "simulator.h"
+
+// Most shards a run can be split into
+#define MAX_SHARDS 1024
+
+// Returns the shard that simulates the accesses to the set given
+inline int shardOf(int set, int num_shards) {
+	return set & (num_shards - 1);
+}
+
+// Simulates the records on config.shards threads and leaves sim in the state, with the
+// counters, that simulating them in order on sim would
+// A transaction only touches one block and the victim in its set, so the sets are independent:
+// the records are sorted by shard in one pass, then every shard has its own Simulator, with
+// only the sets of the shard, and simulates the accesses to its sets in trace order
+// The sets, cache counters, bus and bank counters and snoop filter of the shards are then
+// merged into sim, which must not have simulated anything yet
+// Only the components whose state is per set or per block can be sharded (see parseArgs)
+void runSharded(Simulator& sim, const TraceRecord* records, uint64_t num_records, const SimConfig& config);
@@ -0,0 +1,297 @@
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <new>
+#include <cstring>
+#include <climits>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "shmring.h"
+
+// Polls of the ring before going to sleep on its futex
+#define SHM_SPINS 64
+
+// Longest sleep on a futex before checking that the other process is still there
+#define SHM_WAIT_NANOSECONDS 100000000
+
+// The futexes are shared between processes, so the private futex operations cannot be used
+static void futexWait(std::atomic<uint32_t>& word, uint32_t value) {
+	struct timespec timeout = {0, SHM_WAIT_NANOSECONDS};
+	syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAIT, value, &timeout, NULL, 0);
+}
+
+static void futexWake(std::atomic<uint32_t>& word) {
+	syscall(SYS_futex, (uint32_t*) &word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static bool processAlive(int pid) {
+	return kill(pid, 0) == 0 || errno == EPERM;
+}
+
+// Waits until ready() holds, spinning first, then sleeping on futex with sleeping set
+// The side that makes ready() hold checks sleeping after it publishes, and the sleeper
+// checks ready() after it sets sleeping, so one of them always sees the other
+// Returns ready(), which is false only once the process pid is gone
+template <typename Ready>
+static bool waitFor(Ready ready, std::atomic<uint32_t>& futex, std::atomic<uint32_t>& sleeping, int pid) {
+	for (int spins=0; spins < SHM_SPINS; spins++) {
+		if (ready()) {
+			return true;
+		}
+		std::this_thread::yield();
+	}
+	while (true) {
+		uint32_t value = futex.load();
+		sleeping.store(1);
+		if (ready()) {
+			sleeping.store(0);
+			return true;
+		}
+		futexWait(futex, value);
+		sleeping.store(0);
+		if (ready()) {
+			return true;
+		}
+		if (!processAlive(pid)) {
+			return ready();
+		}
+	}
+}
+
+// Name of the ring the consumer waits on, removed if a signal ends the wait
+static char pending_name[NAME_MAX + 1];
+
+static void unlinkOnSignal(int signal_number) {
+	shm_unlink(pending_name);
+	signal(signal_number, SIG_DFL);
+	raise(signal_number);
+}
+
+static double elapsedSeconds(const struct timespec& start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Wakes the other side if it sleeps on futex
+static void wakeSleeper(std::atomic<uint32_t>& futex, std::atomic<uint32_t>& sleeping) {
+	if (sleeping.load() != 0) {
+		futex.fetch_add(1);
+		futexWake(futex);
+	}
+}
+
+ShmConsumer::ShmConsumer() {
+	header = NULL;
+	ring = NULL;
+	length = 0;
+	failed = false;
+}
+
+ShmConsumer::~ShmConsumer() {
+	if (header != NULL) {
+		munmap(header, length);
+	}
+}
+
+bool ShmConsumer::open(const char* _name, unsigned timeout) {
+	name = _name;
+	if (name.size() > NAME_MAX) {
+		std::cout << "Cannot create the shared-memory ring " << name << ": " << strerror(ENAMETOOLONG) << std::endl;
+		return false;
+	}
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0) {
+		std::cout << "Cannot create the shared-memory ring " << name << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	// Until a producer attaches, an interrupted simulator must not leave the name behind
+	strcpy(pending_name, name.c_str());
+	struct sigaction action, old_int, old_term;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = unlinkOnSignal;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, &old_int);
+	sigaction(SIGTERM, &action, &old_term);
+
+	length = sizeof(ShmRingHeader) + (size_t) SHM_RING_RECORDS * sizeof(TraceRecord);
+	void* base = MAP_FAILED;
+	if (ftruncate(fd, length) == 0) {
+		base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	bool attached = false;
+	if (base == MAP_FAILED) {
+		std::cout << "Cannot map the shared-memory ring " << name << ": " << strerror(errno) << std::endl;
+	} else {
+		// The segment starts out zeroed; the magic is written last, once the rest is in place
+		header = new (base) ShmRingHeader();
+		ring = (TraceRecord*) (header + 1);
+		header->version = SHM_RING_VERSION;
+		header->capacity = SHM_RING_RECORDS;
+		header->consumer_pid = getpid();
+		header->magic.store(SHM_RING_MAGIC, std::memory_order_release);
+
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		uint32_t state;
+		while ((state = header->attached.load(std::memory_order_acquire)) != SHM_ATTACHED) {
+			if (timeout != 0 && elapsedSeconds(start) >= timeout) {
+				std::cout << "No producer attached to the shared-memory ring " << name << " in " << timeout << " seconds" << std::endl;
+				break;
+			}
+			futexWait(header->attached, state);
+		}
+		attached = state == SHM_ATTACHED;
+	}
+	shm_unlink(name.c_str());
+	sigaction(SIGINT, &old_int, NULL);
+	sigaction(SIGTERM, &old_term, NULL);
+	return attached;
+}
+
+uint32_t ShmConsumer::protocol() {
+	return header->protocol;
+}
+
+size_t ShmConsumer::next(const TraceRecord*& records, size_t max_records) {
+	if (failed) {
+		return 0;
+	}
+	uint64_t head = header->head.load(std::memory_order_relaxed);
+	bool ready = waitFor([&]() { return header->tail.load() != head || header->closed.load() != 0; },
+		header->data_ready, header->consumer_sleeping, header->producer_pid);
+	if (!ready) {
+		std::cout << "The producer exited without closing the shared-memory ring " << name << std::endl;
+		failed = true;
+		return 0;
+	}
+	uint64_t available = header->tail.load() - head;
+	size_t offset = head & (header->capacity - 1);
+	records = ring + offset;
+	return std::min<uint64_t>(std::min<uint64_t>(available, header->capacity - offset), max_records);
+}
+
+void ShmConsumer::release(size_t count) {
+	header->head.store(header->head.load(std::memory_order_relaxed) + count);
+	wakeSleeper(header->space_ready, header->producer_sleeping);
+}
+
+size_t ShmConsumer::read(TraceRecord* records, size_t max_records) {
+	if (failed) {
+		return 0;
+	}
+	// Only the first piece is waited for
+	size_t count = 0;
+	const TraceRecord* in;
+	size_t n;
+	while (count < max_records && (count == 0 || header->tail.load() != header->head.load())
+		&& (n = next(in, max_records - count)) > 0) {
+		memcpy(records + count, in, n * sizeof(TraceRecord));
+		release(n);
+		// Checked in the copy, which the producer can no longer change
+		for (size_t i=count; i < count + n; i++) {
+			if (!validOp(records[i])) {
+				return i;
+			}
+		}
+		count += n;
+	}
+	return count;
+}
+
+bool ShmConsumer::validOp(const TraceRecord& record) {
+	if (record.op > ProcRequest::ProcWr) {
+		std::cout << "The producer wrote an access that is neither a read nor a write" << std::endl;
+		failed = true;
+		return false;
+	}
+	return true;
+}
+
+bool ShmConsumer::error() {
+	return failed;
+}
+
+ShmProducer::ShmProducer() {
+	header = NULL;
+	ring = NULL;
+	length = 0;
+}
+
+ShmProducer::~ShmProducer() {
+	if (header != NULL) {
+		munmap(header, length);
+	}
+}
+
+bool ShmProducer::open(const char* name, Protocol protocol) {
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0) {
+		std::cout << "No shared-memory ring " << name << ": " << strerror(errno) << std::endl;
+		return false;
+	}
+	struct stat st;
+	void* base = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && (size_t) st.st_size >= sizeof(ShmRingHeader)) {
+		length = st.st_size;
+		base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (base == MAP_FAILED) {
+		std::cout << "Cannot map the shared-memory ring " << name << std::endl;
+		return false;
+	}
+	header = (ShmRingHeader*) base;
+	ring = (TraceRecord*) (header + 1);
+	if (header->magic.load(std::memory_order_acquire) != SHM_RING_MAGIC || header->version != SHM_RING_VERSION || header->capacity == 0
+		|| (header->capacity & (header->capacity - 1)) != 0
+		|| length < sizeof(ShmRingHeader) + (size_t) header->capacity * sizeof(TraceRecord)) {
+		std::cout << name << " is not a version " << SHM_RING_VERSION << " shared-memory ring" << std::endl;
+		return false;
+	}
+	uint32_t expected = SHM_FREE;
+	if (!header->attached.compare_exchange_strong(expected, SHM_CLAIMED)) {
+		std::cout << "The shared-memory ring " << name << " already has a producer" << std::endl;
+		return false;
+	}
+	header->protocol = protocol;
+	header->producer_pid = getpid();
+	header->attached.store(SHM_ATTACHED, std::memory_order_release);
+	futexWake(header->attached);
+	return true;
+}
+
+bool ShmProducer::write(const TraceRecord* records, size_t count) {
+	uint32_t capacity = header->capacity;
+	while (count > 0) {
+		uint64_t tail = header->tail.load(std::memory_order_relaxed);
+		bool room = waitFor([&]() { return tail - header->head.load() < capacity; },
+			header->space_ready, header->producer_sleeping, header->consumer_pid);
+		if (!room) {
+			return false;
+		}
+		size_t offset = tail & (capacity - 1);
+		size_t n = std::min<uint64_t>(std::min<uint64_t>(count, capacity - (tail - header->head.load())), capacity - offset);
+		memcpy(ring + offset, records, n * sizeof(TraceRecord));
+		header->tail.store(tail + n);
+		wakeSleeper(header->data_ready, header->consumer_sleeping);
+		records += n;
+		count -= n;
+	}
+	return true;
+}
+
+void ShmProducer::close() {
+	header->closed.store(1);
+	header->data_ready.fetch_add(1);
+	futexWake(header->data_ready);
+}
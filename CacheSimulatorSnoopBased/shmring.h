@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include "request.h"
+#include "trace.h"
+
+// Shared-memory ring an instrumentation client (the producer) writes accesses into while
+// the simulator (the consumer) simulates them, so that no trace goes through the disk
+// The simulator creates the ring under a POSIX shm name and waits for a producer to attach;
+// the producer gives the protocol, writes the records in batches and closes the ring
+// A full ring holds the producer back and an empty one the consumer: either side spins
+// a little, then sleeps on a futex that the other side bumps once it publishes
+#define SHM_RING_MAGIC 0x474E5246 // "FRNG"
+#define SHM_RING_VERSION 2
+#define SHM_RING_RECORDS (1 << 16) // a power of two
+
+// Seconds the simulator waits for a producer to attach by default; 0 waits forever
+#define DEFAULT_SHM_TIMEOUT 60
+
+// Values of ShmRingHeader::attached
+#define SHM_FREE 0
+#define SHM_CLAIMED 1   // a producer took the ring and is filling in protocol and producer_pid
+#define SHM_ATTACHED 2  // and has, so the consumer can read them
+
+// Start of the segment, followed by the records
+// head and tail count the records read and written, and are never wrapped
+struct ShmRingHeader {
+	// Written last by the consumer, once the rest of the header is in place
+	std::atomic<uint32_t> magic;
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t protocol;
+
+	// Checked by the other side while it sleeps, to find out when a process is gone
+	int32_t consumer_pid;
+	int32_t producer_pid;
+
+	// Set by the producer; attached is claimed with a compare-and-swap, so a second
+	// producer fails, and is also the futex the consumer first sleeps on
+	std::atomic<uint32_t> attached;
+	std::atomic<uint32_t> closed;
+
+	alignas(64) std::atomic<uint64_t> tail;
+	alignas(64) std::atomic<uint64_t> head;
+
+	// Futex words, bumped to wake the side that set its sleeping flag
+	alignas(64) std::atomic<uint32_t> data_ready;
+	std::atomic<uint32_t> consumer_sleeping;
+	alignas(64) std::atomic<uint32_t> space_ready;
+	std::atomic<uint32_t> producer_sleeping;
+};
+
+// The simulator's side of the ring
+class ShmConsumer {
+	public:
+		ShmConsumer();
+		~ShmConsumer();
+
+		// Creates the ring under name (such as "/fesi") and waits for a producer to attach,
+		// for at most timeout seconds (0 waits forever); the name is removed once it has,
+		// or the wait ended, so that it can be used again; SIGINT and SIGTERM remove it too
+		// Returns false (after printing the reason) if the ring cannot be created or no
+		// producer attached in time
+		bool open(const char* name, unsigned timeout);
+
+		// The protocol given by the producer, which may not be a known one
+		uint32_t protocol();
+
+		// Waits for records, and returns how many can be read in place at records (at most
+		// max_records), 0 once the producer closed the ring and all were read or it is gone
+		// The producer can still write to them, so each must be copied before it is checked
+		// with validOp and used
+		size_t next(const TraceRecord*& records, size_t max_records);
+
+		// Hands the first count records returned by next back to the producer
+		void release(size_t count);
+
+		// Copies up to max_records records out of the ring, as a RecordSource
+		// Stops before a record whose op is neither a read nor a write, which is an error
+		size_t read(TraceRecord* records, size_t max_records);
+
+		// Returns true if the op of the record is a read or a write; otherwise prints the
+		// error and fails the ring
+		bool validOp(const TraceRecord& record);
+
+		// True if the producer exited without closing the ring, or wrote a bad record
+		bool error();
+
+	private:
+		std::string name;
+		ShmRingHeader* header;
+		TraceRecord* ring;
+		size_t length;
+		bool failed;
+};
+
+// The instrumentation client's side of the ring
+class ShmProducer {
+	public:
+		ShmProducer();
+		~ShmProducer();
+
+		// Attaches to the ring a simulator created under name, and gives it the protocol
+		// Returns false (after printing the reason) if there is no such ring
+		bool open(const char* name, Protocol protocol);
+
+		// Copies the records into the ring, waiting for room whenever it is full; each
+		// piece that fits is published at once
+		// Returns false if the simulator is gone
+		bool write(const TraceRecord* records, size_t count);
+
+		// Tells the simulator that no more records follow
+		void close();
+
+	private:
+		ShmRingHeader* header;
+		TraceRecord* ring;
+		size_t length;
+};
@@ -0,0 +1,353 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <fstream>
+#include "simulator.h"
+#include "protocol.h"
+
+// Accesses generated at a time; small enough to stay in the L1 of the host
+#define WORKLOAD_BATCH_SIZE 1024
+
+Simulator::Simulator(Protocol _protocol, CacheGeometry geometry, const SimConfig& config)
+	: Simulator(_protocol, geometry, config, 0, 0) {
+}
+
+Simulator::Simulator(Protocol _protocol, CacheGeometry geometry, const SimConfig& config, int shard_bits, int shard) {
+	protocol = _protocol;
+	latency = config.latency;
+	report_latency = config.report_latency;
+	int num_cores = config.cores;
+	for (int i=0; i < num_cores; i++) {
+		caches.push_back(new Cache(i, protocol, geometry, config.replacement, shard_bits, shard));
+	}
+
+	bus = new Bus(caches, config.bus_banks);
+	snoop_filter = NULL;
+	if (config.snoop_filter) {
+		snoop_filter = new SnoopFilter(num_cores);
+		bus->setSnoopFilter(snoop_filter);
+	}
+	for (int i=0; i < num_cores; i++) {
+		caches[i]->setBus(bus);
+	}
+	llc = NULL;
+	if (config.llc.enabled) {
+		llc = new LLC(config.llc, geometry.blockSize(), bus);
+		bus->llc = llc;
+	}
+	directory = NULL;
+	if (config.directory) {
+		directory = new Directory(caches, &bus->outcome);
+		for (int i=0; i < num_cores; i++) {
+			caches[i]->setDirectory(directory);
+		}
+	}
+	if (config.l1_ways > 0) {
+		CacheGeometry l1_geometry(config.l1_set_bits, config.l1_ways, geometry.offset_bits);
+		for (int i=0; i < num_cores; i++) {
+			caches[i]->setL1(new L1Cache(protocol, l1_geometry));
+		}
+	}
+	if (config.prefetch.policy != PrefetchPolicy::NoPrefetch) {
+		for (int i=0; i < num_cores; i++) {
+			caches[i]->prefetcher = new Prefetcher(config.prefetch);
+		}
+		owner_states.resize(num_cores);
+	}
+	profiler = NULL;
+	if (config.profile.enabled) {
+		profiler = new SharingProfiler(config.profile, geometry, num_cores);
+	}
+
+	stats_config = config.stats;
+	num_accesses = 0;
+	next_snapshot = stats_config.interval;
+	registerStats();
+}
+
+Simulator::~Simulator() {
+	for (int i=0; i < numCores(); i++) {
+		delete caches[i]->l1;
+		delete caches[i]->prefetcher;
+		delete caches[i];
+	}
+	delete bus;
+	delete snoop_filter;
+	delete llc;
+	delete directory;
+	delete profiler;
+}
+
+void Simulator::registerStats() {
+	for (int i=0; i < numCores(); i++) {
+		caches[i]->registerStats(stats);
+	}
+	if (directory != NULL) {
+		directory->registerStats(stats);
+	} else {
+		bus->registerStats(stats);
+	}
+	if (snoop_filter != NULL) {
+		snoop_filter->registerStats(stats);
+	}
+	if (llc != NULL) {
+		llc->registerStats(stats);
+	}
+
+	static const char* names[] = {"reads", "read_misses", "writes", "write_misses", "invalidations",
+		"writebacks", "provided", "from_llc", "random"};
+	for (int stat=CacheStats::Reads; stat <= CacheStats::Random; stat++) {
+		stats.add("total", names[stat], [this, stat]() { return totalStats((CacheStats) stat); });
+	}
+	stats.add("total", "cycles", [this]() { return totalCycles(); });
+}
+
+void Simulator::takeSnapshot() {
+	stats.snapshot(num_accesses);
+	next_snapshot += stats_config.interval;
+}
+
+void Simulator::resumeAfter(unsigned long long accesses) {
+	num_accesses = accesses;
+	if (stats_config.interval != 0) {
+		next_snapshot = (accesses / stats_config.interval + 1) * stats_config.interval;
+	}
+}
+
+int Simulator::numCores() {
+	return caches.size();
+}
+
+void Simulator::prefetch(int core, unsigned long long address) {
+	Cache& cache = *caches[core];
+	Prefetcher& prefetcher = *cache.prefetcher;
+	AccessOutcome demand = bus->outcome;
+	unsigned long long block_address = cache.geometry.blockAddressOf(address);
+
+	// The access was charged already; it started when the block of a late prefetch was still on its way
+	bool prefetched;
+	cache.num_cycles += prefetcher.demand(block_address, cache.num_cycles - latency.cost(demand), prefetched);
+	prefetcher.train(block_address, !demand.hit || prefetched);
+
+	for (size_t p=0; p < prefetcher.candidates.size(); p++) {
+		unsigned long long candidate = prefetcher.candidates[p];
+		if (cache.getState(candidate) != CacheBlockState::Invalid) {
+			continue;
+		}
+		// The other cores that hold the block in M, E or F, which the BusRd may take it from
+		for (int i=0; i < numCores(); i++) {
+			CacheBlockState state = caches[i]->getState(candidate);
+			owner_states[i] = (i != core && (state == CacheBlockState::Modified || state == CacheBlockState::Exclusive
+				|| state == CacheBlockState::Forward)) ? state : CacheBlockState::Invalid;
+		}
+		cache.handlePrefetch(candidate);
+		prefetcher.issued(candidate, cache.num_cycles + latency.cost(bus->outcome));
+		for (int i=0; i < numCores(); i++) {
+			if (owner_states[i] != CacheBlockState::Invalid && caches[i]->getState(candidate) != owner_states[i]) {
+				prefetcher.num_ownership_taken++;
+				break;
+			}
+		}
+	}
+	bus->outcome = demand;
+}
+
+void Simulator::runWorkload(WorkloadGenerator& generator) {
+	std::vector<TraceRecord> batch(WORKLOAD_BATCH_SIZE);
+	size_t count;
+	while ((count = generator.fill(batch.data(), batch.size())) > 0) {
+		for (size_t i=0; i < count; i++) {
+			access(batch[i].core, (ProcRequest) batch[i].op, batch[i].address);
+		}
+	}
+}
+
+unsigned long long Simulator::totalStats(CacheStats stat) {
+	unsigned long long total = 0;
+	for (int i=0; i < numCores(); i++) {
+		total += caches[i]->returnStats(stat);
+	}
+	return total;
+}
+
+unsigned long long Simulator::totalCycles() {
+	unsigned long long total = 0;
+	for (int i=0; i < numCores(); i++) {
+		total += caches[i]->num_cycles;
+	}
+	return total;
+}
+
+void Simulator::printLatency() {
+	std::cout << std::dec << std::fixed << std::setprecision(2);
+	std::cout << ">>>> Latency of " << protocolName(protocol) << " (cycles per hit " << latency.hit
+		<< ", cache-to-cache " << latency.cache_to_cache << ", LLC " << latency.llc << ", DRAM " << latency.dram
+		<< ", writeback " << latency.writeback << ", invalidation " << latency.invalidation;
+	if (caches[0]->l1 != NULL) {
+		std::cout << ", L2 " << latency.l2;
+	}
+	std::cout << ")\n";
+	unsigned long long total_accesses = 0;
+	for (int i=0; i < numCores(); i++) {
+		unsigned long long accesses = caches[i]->numAccesses();
+		total_accesses += accesses;
+		std::cout << "Core " << std::setw(5) << std::left << i << std::right << ": " << std::setw(14) << caches[i]->num_cycles
+			<< " cycles, average " << (accesses ? (double) caches[i]->num_cycles / accesses : 0.0) << '\n';
+	}
+	unsigned long long cycles = totalCycles();
+	std::cout << "Total     : " << std::setw(14) << cycles
+		<< " cycles, average " << (total_accesses ? (double) cycles / total_accesses : 0.0) << '\n';
+}
+
+void Simulator::printHierarchy() {
+	unsigned long long l1_accesses = 0, l1_misses = 0, back_invalidations = 0, downgrades = 0, snoops = 0, forwarded = 0;
+	for (int i=0; i < numCores(); i++) {
+		const L1Cache& l1 = *caches[i]->l1;
+		l1_accesses += l1.num_reads + l1.num_writes;
+		l1_misses += l1.num_read_misses + l1.num_write_misses + l1.num_upgrades;
+		back_invalidations += l1.num_back_invalidations;
+		downgrades += l1.num_downgrades;
+		snoops += l1.num_snoops;
+		forwarded += l1.num_snoops_forwarded;
+	}
+	unsigned long long l2_accesses = totalStats(CacheStats::Reads) + totalStats(CacheStats::Writes);
+	unsigned long long l2_hits = l2_accesses - totalStats(CacheStats::Read_misses) - totalStats(CacheStats::Write_misses);
+	const CacheGeometry& l1 = caches[0]->l1->geometry;
+	const CacheGeometry& l2 = caches[0]->geometry;
+	std::cout << std::dec << std::fixed << std::setprecision(2);
+	std::cout << ">> L1/L2 hierarchy (L1 of " << l1.numSets() << " sets x " << l1.associativity << " ways, L2 of "
+		<< l2.numSets() << " sets x " << l2.associativity << " ways)\n";
+	std::cout << "L1 accesses        : " << l1_accesses << '\n';
+	std::cout << "L1 hits            : " << l1_accesses - l1_misses << " ("
+		<< (l1_accesses ? 100.0 * (l1_accesses - l1_misses) / l1_accesses : 0.0) << "%)\n";
+	std::cout << "L2 accesses        : " << l2_accesses << " (L1 misses and upgrades)\n";
+	std::cout << "L2 hits            : " << l2_hits << " (" << (l2_accesses ? 100.0 * l2_hits / l2_accesses : 0.0) << "%)\n";
+	std::cout << "Back-invalidations : " << back_invalidations << '\n';
+	std::cout << "Downgrades         : " << downgrades << '\n';
+	std::cout << "Snoops at the L2s  : " << snoops << '\n';
+	std::cout << "Snoops to the L1s  : " << forwarded << " (" << (snoops ? 100.0 * (snoops - forwarded) / snoops : 0.0)
+		<< "% kept from the L1s)\n";
+}
+
+void Simulator::printPrefetching() {
+	unsigned long long issued = 0, useful = 0, late = 0, useless = 0, invalidated = 0, ownership_taken = 0;
+	for (int i=0; i < numCores(); i++) {
+		const Prefetcher& prefetcher = *caches[i]->prefetcher;
+		issued += prefetcher.num_issued;
+		useful += prefetcher.num_useful;
+		late += prefetcher.num_late;
+		useless += prefetcher.num_useless;
+		invalidated += prefetcher.num_invalidated;
+		ownership_taken += prefetcher.num_ownership_taken;
+	}
+	unsigned long long used = useful + late;
+	unsigned long long misses = totalStats(CacheStats::Read_misses) + totalStats(CacheStats::Write_misses);
+	const PrefetchConfig& config = caches[0]->prefetcher->config;
+	std::cout << std::dec << std::fixed << std::setprecision(2);
+	std::cout << ">> Prefetching of " << protocolName(protocol) << " (" << prefetchPolicyName(config.policy) << ", degree " << config.degree;
+	if (config.policy == PrefetchPolicy::StreamPrefetch) {
+		std::cout << ", distance " << config.distance;
+	}
+	std::cout << ")\n";
+	std::cout << "Issued             : " << issued << '\n';
+	std::cout << "Useful             : " << useful << '\n';
+	std::cout << "Late               : " << late << '\n';
+	std::cout << "Useless            : " << useless << '\n';
+	std::cout << "Accuracy           : " << (issued ? 100.0 * used / issued : 0.0) << "% (useful or late)\n";
+	std::cout << "Coverage           : " << (used + misses ? 100.0 * used / (used + misses) : 0.0) << "% (of the misses without prefetching)\n";
+	std::cout << "Invalidated unused : " << invalidated << " (invalidations a write had to make for them)\n";
+	std::cout << "Took ownership     : " << ownership_taken << " (from another core's M, E or F)\n";
+}
+
+bool Simulator::printStats() {
+	if (stats_config.format != TextStats) {
+		std::ofstream file;
+		if (!stats_config.path.empty()) {
+			file.open(stats_config.path.c_str());
+			if (!file) {
+				std::cout << "Cannot open " << stats_config.path << std::endl;
+				return false;
+			}
+		}
+		std::ostream& out = stats_config.path.empty() ? std::cout : file;
+		if (stats_config.format == JSONStats) {
+			stats.writeJSON(out, protocolName(protocol), num_accesses);
+		} else {
+			stats.writeCSV(out, num_accesses);
+		}
+		out.flush();
+		if (!out) {
+			std::cout << "Cannot write " << stats_config.path << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Print the statistics and contents of cache
+	for (int i=0; i < numCores(); i++) {
+		caches[i]->printStats(stats_config.block_dump);
+	}
+	std::cout << "---- \n";
+	if (directory != NULL) {
+		directory->printStats();
+	} else {
+		bus->printStats();
+	}
+
+	// Print the total cache statistics
+	std::cout << "---- \n";
+	std::cout << ">>>> Total Cache Stats "<< '\n';
+	std::cout << "Reads         : " << totalStats(CacheStats::Reads) << '\n';
+	std::cout << "Read misses   : " << totalStats(CacheStats::Read_misses) << '\n';
+	std::cout << "Writes        : " << totalStats(CacheStats::Writes) << '\n';
+	std::cout << "Write misses  : " << totalStats(CacheStats::Write_misses) << '\n';
+	std::cout << "Writebacks    : " << totalStats(CacheStats::Writebacks) << '\n';
+	std::cout << "Invalidations : " << totalStats(CacheStats::Invalidations) << '\n';
+	std::cout << "Provided      : " << totalStats(CacheStats::Provided) << '\n';
+	std::cout << "From LLC      : " << totalStats(CacheStats::FromLLC) << '\n';
+	std::cout << "Random        : " << totalStats(CacheStats::Random) << '\n';
+
+	if (caches[0]->l1 != NULL) {
+		std::cout << "---- \n";
+		printHierarchy();
+	}
+
+	if (caches[0]->prefetcher != NULL) {
+		std::cout << "---- \n";
+		printPrefetching();
+	}
+
+	if (snoop_filter != NULL) {
+		std::cout << "---- \n";
+		snoop_filter->printStats();
+	}
+
+	if (bus->banks.size() > 1) {
+		std::cout << "---- \n";
+		bus->printBankStats();
+	}
+
+	if (llc != NULL) {
+		std::cout << "---- \n";
+		llc->printStats();
+	}
+
+	if (report_latency) {
+		std::cout << "---- \n";
+		printLatency();
+	}
+
+	if (profiler != NULL) {
+		std::cout << "---- \n";
+		profiler->printReport();
+	}
+
+	if (stats_config.interval != 0) {
+		std::cout << "---- \n";
+		std::vector<std::string> groups;
+		groups.push_back("total");
+		groups.push_back("bus");
+		stats.writeIntervals(std::cout, groups, num_accesses);
+	}
+	return true;
+}
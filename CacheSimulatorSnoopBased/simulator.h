@@ -0,0 +1,118 @@
+#pragma once
+#include <vector>
+#include "request.h"
+#include "geometry.h"
+#include "cache.h"
+#include "bus.h"
+#include "config.h"
+#include "snoopfilter.h"
+#include "workload.h"
+#include "latency.h"
+#include "profiler.h"
+#include "stats.h"
+#include "directory.h"
+#include "l1cache.h"
+#include "prefetcher.h"
+
+// One complete system: a Cache per core and the Bus connecting them
+// Simulators share no state, so independent configurations can run on separate threads
+class Simulator {
+	public:
+		Protocol protocol;
+		std::vector<Cache*> caches;
+		Bus* bus;
+		SnoopFilter* snoop_filter;
+		LLC* llc;
+
+		// Directory backend of FESI; when set, the Bus carries no messages
+		Directory* directory;
+
+		// Optional sharing profiler, fed every access
+		SharingProfiler* profiler;
+
+		// Counters of every component, how printStats writes them, and the snapshots
+		// taken every stats_config.interval accesses
+		StatsRegistry stats;
+		StatsConfig stats_config;
+		unsigned long long num_accesses, next_snapshot;
+
+		// Cycles charged to each access, and whether printStats reports them
+		LatencyModel latency;
+		bool report_latency;
+
+		// The state each other core held the block of a prefetch in, if it owned it (see prefetch)
+		std::vector<CacheBlockState> owner_states;
+
+		// Builds config.cores caches of the geometry given, and the options of config
+		Simulator(Protocol _protocol, CacheGeometry geometry, const SimConfig& config);
+
+		// Same, with caches that only hold the sets of the shard given (see Cache::shard_bits)
+		Simulator(Protocol _protocol, CacheGeometry geometry, const SimConfig& config, int shard_bits, int shard);
+		~Simulator();
+
+		// Returns the number of cores
+		int numCores();
+
+		// Sends the processor request of the core given to its cache, and charges the
+		// core the latency of what the request did
+		void access(int core, ProcRequest request, unsigned long long address) {
+			caches[core]->handleProcRequest(request, address);
+			caches[core]->num_cycles += latency.cost(bus->outcome);
+			if (profiler != NULL) {
+				profiler->record(core, request, address, bus->outcome);
+			}
+			if (caches[core]->prefetcher != NULL) {
+				prefetch(core, address);
+			}
+			if (++num_accesses == next_snapshot) {
+				takeSnapshot();
+			}
+		}
+
+		// Settles the prefetch of the block the core just accessed, trains the prefetcher of
+		// the core on the access and issues the prefetches it picks; bus->outcome is kept
+		// The prefetches are off the critical path: the core is only charged the rest of a late one
+		void prefetch(int core, unsigned long long address);
+
+		// Only updates the cache state for the access: functional warming, many times
+		// faster than access, with no counters or cycles charged
+		void warm(int core, ProcRequest request, unsigned long long address) {
+			caches[core]->handleWarmProcRequest(request, address);
+		}
+
+		// Simulates every access of a generated workload, a batch at a time
+		void runWorkload(WorkloadGenerator& generator);
+
+		// Returns the requested cache statistic summed over all caches
+		unsigned long long totalStats(CacheStats stat);
+
+		// Returns the cycles of all accesses, under the latency model
+		unsigned long long totalCycles();
+
+		// Prints the total and average latency per core and over all cores
+		void printLatency();
+
+		// Prints the hit rates of both levels of the L1/L2 hierarchy, over all cores, and how
+		// many of the snoops the L2s kept from the L1s
+		void printHierarchy();
+
+		// Prints the prefetches over all cores: how many were useful, late and useless, and
+		// what they cost the other cores
+		void printPrefetching();
+
+		// Registers the counters of every component, and their totals, in stats
+		void registerStats();
+
+		// Records the counters in stats, and schedules the next snapshot
+		void takeSnapshot();
+
+		// Numbers the accesses to come after the first accesses of the trace, simulated by
+		// an earlier run (see Checkpoint::restore); the next snapshot is the first interval after them
+		void resumeAfter(unsigned long long accesses);
+
+		// Prints the statistics and contents of every cache, the bus stats and the totals,
+		// followed by the stats and reports of the optional components
+		// With a JSON or CSV format, writes the registered counters instead, to stdout or the stats file
+		// Returns false (after printing the reason) if the stats file cannot be written
+		bool printStats();
+};
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <iomanip>
+#include "snoopfilter.h"
+#include "stats.h"
+
+SnoopFilter::SnoopFilter(int num_cores) {
+	words = (num_cores + 63) / 64;
+	num_lookups = 0;
+	num_snoops_sent = 0;
+	num_snoops_filtered = 0;
+}
+
+void SnoopFilter::addSharer(unsigned long long block_address, int cache_id) {
+	std::unordered_map<unsigned long long, unsigned int>::iterator iter = entries.find(block_address);
+	unsigned int slot;
+	if (iter != entries.end()) {
+		slot = iter->second;
+	} else {
+		// Reuse the mask of a block that dropped out of every cache
+		if (!free_slots.empty()) {
+			slot = free_slots.back();
+			free_slots.pop_back();
+		} else {
+			slot = masks.size() / words;
+			masks.resize(masks.size() + words);
+		}
+		for (int w=0; w < words; w++) {
+			masks[slot * words + w] = 0;
+		}
+		entries[block_address] = slot;
+	}
+	masks[slot * words + cache_id / 64] |= 1ULL << (cache_id % 64);
+}
+
+void SnoopFilter::removeSharer(unsigned long long block_address, int cache_id) {
+	std::unordered_map<unsigned long long, unsigned int>::iterator iter = entries.find(block_address);
+	if (iter == entries.end()) {
+		return;
+	}
+	unsigned int slot = iter->second;
+	uint64_t* mask = &masks[slot * words];
+	mask[cache_id / 64] &= ~(1ULL << (cache_id % 64));
+	for (int w=0; w < words; w++) {
+		if (mask[w] != 0) {
+			return;
+		}
+	}
+	entries.erase(iter);
+	free_slots.push_back(slot);
+}
+
+bool SnoopFilter::getSharers(unsigned long long block_address, uint64_t* sharers) {
+	num_lookups++;
+	std::unordered_map<unsigned long long, unsigned int>::iterator iter = entries.find(block_address);
+	if (iter == entries.end()) {
+		return false;
+	}
+	const uint64_t* mask = &masks[iter->second * words];
+	for (int w=0; w < words; w++) {
+		sharers[w] = mask[w];
+	}
+	return true;
+}
+
+void SnoopFilter::printStats() {
+	unsigned long long total = num_snoops_sent + num_snoops_filtered;
+	std::cout << std::dec;
+	std::cout << ">> Snoop filter stats\n";
+	std::cout << "Lookups           : " << num_lookups << '\n';
+	std::cout << "Tracked blocks    : " << entries.size() << '\n';
+	std::cout << "Snoops sent       : " << num_snoops_sent << '\n';
+	std::cout << "Snoops filtered   : " << num_snoops_filtered << '\n';
+	std::cout << "Filter hit rate   : " << std::fixed << std::setprecision(2)
+		<< (total ? 100.0 * num_snoops_filtered / total : 0.0) << "%\n";
+}
+
+void SnoopFilter::registerStats(StatsRegistry& stats) {
+	stats.add("snoop_filter", "lookups", &num_lookups);
+	stats.add("snoop_filter", "tracked_blocks", [this]() -> unsigned long long { return entries.size(); });
+	stats.add("snoop_filter", "snoops_sent", &num_snoops_sent);
+	stats.add("snoop_filter", "snoops_filtered", &num_snoops_filtered);
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+class StatsRegistry;
+
+// Inclusive snoop filter: tracks which caches hold each block so the Bus only
+// snoops those caches. Every valid block in every cache has its cache's bit set
+// in the sharer mask of its block address; blocks nobody holds have no entry.
+class SnoopFilter {
+	public:
+		// 64-bit words per sharer mask
+		int words;
+
+		// Block address -> slot of its sharer mask in masks
+		std::unordered_map<unsigned long long, unsigned int> entries;
+		std::vector<uint64_t> masks;
+		std::vector<unsigned int> free_slots;
+
+		// Counters
+		unsigned long long num_lookups, num_snoops_sent, num_snoops_filtered;
+
+		SnoopFilter(int num_cores);
+
+		// Records that the cache given now holds the block
+		void addSharer(unsigned long long block_address, int cache_id);
+
+		// Records that the cache given no longer holds the block
+		void removeSharer(unsigned long long block_address, int cache_id);
+
+		// Copies the sharer mask of the block into sharers (words long)
+		// Returns false, leaving sharers untouched, if no cache holds the block
+		bool getSharers(unsigned long long block_address, uint64_t* sharers);
+
+		// Prints the counts and the fraction of snoops the filter saved
+		void printStats();
+
+		// Registers the counters under "snoop_filter"
+		void registerStats(StatsRegistry& stats);
+};
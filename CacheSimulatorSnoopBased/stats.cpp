@@ -0,0 +1,136 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "stats.h"
+
+bool statsFormatFromName(const std::string& name, StatsFormat& format) {
+	if (name == "text") {
+		format = TextStats;
+	} else if (name == "json") {
+		format = JSONStats;
+	} else if (name == "csv") {
+		format = CSVStats;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+StatsConfig::StatsConfig() {
+	format = TextStats;
+	interval = 0;
+	block_dump = true;
+}
+
+void StatsRegistry::add(const std::string& group, const std::string& name, const unsigned long long* value) {
+	Counter counter;
+	counter.group = group;
+	counter.name = name;
+	counter.value = value;
+	counters.push_back(counter);
+}
+
+void StatsRegistry::add(const std::string& group, const std::string& name, std::function<unsigned long long()> compute) {
+	Counter counter;
+	counter.group = group;
+	counter.name = name;
+	counter.value = NULL;
+	counter.compute = compute;
+	counters.push_back(counter);
+}
+
+void StatsRegistry::snapshot(unsigned long long accesses) {
+	Snapshot snapshot;
+	snapshot.accesses = accesses;
+	snapshot.values.reserve(counters.size());
+	for (size_t i=0; i < counters.size(); i++) {
+		snapshot.values.push_back(counters[i].read());
+	}
+	snapshots.push_back(snapshot);
+}
+
+std::vector<StatsRegistry::Snapshot> StatsRegistry::allSnapshots(unsigned long long accesses) {
+	std::vector<Snapshot> all = snapshots;
+	// A run that ends on an interval boundary already has its last snapshot
+	if (all.empty() || all.back().accesses != accesses) {
+		snapshot(accesses);
+		all.push_back(snapshots.back());
+		snapshots.pop_back();
+	}
+	return all;
+}
+
+void StatsRegistry::writeJSONGroups(std::ostream& out, const Snapshot& snapshot, const char* indent) {
+	for (size_t i=0; i < counters.size(); i++) {
+		bool first = i == 0 || counters[i].group != counters[i - 1].group;
+		bool last = i + 1 == counters.size() || counters[i].group != counters[i + 1].group;
+		if (first) {
+			out << indent << "\"" << counters[i].group << "\": {";
+		}
+		out << "\"" << counters[i].name << "\": " << snapshot.values[i] << (last ? "" : ", ");
+		if (last) {
+			out << "}" << (i + 1 == counters.size() ? "\n" : ",\n");
+		}
+	}
+}
+
+void StatsRegistry::writeJSON(std::ostream& out, const char* protocol, unsigned long long accesses) {
+	std::vector<Snapshot> all = allSnapshots(accesses);
+	out << std::dec;
+	out << "{\n";
+	out << "  \"protocol\": \"" << protocol << "\",\n";
+	out << "  \"intervals\": [";
+	for (size_t s=0; s + 1 < all.size(); s++) {
+		out << (s == 0 ? "\n" : ",\n");
+		out << "    {\"accesses\": " << all[s].accesses << ", \"stats\": {\n";
+		writeJSONGroups(out, all[s], "      ");
+		out << "    }}";
+	}
+	out << (all.size() > 1 ? "\n  ],\n" : "],\n");
+	out << "  \"accesses\": " << all.back().accesses << ",\n";
+	out << "  \"stats\": {\n";
+	writeJSONGroups(out, all.back(), "    ");
+	out << "  }\n";
+	out << "}\n";
+}
+
+void StatsRegistry::writeCSV(std::ostream& out, unsigned long long accesses) {
+	std::vector<Snapshot> all = allSnapshots(accesses);
+	out << std::dec;
+	out << "accesses,group,counter,value\n";
+	for (size_t s=0; s < all.size(); s++) {
+		for (size_t i=0; i < counters.size(); i++) {
+			out << all[s].accesses << "," << counters[i].group << "," << counters[i].name << "," << all[s].values[i] << "\n";
+		}
+	}
+}
+
+void StatsRegistry::writeIntervals(std::ostream& out, const std::vector<std::string>& groups, unsigned long long accesses) {
+	std::vector<Snapshot> all = allSnapshots(accesses);
+	std::vector<size_t> columns;
+	std::vector<std::string> headings;
+	for (size_t g=0; g < groups.size(); g++) {
+		for (size_t i=0; i < counters.size(); i++) {
+			if (counters[i].group == groups[g]) {
+				columns.push_back(i);
+				headings.push_back(g == 0 ? counters[i].name : counters[i].group + "." + counters[i].name);
+			}
+		}
+	}
+
+	out << std::dec;
+	out << ">> Interval stats (counts over each interval)\n";
+	out << std::setw(14) << "Accesses";
+	for (size_t c=0; c < columns.size(); c++) {
+		out << std::setw(std::max<size_t>(14, headings[c].size() + 2)) << headings[c];
+	}
+	out << "\n";
+	for (size_t s=0; s < all.size(); s++) {
+		out << std::setw(14) << all[s].accesses;
+		for (size_t c=0; c < columns.size(); c++) {
+			unsigned long long before = s > 0 ? all[s - 1].values[columns[c]] : 0;
+			out << std::setw(std::max<size_t>(14, headings[c].size() + 2)) << all[s].values[columns[c]] - before;
+		}
+		out << "\n";
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <ostream>
+#include <functional>
+#include <cstdint>
+
+// How the stats are written at the end of a run
+typedef enum {
+	TextStats, // the printStats report
+	JSONStats,
+	CSVStats   // one "accesses,group,counter,value" row per counter and snapshot
+} StatsFormat;
+
+// Returns the format called name: text, json or csv
+bool statsFormatFromName(const std::string& name, StatsFormat& format);
+
+// Output options of the stats, chosen on the command line
+class StatsConfig {
+	public:
+		StatsFormat format;
+
+		// File the JSON or CSV stats go to; empty for stdout
+		std::string path;
+
+		// Accesses between interval snapshots; 0 for none
+		uint64_t interval;
+
+		// Whether the text report lists the blocks of every set
+		bool block_dump;
+
+		StatsConfig();
+};
+
+// Every counter of the components of a Simulator, under a group ("core3", "bus", ...)
+// and a name, in the order registered; groups are registered in one piece
+// Counters are read only when a snapshot is taken or the stats are written
+class StatsRegistry {
+	public:
+		// Registers a counter kept by a component
+		void add(const std::string& group, const std::string& name, const unsigned long long* value);
+
+		// Registers a counter derived from others, such as a total
+		void add(const std::string& group, const std::string& name, std::function<unsigned long long()> compute);
+
+		// Records the value of every counter, accesses into the run
+		void snapshot(unsigned long long accesses);
+
+		// Writes the snapshots, then the current values as the stats after accesses
+		void writeJSON(std::ostream& out, const char* protocol, unsigned long long accesses);
+		void writeCSV(std::ostream& out, unsigned long long accesses);
+
+		// Writes a table of the snapshots, a row per interval with the counters of the
+		// groups given counted over that interval, ending with the current values
+		// The counters of the first group are headed by their name alone
+		void writeIntervals(std::ostream& out, const std::vector<std::string>& groups, unsigned long long accesses);
+
+	private:
+		class Counter {
+			public:
+				std::string group;
+				std::string name;
+				const unsigned long long* value;
+				std::function<unsigned long long()> compute;
+
+				unsigned long long read() const { return value != NULL ? *value : compute(); }
+		};
+
+		class Snapshot {
+			public:
+				unsigned long long accesses;
+				std::vector<unsigned long long> values;
+		};
+
+		std::vector<Counter> counters;
+		std::vector<Snapshot> snapshots;
+
+		// Returns the snapshots followed by the current values
+		std::vector<Snapshot> allSnapshots(unsigned long long accesses);
+
+		void writeJSONGroups(std::ostream& out, const Snapshot& snapshot, const char* indent);
+};
@@ -0,0 +1,156 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "sweep.h"
+#include "protocol.h"
+#include "simulator.h"
+
+// Counters collected from one point
+class SweepResult {
+	public:
+		unsigned long long cache_stats[CacheStats::Random + 1];
+		unsigned long long num_busrd, num_busrdx, num_busupgr, num_flushes, num_flush_primes, num_setF;
+		unsigned long long cycles, dram_reads, dram_writebacks;
+		double seconds;
+
+		// Accesses of the cores, which the cycles are averaged over
+		unsigned long long accesses;
+
+		// Prefetches over all cores (see Prefetcher), when there is a prefetcher
+		unsigned long long prefetch_issued, prefetch_useful, prefetch_late, prefetch_useless, prefetch_invalidated, prefetch_ownership_taken;
+};
+
+SweepPoint::SweepPoint(Protocol _protocol, CacheGeometry _geometry) {
+	protocol = _protocol;
+	geometry = _geometry;
+}
+
+// The accesses come from the workload if there is one, from records otherwise
+static void simulatePoint(const TraceRecord* records, uint64_t num_records, const WorkloadSpec* workload, const SweepPoint& point, const SimConfig& config, SweepResult& result) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	Simulator sim(point.protocol, point.geometry, config);
+	if (workload == NULL) {
+		for (uint64_t i=0; i < num_records; i++) {
+			sim.access(records[i].core, (ProcRequest) records[i].op, records[i].address);
+		}
+	} else {
+		WorkloadSpec spec = *workload;
+		spec.cores = config.cores;
+		spec.block_size = point.geometry.blockSize();
+		WorkloadGenerator generator(spec);
+		sim.runWorkload(generator);
+	}
+
+	for (int stat=0; stat <= CacheStats::Random; stat++) {
+		result.cache_stats[stat] = sim.totalStats((CacheStats) stat);
+	}
+	result.num_busrd = sim.bus->num_busrd;
+	result.num_busrdx = sim.bus->num_busrdx;
+	result.num_busupgr = sim.bus->num_busupgr;
+	result.num_flushes = sim.bus->num_flushes;
+	result.num_flush_primes = sim.bus->num_flush_primes;
+	result.num_setF = sim.bus->num_setF;
+	result.cycles = sim.totalCycles();
+	result.accesses = 0;
+	for (int i=0; i < sim.numCores(); i++) {
+		result.accesses += sim.caches[i]->numAccesses();
+	}
+	result.dram_reads = 0;
+	result.dram_writebacks = 0;
+	for (size_t i=0; sim.llc != NULL && i < sim.llc->banks.size(); i++) {
+		result.dram_reads += sim.llc->banks[i]->num_dram_reads;
+		result.dram_writebacks += sim.llc->banks[i]->num_dram_writebacks;
+	}
+	result.prefetch_issued = 0;
+	result.prefetch_useful = 0;
+	result.prefetch_late = 0;
+	result.prefetch_useless = 0;
+	result.prefetch_invalidated = 0;
+	result.prefetch_ownership_taken = 0;
+	for (int i=0; i < sim.numCores() && sim.caches[i]->prefetcher != NULL; i++) {
+		const Prefetcher& prefetcher = *sim.caches[i]->prefetcher;
+		result.prefetch_issued += prefetcher.num_issued;
+		result.prefetch_useful += prefetcher.num_useful;
+		result.prefetch_late += prefetcher.num_late;
+		result.prefetch_useless += prefetcher.num_useless;
+		result.prefetch_invalidated += prefetcher.num_invalidated;
+		result.prefetch_ownership_taken += prefetcher.num_ownership_taken;
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void runPoints(const TraceRecord* records, uint64_t num_records, const WorkloadSpec* workload, const std::vector<SweepPoint>& points, const SimConfig& config) {
+	std::vector<SweepResult> results(points.size());
+
+	// Workers pull the next point off a shared counter; each one writes only its own results
+	std::atomic<size_t> next_point(0);
+	std::vector<std::thread> workers;
+	for (int t=0; t < config.threads; t++) {
+		workers.push_back(std::thread([&]() {
+			size_t i;
+			while ((i = next_point++) < points.size()) {
+				simulatePoint(records, num_records, workload, points[i], config, results[i]);
+			}
+		}));
+	}
+	for (size_t t=0; t < workers.size(); t++) {
+		workers[t].join();
+	}
+
+	const char* columns[] = {"Protocol", "Sets", "Ways", "Block",
+		"Reads", "ReadMiss", "Writes", "WriteMiss", "Invalid", "Writeback", "Provided", "FromLLC", "Random",
+		"BusRd", "BusRdX", "BusUpgr", "Flush", "FlushPrime", "setF", "DRAMRead", "DRAMWrite", "Cycles", "AvgLatency", "Seconds"};
+	const char* prefetch_columns[] = {"Prefetch", "PfUseful", "PfLate", "PfUseless", "PfInval", "PfOwner"};
+	bool prefetching = config.prefetch.policy != PrefetchPolicy::NoPrefetch;
+	for (size_t c=0; c < sizeof(columns) / sizeof(columns[0]); c++) {
+		std::cout << std::setw(c == 0 ? 8 : 11) << columns[c];
+	}
+	for (size_t c=0; prefetching && c < sizeof(prefetch_columns) / sizeof(prefetch_columns[0]); c++) {
+		std::cout << std::setw(11) << prefetch_columns[c];
+	}
+	std::cout << "\n";
+	for (size_t i=0; i < points.size(); i++) {
+		const SweepPoint& point = points[i];
+		const SweepResult& result = results[i];
+		std::cout << std::setw(8) << protocolName(point.protocol)
+			<< std::setw(11) << point.geometry.numSets()
+			<< std::setw(11) << point.geometry.associativity
+			<< std::setw(11) << point.geometry.blockSize();
+		for (int stat=0; stat <= CacheStats::Random; stat++) {
+			std::cout << std::setw(11) << result.cache_stats[stat];
+		}
+		std::cout << std::setw(11) << result.num_busrd
+			<< std::setw(11) << result.num_busrdx
+			<< std::setw(11) << result.num_busupgr
+			<< std::setw(11) << result.num_flushes
+			<< std::setw(11) << result.num_flush_primes
+			<< std::setw(11) << result.num_setF
+			<< std::setw(11) << result.dram_reads
+			<< std::setw(11) << result.dram_writebacks
+			<< std::setw(11) << result.cycles
+			<< std::setw(11) << std::fixed << std::setprecision(2) << (result.accesses ? (double) result.cycles / result.accesses : 0.0)
+			<< std::setw(11) << std::setprecision(3) << result.seconds;
+		if (prefetching) {
+			std::cout << std::setw(11) << result.prefetch_issued
+				<< std::setw(11) << result.prefetch_useful
+				<< std::setw(11) << result.prefetch_late
+				<< std::setw(11) << result.prefetch_useless
+				<< std::setw(11) << result.prefetch_invalidated
+				<< std::setw(11) << result.prefetch_ownership_taken;
+		}
+		std::cout << "\n";
+	}
+	std::cout << std::flush;
+}
+
+void runSweep(const TraceRecord* records, uint64_t num_records, const std::vector<SweepPoint>& points, const SimConfig& config) {
+	runPoints(records, num_records, NULL, points, config);
+}
+
+void runSweep(const WorkloadSpec& workload, const std::vector<SweepPoint>& points, const SimConfig& config) {
+	runPoints(NULL, 0, &workload, points, config);
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "request.h"
+#include "geometry.h"
+#include "trace.h"
+#include "config.h"
+#include "workload.h"
+
+// One configuration of a sweep
+class SweepPoint {
+	public:
+		Protocol protocol;
+		CacheGeometry geometry;
+
+		SweepPoint(Protocol _protocol, CacheGeometry _geometry);
+};
+
+// Simulates every point over the same in-memory trace, spreading the points over
+// the number of threads given, and prints one table with a row per point
+// Each point gets its own Simulator, so the threads share nothing but the read-only trace
+// The other options (number of cores, snoop filter, ...) come from config
+void runSweep(const TraceRecord* records, uint64_t num_records, const std::vector<SweepPoint>& points, const SimConfig& config);
+
+// Same as above, over the accesses of a generated workload instead of a trace
+// Every point generates its own copy of the accesses, with the block size of its geometry
+void runSweep(const WorkloadSpec& workload, const std::vector<SweepPoint>& points, const SimConfig& config);
@@ -0,0 +1,241 @@
+#include <iostream>
+#include <iomanip>
+#include <climits>
+#include <algorithm>
+#include "timedbus.h"
+
+// Records taken from the source at a time
+#define TIMED_BATCH_SIZE 1024
+
+TimedBus::TimedBus(Simulator& _sim, const BusTiming& _timing) : sim(_sim) {
+	timing = _timing;
+	int num_cores = sim.numCores();
+	int block_size = sim.caches[0]->geometry.blockSize();
+	data_cycles = (block_size + timing.bandwidth - 1) / timing.bandwidth;
+
+	pending.resize(num_cores);
+	buffered = 0;
+	empty_queues = num_cores;
+	source_done = false;
+	now = 0;
+	core_time.assign(num_cores, 0);
+	int num_banks = sim.bus->banks.size();
+	address_free.assign(num_banks, 0);
+	data_free.assign(num_banks, 0);
+	last_granted.assign(num_banks, num_cores - 1);
+
+	stall_cycles.assign(num_cores, 0);
+	address_busy.assign(num_banks, 0);
+	data_busy.assign(num_banks, 0);
+	num_transactions = 0;
+	num_transfers = 0;
+	address_queueing = 0;
+	data_queueing = 0;
+	num_late = 0;
+}
+
+// Reads ahead until TIMED_WINDOW records are queued and every core has one (or
+// TIMED_WINDOW_LIMIT are), or the source ends
+bool TimedBus::refill(RecordSource& source, int& bad_core) {
+	TraceRecord batch[TIMED_BATCH_SIZE];
+	while (!source_done && (buffered < TIMED_WINDOW || (empty_queues > 0 && buffered < TIMED_WINDOW_LIMIT))) {
+		size_t count = source(batch, TIMED_BATCH_SIZE);
+		if (count == 0) {
+			source_done = true;
+		}
+		for (size_t i=0; i < count; i++) {
+			if (batch[i].core >= pending.size()) {
+				bad_core = batch[i].core;
+				return false;
+			}
+			int core = batch[i].core;
+			if (pending[core].empty()) {
+				empty_queues--;
+				// The core ran out of accesses earlier, while the others went on
+				if (core_time[core] < now) {
+					core_time[core] = now;
+					num_late++;
+				}
+			}
+			pending[core].push_back(batch[i]);
+		}
+		buffered += count;
+	}
+	return true;
+}
+
+TraceRecord TimedBus::pop(int core) {
+	TraceRecord record = pending[core].front();
+	pending[core].pop_front();
+	buffered--;
+	if (pending[core].empty()) {
+		empty_queues++;
+	}
+	return record;
+}
+
+// Picks the core that gets the address bus of the bank at grant_time among the waiting ones
+int TimedBus::arbitrate(const std::vector<int>& waiting, const std::vector<int>& waiting_banks, int bank, unsigned long long grant_time) {
+	int num_cores = pending.size();
+	int granted = -1;
+	int best_distance = INT_MAX;
+	for (size_t i=0; i < waiting.size(); i++) {
+		int core = waiting[i];
+		if (waiting_banks[i] != bank || core_time[core] > grant_time) {
+			continue;
+		}
+		if (timing.arbitration == Arbitration::FCFS) {
+			// waiting is in core order, so ties go to the lowest core
+			if (granted < 0 || core_time[core] < core_time[granted]) {
+				granted = core;
+			}
+		} else {
+			int distance = (core - last_granted[bank] - 1 + num_cores) % num_cores;
+			if (distance < best_distance) {
+				best_distance = distance;
+				granted = core;
+			}
+		}
+	}
+	last_granted[bank] = granted;
+	return granted;
+}
+
+// Runs the next access of the core as a transaction granted the bank at grant_time
+void TimedBus::transaction(int core, int bank, unsigned long long grant_time) {
+	const LatencyModel& latency = sim.latency;
+	TraceRecord record = pop(core);
+	now = grant_time;
+
+	unsigned long long ready = core_time[core];
+	address_queueing += grant_time - ready;
+	num_transactions++;
+
+	sim.access(core, (ProcRequest) record.op, record.address);
+	const AccessOutcome& outcome = sim.bus->outcome;
+
+	unsigned long long address_end = grant_time + timing.address_cycles;
+	address_free[bank] = address_end;
+	address_busy[bank] += timing.address_cycles;
+
+	unsigned long long done = address_end;
+	if (!outcome.hit) {
+		unsigned long long data_ready = address_end + (outcome.supplied ? latency.cache_to_cache : latency.llc)
+			+ (outcome.dram ? latency.dram : 0);
+		unsigned long long data_start = std::max(data_ready, data_free[bank]);
+		data_queueing += data_start - data_ready;
+		num_transfers++;
+		data_free[bank] = data_start + data_cycles;
+		data_busy[bank] += data_cycles;
+		done = data_free[bank];
+	}
+	if (outcome.upgrade || outcome.invalidations > 0) {
+		done = std::max(done, address_end + latency.invalidation);
+	}
+	// Writebacks are buffered: they use the data bus, but the core does not wait for them
+	// (they are charged to the bank of the transaction, whichever block they write back)
+	for (int i=0; i < outcome.writebacks; i++) {
+		data_free[bank] = std::max(data_free[bank], address_end) + data_cycles;
+		data_busy[bank] += data_cycles;
+	}
+	done += latency.hit;
+
+	stall_cycles[core] += done - ready - latency.hit;
+	core_time[core] = done;
+}
+
+bool TimedBus::run(RecordSource source, int& bad_core) {
+	int num_cores = pending.size();
+	const CacheGeometry& geometry = sim.caches[0]->geometry;
+	std::vector<int> waiting, waiting_banks;
+	while (true) {
+		if (!refill(source, bad_core)) {
+			return false;
+		}
+
+		// Earliest core whose next access hits, the cores waiting for the bus,
+		// and the first time one of them can be granted its bank
+		int hit_core = -1;
+		unsigned long long hit_time = ULLONG_MAX;
+		unsigned long long grant_time = ULLONG_MAX;
+		int grant_bank = 0;
+		waiting.clear();
+		waiting_banks.clear();
+		for (int core=0; core < num_cores; core++) {
+			if (pending[core].empty()) {
+				continue;
+			}
+			const TraceRecord& record = pending[core].front();
+			if (sim.caches[core]->needsBus((ProcRequest) record.op, record.address)) {
+				int bank = sim.bus->bankIndex(geometry.blockAddressOf(record.address));
+				waiting.push_back(core);
+				waiting_banks.push_back(bank);
+				unsigned long long grant = std::max(core_time[core], address_free[bank]);
+				if (grant < grant_time) {
+					grant_time = grant;
+					grant_bank = bank;
+				}
+			} else if (core_time[core] < hit_time) {
+				hit_time = core_time[core];
+				hit_core = core;
+			}
+		}
+		if (hit_core < 0 && waiting.empty()) {
+			return true;
+		}
+
+		// Whatever happens first goes first, so the caches see the accesses in time order
+		if (hit_core >= 0 && hit_time <= grant_time) {
+			TraceRecord record = pop(hit_core);
+			now = hit_time;
+			sim.access(hit_core, (ProcRequest) record.op, record.address);
+			core_time[hit_core] += sim.latency.hit;
+			continue;
+		}
+		transaction(arbitrate(waiting, waiting_banks, grant_bank, grant_time), grant_bank, grant_time);
+	}
+}
+
+void TimedBus::printStats() {
+	unsigned long long cycles = 0;
+	unsigned long long total_stalls = 0;
+	for (size_t core=0; core < core_time.size(); core++) {
+		cycles = std::max(cycles, core_time[core]);
+		total_stalls += stall_cycles[core];
+	}
+	size_t num_banks = address_busy.size();
+	unsigned long long total_address_busy = 0, total_data_busy = 0;
+	for (size_t bank=0; bank < num_banks; bank++) {
+		total_address_busy += address_busy[bank];
+		total_data_busy += data_busy[bank];
+	}
+	// Utilization is over the time of all the banks together
+	unsigned long long bank_cycles = cycles * num_banks;
+	std::cout << std::dec << std::fixed << std::setprecision(2);
+	std::cout << ">>>> Timed bus (" << (timing.arbitration == Arbitration::FCFS ? "FCFS" : "round-robin")
+		<< ", address phase " << timing.address_cycles << " cycles, data phase " << data_cycles << " cycles per block)\n";
+	std::cout << "Cycles             : " << cycles << '\n';
+	std::cout << "Transactions       : " << num_transactions << '\n';
+	std::cout << "Address bus busy   : " << total_address_busy << " cycles, " << (bank_cycles ? 100.0 * total_address_busy / bank_cycles : 0.0) << "%\n";
+	std::cout << "Data bus busy      : " << total_data_busy << " cycles, " << (bank_cycles ? 100.0 * total_data_busy / bank_cycles : 0.0) << "%\n";
+	if (num_banks > 1) {
+		for (size_t bank=0; bank < num_banks; bank++) {
+			std::cout << "Bank " << std::setw(5) << std::left << bank << std::right << ": address bus "
+				<< (cycles ? 100.0 * address_busy[bank] / cycles : 0.0) << "% busy, data bus "
+				<< (cycles ? 100.0 * data_busy[bank] / cycles : 0.0) << "% busy\n";
+		}
+	}
+	std::cout << "Address queueing   : " << address_queueing << " cycles, average "
+		<< (num_transactions ? (double) address_queueing / num_transactions : 0.0) << " per transaction\n";
+	std::cout << "Data queueing      : " << data_queueing << " cycles, average "
+		<< (num_transfers ? (double) data_queueing / num_transfers : 0.0) << " per block transfer\n";
+	std::cout << "Stall cycles       : " << total_stalls << '\n';
+	for (size_t core=0; core < core_time.size(); core++) {
+		std::cout << "Core " << std::setw(5) << std::left << core << std::right << ": " << std::setw(14) << stall_cycles[core]
+			<< " stall cycles, " << (core_time[core] ? 100.0 * stall_cycles[core] / core_time[core] : 0.0) << "% of its time\n";
+	}
+	if (num_late > 0) {
+		std::cout << "Late accesses      : " << num_late << " (their core had nothing read ahead while the others ran on;"
+			<< " the trace has more than " << TIMED_WINDOW_LIMIT << " accesses of some core in a row)\n";
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include "trace.h"
+#include "latency.h"
+#include "simulator.h"
+
+// Records read ahead of the simulation, so every core has its next access queued
+// Past TIMED_WINDOW, reading goes on while a core has none queued, up to TIMED_WINDOW_LIMIT
+#define TIMED_WINDOW 65536
+#define TIMED_WINDOW_LIMIT (1 << 22)
+
+// Cycle-approximate timing on top of a Simulator, for a split-transaction bus
+// Each core runs in order on its own clock, one access at a time. Hits take the hit
+// latency. Misses and upgrades queue for the address bus, which the arbitration hands
+// to one waiting core at a time. A miss then waits for its data from another cache or
+// from the LLC, and for a slot on the data bus, which other transactions can use in the
+// meantime. Writebacks take data bus slots but do not stall the core.
+// With several bus banks, each bank has its own address and data bus.
+// A transaction is still handled atomically by the caches when it is granted the bus;
+// the timing decides the order in which the cores' accesses reach the caches.
+// A core whose next access is not read ahead yet (say a trace captured per thread, with
+// more than TIMED_WINDOW_LIMIT accesses of one core in a row) falls behind; when its access
+// arrives, the core is moved up to the current time so that the order holds, and the
+// access is counted as late.
+class TimedBus {
+	public:
+		TimedBus(Simulator& _sim, const BusTiming& _timing);
+
+		// Simulates every access from source, keeping the order of each core's accesses
+		// Returns false, with the core in bad_core, on a core the simulator does not have
+		bool run(RecordSource source, int& bad_core);
+
+		// Prints the bus utilization, the queueing delay and the stall cycles per core
+		void printStats();
+
+	private:
+		Simulator& sim;
+		BusTiming timing;
+		unsigned data_cycles;
+
+		std::vector<std::deque<TraceRecord> > pending;
+		size_t buffered, empty_queues;
+		bool source_done;
+
+		// Time of the last access the caches saw
+		unsigned long long now;
+
+		// Cycle each core issues its next access at
+		std::vector<unsigned long long> core_time;
+
+		// Per bank: when its address and data buses are free again, and the core granted last
+		std::vector<unsigned long long> address_free, data_free;
+		std::vector<int> last_granted;
+
+		// Counters; busy cycles are per bank
+		std::vector<unsigned long long> stall_cycles, address_busy, data_busy;
+		unsigned long long num_transactions, num_transfers, address_queueing, data_queueing, num_late;
+
+		bool refill(RecordSource& source, int& bad_core);
+		TraceRecord pop(int core);
+		int arbitrate(const std::vector<int>& waiting, const std::vector<int>& waiting_banks, int bank, unsigned long long grant_time);
+		void transaction(int core, int bank, unsigned long long grant_time);
+};
@@ -0,0 +1,709 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <climits>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+#include "protocol.h"
+
+// Bytes of decompressed input buffered by a TraceReader
+#define TRACE_READ_BUFFER (1 << 18)
+
+// Records moved at a time by loadTrace and convertTrace
+#define TRACE_CHUNK 4096
+
+// Appends value as a varint: 7 bits per byte, low bits first, the top bit set on all but the last
+static void putVarint(std::vector<unsigned char>& out, uint64_t value) {
+	while (value >= 0x80) {
+		out.push_back((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	out.push_back(value);
+}
+
+// Reads the varint at data, which must end before end
+// Returns the byte after it, or NULL if it runs past end or over 64 bits
+static inline const unsigned char* getVarint(const unsigned char* data, const unsigned char* end, uint64_t& value) {
+	// Most deltas fit in one byte
+	if (data < end && *data < 0x80) {
+		value = *data;
+		return data + 1;
+	}
+	value = 0;
+	for (int shift=0; shift < 64 && data < end; shift += 7) {
+		unsigned char byte = *data++;
+		value |= (uint64_t) (byte & 0x7f) << shift;
+		if (byte < 0x80) {
+			return data;
+		}
+	}
+	return NULL;
+}
+
+// Encodes the records as one block, its header included, into out
+// last receives the previous address of every core, and grows to the highest core
+static void encodeCompactBlock(const TraceRecord* records, size_t count, std::vector<uint64_t>& last, std::vector<unsigned char>& out) {
+	out.resize(sizeof(CompactBlockHeader));
+	std::fill(last.begin(), last.end(), 0);
+	for (size_t i=0; i < count; i++) {
+		const TraceRecord& record = records[i];
+		if (record.core >= last.size()) {
+			last.resize(record.core + 1, 0);
+		}
+		if (record.core < COMPACT_CORE_ESCAPE) {
+			out.push_back(record.core << 1 | record.op);
+		} else {
+			out.push_back(COMPACT_CORE_ESCAPE << 1 | record.op);
+			putVarint(out, record.core);
+		}
+		uint64_t delta = record.address - last[record.core];
+		last[record.core] = record.address;
+		putVarint(out, (delta << 1) ^ (uint64_t) ((int64_t) delta >> 63));
+	}
+	CompactBlockHeader header;
+	header.num_records = count;
+	header.size = out.size() - sizeof(header);
+	memcpy(out.data(), &header, sizeof(header));
+}
+
+// Decodes the count records of the block at data, size bytes long without its header
+// last must have room for num_cores addresses
+// Returns false if the block is corrupt
+static bool decodeCompactBlock(const unsigned char* data, size_t size, size_t count, uint64_t* last, uint32_t num_cores, TraceRecord* records) {
+	const unsigned char* end = data + size;
+	std::fill(last, last + num_cores, 0);
+	for (size_t i=0; i < count; i++) {
+		if (data >= end) {
+			return false;
+		}
+		unsigned char head = *data++;
+		uint64_t core = head >> 1;
+		if (core == COMPACT_CORE_ESCAPE && (data = getVarint(data, end, core)) == NULL) {
+			return false;
+		}
+		uint64_t zigzag;
+		if (core >= num_cores || (data = getVarint(data, end, zigzag)) == NULL) {
+			return false;
+		}
+		uint64_t address = last[core] + ((zigzag >> 1) ^ (0 - (zigzag & 1)));
+		last[core] = address;
+		records[i].address = address;
+		records[i].core = core;
+		records[i].op = head & 1;
+	}
+	return data == end;
+}
+
+TraceReader::TraceReader() {
+	file = NULL;
+	binary = false;
+	compact = false;
+	block_pos = 0;
+	failed = false;
+	has_bad_core = false;
+	bad_core = 0;
+	records_left = 0;
+	hex_cores = false;
+	line = 1;
+	buffer = new char[TRACE_READ_BUFFER];
+	pos = end = 0;
+	at_eof = false;
+}
+
+TraceReader::~TraceReader() {
+	if (file != NULL) {
+		gzclose(file);
+	}
+	delete[] buffer;
+}
+
+bool TraceReader::open(const char* path) {
+	// zlib reads uncompressed input unchanged, so one path serves both
+	if (std::string(path) == "-") {
+		file = gzdopen(STDIN_FILENO, "rb");
+	} else {
+		file = gzopen(path, "rb");
+	}
+	if (file == NULL) {
+		std::cout << "Cannot open trace " << path << std::endl;
+		return false;
+	}
+	gzbuffer(file, TRACE_READ_BUFFER);
+	return true;
+}
+
+// Makes at least bytes bytes available at buffer + pos, unless the input ends first
+bool TraceReader::fill(size_t bytes) {
+	if (end - pos >= bytes) {
+		return true;
+	}
+	memmove(buffer, buffer + pos, end - pos);
+	end -= pos;
+	pos = 0;
+	while (end < bytes && !at_eof) {
+		int got = gzread(file, buffer + end, TRACE_READ_BUFFER - end);
+		if (got < 0) {
+			int code;
+			std::cout << "Error reading trace: " << gzerror(file, &code) << std::endl;
+			failed = true;
+			at_eof = true;
+		} else if (got == 0) {
+			at_eof = true;
+		}
+		end += (got > 0) ? got : 0;
+	}
+	return end - pos >= bytes;
+}
+
+// Skips white space; returns false if the input ends first
+bool TraceReader::skipSpace() {
+	while (true) {
+		while (pos < end && isspace((unsigned char) buffer[pos])) {
+			if (buffer[pos] == '\n') {
+				line++;
+			}
+			pos++;
+		}
+		if (pos < end) {
+			return true;
+		}
+		if (!fill(1)) {
+			return false;
+		}
+	}
+}
+
+bool TraceReader::readWord(std::string& word) {
+	word.clear();
+	if (!skipSpace()) {
+		return false;
+	}
+	while ((pos < end || fill(1)) && !isspace((unsigned char) buffer[pos])) {
+		word += buffer[pos++];
+	}
+	return true;
+}
+
+// Reads an optionally signed number the way operator>> does, hex ones with an optional 0x
+// Returns false if there is no number at the current position, or if it does not fit in
+// 64 bits, which is an error of the trace
+bool TraceReader::readNumber(bool hex, bool& negative, unsigned long long& value) {
+	if (!skipSpace()) {
+		return false;
+	}
+	negative = false;
+	if (buffer[pos] == '-' || buffer[pos] == '+') {
+		negative = buffer[pos] == '-';
+		pos++;
+	}
+	unsigned base = hex ? 16 : 10;
+	if (hex && fill(2) && buffer[pos] == '0' && (buffer[pos + 1] == 'x' || buffer[pos + 1] == 'X')) {
+		pos += 2;
+	}
+	value = 0;
+	int digits = 0;
+	while (pos < end || fill(1)) {
+		char c = buffer[pos];
+		unsigned digit;
+		if (c >= '0' && c <= '9') {
+			digit = c - '0';
+		} else if (hex && c >= 'a' && c <= 'f') {
+			digit = c - 'a' + 10;
+		} else if (hex && c >= 'A' && c <= 'F') {
+			digit = c - 'A' + 10;
+		} else {
+			break;
+		}
+		if (value > (ULLONG_MAX - digit) / base) {
+			std::cout << "Trace has a number too large for 64 bits at line " << line << std::endl;
+			failed = true;
+			return false;
+		}
+		value = value * base + digit;
+		digits++;
+		pos++;
+	}
+	return digits > 0;
+}
+
+// Parses the next "<core> <r|w> <address>" access, skipping accesses that are
+// neither reads nor writes; sets done at the end of the trace or on an error
+bool TraceReader::readTextRecord(TraceRecord& record, bool& done) {
+	while (true) {
+		bool core_negative, negative;
+		unsigned long long core, address;
+		if (!readNumber(hex_cores, core_negative, core) || (core_negative && core == 1)) {
+			done = true;
+			return false;
+		}
+		if (!skipSpace()) {
+			done = true;
+			return false;
+		}
+		char r_or_w = buffer[pos++];
+		hex_cores = true;
+		if (!readNumber(true, negative, address)) {
+			done = true;
+			return false;
+		}
+		if (negative) {
+			address = -address;
+		}
+		if (core > UINT16_MAX || (core_negative && core != 0)) {
+			has_bad_core = true;
+			bad_core = core_negative ? -(long long) core : (long long) core;
+			failed = true;
+			done = true;
+			return false;
+		}
+		if (r_or_w != 'r' && r_or_w != 'w') {
+			continue;
+		}
+		record.address = address;
+		record.core = core;
+		record.op = (r_or_w == 'r') ? ProcRequest::ProcRd : ProcRequest::ProcWr;
+		return true;
+	}
+}
+
+bool TraceReader::readProtocol(Protocol& protocol, std::string& name) {
+	if (fill(sizeof(uint32_t)) && *(const uint32_t*) (buffer + pos) == TRACE_MAGIC) {
+		TraceHeader header;
+		if (!fill(sizeof(header))) {
+			std::cout << "Trace is too short" << std::endl;
+			failed = true;
+			return false;
+		}
+		memcpy(&header, buffer + pos, sizeof(header));
+		pos += sizeof(header);
+		if (header.version != TRACE_VERSION || header.record_size != sizeof(TraceRecord)) {
+			std::cout << "Trace is not a version " << TRACE_VERSION << " binary trace" << std::endl;
+			failed = true;
+			return false;
+		}
+		binary = true;
+		records_left = header.num_records;
+		name = std::to_string(header.protocol);
+		if (header.protocol > Protocol::FESI) {
+			return false;
+		}
+		protocol = (Protocol) header.protocol;
+		return true;
+	}
+	if (fill(sizeof(uint32_t)) && *(const uint32_t*) (buffer + pos) == COMPACT_MAGIC) {
+		CompactHeader header;
+		if (!fill(sizeof(header))) {
+			std::cout << "Trace is too short" << std::endl;
+			failed = true;
+			return false;
+		}
+		memcpy(&header, buffer + pos, sizeof(header));
+		pos += sizeof(header);
+		if (header.version != COMPACT_VERSION || header.num_cores > UINT16_MAX + 1) {
+			std::cout << "Trace is not a version " << COMPACT_VERSION << " compact trace" << std::endl;
+			failed = true;
+			return false;
+		}
+		compact = true;
+		records_left = header.num_records;
+		last_address.resize(header.num_cores);
+		name = std::to_string(header.protocol);
+		if (header.protocol > Protocol::FESI) {
+			return false;
+		}
+		protocol = (Protocol) header.protocol;
+		return true;
+	}
+	readWord(name);
+	return protocolFromName(name, protocol);
+}
+
+// Decodes the next block of a compact trace into block
+// Returns false at the end of the trace, or on an error
+bool TraceReader::readCompactBlock() {
+	if (records_left == 0) {
+		return false;
+	}
+	CompactBlockHeader header;
+	if (!fill(sizeof(header))) {
+		std::cout << "Trace is truncated" << std::endl;
+		failed = true;
+		return false;
+	}
+	memcpy(&header, buffer + pos, sizeof(header));
+	pos += sizeof(header);
+	if (header.num_records == 0 || header.num_records > COMPACT_BLOCK_RECORDS || header.num_records > records_left
+		|| header.size > TRACE_READ_BUFFER) {
+		std::cout << "Trace has a corrupt block" << std::endl;
+		failed = true;
+		return false;
+	}
+	if (!fill(header.size)) {
+		std::cout << "Trace is truncated" << std::endl;
+		failed = true;
+		return false;
+	}
+	block.resize(header.num_records);
+	if (!decodeCompactBlock((const unsigned char*) buffer + pos, header.size, header.num_records,
+		last_address.data(), last_address.size(), block.data())) {
+		std::cout << "Trace has a corrupt block" << std::endl;
+		failed = true;
+		return false;
+	}
+	pos += header.size;
+	block_pos = 0;
+	records_left -= header.num_records;
+	return true;
+}
+
+size_t TraceReader::read(TraceRecord* records, size_t max_records) {
+	if (failed) {
+		return 0;
+	}
+	if (compact) {
+		size_t count = 0;
+		while (count < max_records && (block_pos < block.size() || readCompactBlock())) {
+			size_t n = std::min(max_records - count, block.size() - block_pos);
+			memcpy(records + count, block.data() + block_pos, n * sizeof(TraceRecord));
+			block_pos += n;
+			count += n;
+		}
+		return count;
+	}
+	if (!binary) {
+		bool done = false;
+		size_t count = 0;
+		while (count < max_records && readTextRecord(records[count], done)) {
+			count++;
+		}
+		return count;
+	}
+
+	// Binary records are copied straight out of the buffer and the decompressor
+	size_t count = (records_left < max_records) ? records_left : max_records;
+	size_t want = count * sizeof(TraceRecord);
+	size_t have = (end - pos < want) ? end - pos : want;
+	memcpy(records, buffer + pos, have);
+	pos += have;
+	while (have < want) {
+		int got = gzread(file, (char*) records + have, want - have);
+		if (got <= 0) {
+			std::cout << "Trace is truncated" << std::endl;
+			failed = true;
+			break;
+		}
+		have += got;
+	}
+	count = have / sizeof(TraceRecord);
+	records_left -= count;
+	for (size_t i=0; i < count; i++) {
+		if (records[i].op > ProcRequest::ProcWr) {
+			std::cout << "Trace has an access that is neither a read nor a write" << std::endl;
+			failed = true;
+			return i;
+		}
+	}
+	return count;
+}
+
+bool TraceReader::error() {
+	return failed;
+}
+
+bool loadTrace(TraceReader& reader, std::vector<TraceRecord>& records) {
+	size_t count;
+	do {
+		size_t old_size = records.size();
+		records.resize(old_size + TRACE_CHUNK);
+		count = reader.read(records.data() + old_size, TRACE_CHUNK);
+		records.resize(old_size + count);
+	} while (count > 0);
+	if (reader.has_bad_core) {
+		std::cout << "Incorrect core number " << reader.bad_core << std::endl;
+	}
+	return !reader.error();
+}
+
+// Writes the records of reader as compact blocks after the header, then the index
+// Returns false if a record cannot be encoded or the trace ends on an error
+static bool writeCompactTrace(TraceReader& reader, std::ofstream& out, CompactHeader& header) {
+	std::vector<TraceRecord> chunk(COMPACT_BLOCK_RECORDS);
+	std::vector<uint64_t> last;
+	std::vector<unsigned char> encoded;
+	std::vector<CompactIndexEntry> index;
+	uint64_t offset = sizeof(header);
+	size_t count;
+	while ((count = reader.read(chunk.data(), chunk.size())) > 0) {
+		for (size_t i=0; i < count; i++) {
+			if (chunk[i].op > ProcRequest::ProcWr) {
+				std::cout << "Only reads and writes can be stored in a compact trace" << std::endl;
+				return false;
+			}
+		}
+		encodeCompactBlock(chunk.data(), count, last, encoded);
+		CompactIndexEntry entry;
+		entry.offset = offset;
+		entry.first_record = header.num_records;
+		index.push_back(entry);
+		out.write((const char*) encoded.data(), encoded.size());
+		offset += encoded.size();
+		header.num_records += count;
+	}
+	if (reader.error()) {
+		return false;
+	}
+	header.num_cores = last.size();
+	header.num_blocks = index.size();
+	header.index_offset = offset;
+	out.write((const char*) index.data(), index.size() * sizeof(CompactIndexEntry));
+	return true;
+}
+
+int convertTrace(TraceReader& reader, const char* out_path, bool compact) {
+	std::string protocol_name;
+	Protocol protocol;
+	if (!reader.readProtocol(protocol, protocol_name)) {
+		std::cout << "Unknown protocol " << protocol_name << std::endl;
+		return 1;
+	}
+
+	std::ofstream out(out_path, std::ios::binary);
+	if (!out) {
+		std::cout << "Cannot open " << out_path << std::endl;
+		return 1;
+	}
+
+	if (compact) {
+		CompactHeader header;
+		memset(&header, 0, sizeof(header));
+		header.magic = COMPACT_MAGIC;
+		header.version = COMPACT_VERSION;
+		header.protocol = protocol;
+		out.write((const char*) &header, sizeof(header));
+		if (!writeCompactTrace(reader, out, header)) {
+			if (reader.has_bad_core) {
+				std::cout << "Incorrect core number " << reader.bad_core << std::endl;
+			}
+			return 1;
+		}
+
+		// Patch the counts and the index offset now that they are known
+		out.seekp(0);
+		out.write((const char*) &header, sizeof(header));
+		out.close();
+		if (!out) {
+			std::cout << "Error writing " << out_path << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	TraceHeader header;
+	header.magic = TRACE_MAGIC;
+	header.version = TRACE_VERSION;
+	header.protocol = protocol;
+	header.record_size = sizeof(TraceRecord);
+	header.num_records = 0;
+	out.write((const char*) &header, sizeof(header));
+
+	std::vector<TraceRecord> chunk(TRACE_CHUNK);
+	size_t count;
+	while ((count = reader.read(chunk.data(), chunk.size())) > 0) {
+		out.write((const char*) chunk.data(), count * sizeof(TraceRecord));
+		header.num_records += count;
+	}
+	if (reader.error()) {
+		if (reader.has_bad_core) {
+			std::cout << "Incorrect core number " << reader.bad_core << std::endl;
+		}
+		return 1;
+	}
+
+	// Patch the record count now that it is known
+	out.seekp(0);
+	out.write((const char*) &header, sizeof(header));
+	out.close();
+	if (!out) {
+		std::cout << "Error writing " << out_path << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+bool isBinaryTrace(const char* path) {
+	std::ifstream in(path, std::ios::binary);
+	uint32_t magic = 0;
+	in.read((char*) &magic, sizeof(magic));
+	return in && magic == TRACE_MAGIC;
+}
+
+bool isCompactTrace(const char* path) {
+	std::ifstream in(path, std::ios::binary);
+	uint32_t magic = 0;
+	in.read((char*) &magic, sizeof(magic));
+	return in && magic == COMPACT_MAGIC;
+}
+
+// Decodes the blocks of the compact trace mapped at file, length bytes long
+static bool decodeCompactTrace(const char* path, const unsigned char* file, size_t length, int threads, std::vector<TraceRecord>& records) {
+	CompactHeader header;
+	if (length < sizeof(header)) {
+		std::cout << "Trace " << path << " is too short" << std::endl;
+		return false;
+	}
+	memcpy(&header, file, sizeof(header));
+	if (header.magic != COMPACT_MAGIC || header.version != COMPACT_VERSION || header.num_cores > UINT16_MAX + 1) {
+		std::cout << "Trace " << path << " is not a version " << COMPACT_VERSION << " compact trace" << std::endl;
+		return false;
+	}
+	if (header.index_offset > length || header.num_blocks > (length - header.index_offset) / sizeof(CompactIndexEntry)
+		|| header.num_records > length) {
+		std::cout << "Trace " << path << " is truncated" << std::endl;
+		return false;
+	}
+	const CompactIndexEntry* index = (const CompactIndexEntry*) (file + header.index_offset);
+
+	// Every block is checked against the index before any is decoded, so that the
+	// threads only have to check the records
+	for (uint64_t b=0; b < header.num_blocks; b++) {
+		uint64_t next_record = (b + 1 < header.num_blocks) ? index[b + 1].first_record : header.num_records;
+		uint64_t next_offset = (b + 1 < header.num_blocks) ? index[b + 1].offset : header.index_offset;
+		CompactBlockHeader block;
+		if (index[b].offset < sizeof(header) || index[b].offset + sizeof(block) > next_offset || next_offset > header.index_offset) {
+			std::cout << "Trace " << path << " has a corrupt index" << std::endl;
+			return false;
+		}
+		memcpy(&block, file + index[b].offset, sizeof(block));
+		if (index[b].first_record + block.num_records != next_record || index[b].offset + sizeof(block) + block.size != next_offset
+			|| (b == 0 && index[b].first_record != 0)) {
+			std::cout << "Trace " << path << " has a corrupt index" << std::endl;
+			return false;
+		}
+	}
+	if (header.num_blocks == 0 && header.num_records != 0) {
+		std::cout << "Trace " << path << " has a corrupt index" << std::endl;
+		return false;
+	}
+
+	// Workers pull the next block off a shared counter, and decode it in place
+	records.resize(header.num_records);
+	std::atomic<uint64_t> next_block(0);
+	std::atomic<bool> corrupt(false);
+	std::vector<std::thread> workers;
+	for (int t=0; t < threads; t++) {
+		workers.push_back(std::thread([&]() {
+			std::vector<uint64_t> last(header.num_cores);
+			uint64_t b;
+			while ((b = next_block++) < header.num_blocks) {
+				CompactBlockHeader block;
+				memcpy(&block, file + index[b].offset, sizeof(block));
+				if (!decodeCompactBlock(file + index[b].offset + sizeof(block), block.size, block.num_records,
+					last.data(), header.num_cores, records.data() + index[b].first_record)) {
+					corrupt = true;
+				}
+			}
+		}));
+	}
+	for (size_t t=0; t < workers.size(); t++) {
+		workers[t].join();
+	}
+	if (corrupt) {
+		std::cout << "Trace " << path << " has a corrupt block" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool loadCompactTrace(const char* path, int threads, std::vector<TraceRecord>& records) {
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		std::cout << "Cannot open trace " << path << std::endl;
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		std::cout << "Trace " << path << " is too short" << std::endl;
+		close(fd);
+		return false;
+	}
+	void* base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		std::cout << "Cannot map trace " << path << std::endl;
+		return false;
+	}
+	bool loaded = decodeCompactTrace(path, (const unsigned char*) base, st.st_size, threads, records);
+	munmap(base, st.st_size);
+	return loaded;
+}
+
+TraceFile::TraceFile() {
+	header = NULL;
+	records = NULL;
+	fd = -1;
+	base = MAP_FAILED;
+	length = 0;
+}
+
+TraceFile::~TraceFile() {
+	if (base != MAP_FAILED) {
+		munmap(base, length);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+bool TraceFile::open(const char* path) {
+	fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		std::cout << "Cannot open trace " << path << std::endl;
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(TraceHeader)) {
+		std::cout << "Trace " << path << " is too short" << std::endl;
+		return false;
+	}
+	length = st.st_size;
+	base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		std::cout << "Cannot map trace " << path << std::endl;
+		return false;
+	}
+	// Records are consumed front to back exactly once
+	madvise(base, length, MADV_SEQUENTIAL);
+
+	header = (const TraceHeader*) base;
+	if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION || header->record_size != sizeof(TraceRecord)) {
+		std::cout << "Trace " << path << " is not a version " << TRACE_VERSION << " binary trace" << std::endl;
+		return false;
+	}
+	if (header->num_records > (length - sizeof(TraceHeader)) / sizeof(TraceRecord)) {
+		std::cout << "Trace " << path << " is truncated" << std::endl;
+		return false;
+	}
+	records = (const TraceRecord*) ((const char*) base + sizeof(TraceHeader));
+
+	// The op of a record indexes the protocol tables, so every one is checked once here
+	// rather than by each of the loops that read the records in place
+	for (uint64_t i=0; i < header->num_records; i++) {
+		if (records[i].op > ProcRequest::ProcWr) {
+			std::cout << "Trace " << path << " has an access that is neither a read nor a write, at record " << i << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t TraceFile::size() {
+	return header->num_records;
+}
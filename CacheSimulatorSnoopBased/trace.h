@@ -0,0 +1,166 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <functional>
+#include <zlib.h>
+#include "request.h"
+
+// Binary trace layout: one TraceHeader followed by num_records TraceRecords
+#define TRACE_MAGIC 0x43525446 // "FTRC"
+#define TRACE_VERSION 1
+
+struct TraceHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t protocol;
+	uint32_t record_size;
+	uint64_t num_records;
+};
+
+// One processor access, packed to a fixed width so records can be read in place
+struct __attribute__((packed)) TraceRecord {
+	uint64_t address;
+	uint16_t core;
+	uint8_t op; // ProcRequest
+};
+
+// Compact trace layout: one CompactHeader, num_blocks blocks, then the CompactIndexEntry
+// of every block at index_offset
+// A block is a CompactBlockHeader followed by up to COMPACT_BLOCK_RECORDS records, and
+// decodes on its own. A record is one byte with the op in bit 0 and the core above it
+// (COMPACT_CORE_ESCAPE: the core follows as a varint), then the address minus the previous
+// address of the same core in the block (0 before its first) as a zig-zag varint
+#define COMPACT_MAGIC 0x5A525446 // "FTRZ"
+#define COMPACT_VERSION 1
+#define COMPACT_BLOCK_RECORDS 16384
+#define COMPACT_CORE_ESCAPE 127
+
+struct CompactHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t protocol;
+	uint32_t num_cores; // highest core + 1
+	uint64_t num_records;
+	uint64_t num_blocks;
+	uint64_t index_offset;
+};
+
+struct CompactBlockHeader {
+	uint32_t num_records;
+	uint32_t size; // bytes of records after the block header
+};
+
+struct CompactIndexEntry {
+	uint64_t offset;       // of the block header, from the start of the file
+	uint64_t first_record;
+};
+
+// Fills up to the given number of records and returns how many it filled, 0 at the end
+typedef std::function<size_t(TraceRecord*, size_t)> RecordSource;
+
+// Reads a trace from a file or a pipe, as it arrives
+// The trace may be text or binary, and either may be gzip compressed
+// (other compressors can be piped in, e.g. zstd -dc trace.in.zst | sim)
+class TraceReader {
+	public:
+		TraceReader();
+		~TraceReader();
+
+		// Opens the trace at path, "-" being stdin
+		// Returns false (after printing the reason) if it cannot be opened
+		bool open(const char* path);
+
+		// Reads the protocol the trace was recorded with: the first word of a text
+		// trace, or the protocol field of the binary header
+		// Returns false if it is not a known protocol, with its name in name
+		bool readProtocol(Protocol& protocol, std::string& name);
+
+		// Reads up to max_records accesses into records and returns how many were read
+		// Text accesses that are neither reads nor writes are dropped, as the simulator ignores
+		// them; a binary record with such an op ends the trace on an error
+		// A text trace ends at core -1; check error() once 0 is returned
+		size_t read(TraceRecord* records, size_t max_records);
+
+		// True if the trace ended on an error rather than at its end
+		// bad_core is set if the error is a core number that does not fit a record
+		bool error();
+		bool has_bad_core;
+		long long bad_core;
+
+	private:
+		gzFile file;
+		bool binary;
+		bool compact;
+		bool failed;
+		uint64_t records_left;
+
+		// Compact traces: the decoded block and how much of it was read, and the
+		// previous address of every core
+		std::vector<TraceRecord> block;
+		size_t block_pos;
+		std::vector<uint64_t> last_address;
+
+		// Like the original driver loop, core numbers after the first access are read as hex
+		bool hex_cores;
+
+		// Line of a text trace being parsed, for the errors
+		uint64_t line;
+
+		// Decompressed input not parsed yet: buffer[pos, end)
+		char* buffer;
+		size_t pos, end;
+		bool at_eof;
+
+		bool fill(size_t bytes);
+		bool skipSpace();
+		bool readWord(std::string& word);
+		bool readNumber(bool hex, bool& negative, unsigned long long& value);
+		bool readTextRecord(TraceRecord& record, bool& done);
+		bool readCompactBlock();
+};
+
+// Reads the whole trace into records
+// Returns false (after printing the reason) if the trace ends on an error
+bool loadTrace(TraceReader& reader, std::vector<TraceRecord>& records);
+
+// Converts a trace to a binary trace at out_path, or a compact one
+// Returns 0 on success
+int convertTrace(TraceReader& reader, const char* out_path, bool compact);
+
+// Returns true if the file at path is an uncompressed binary trace, which can be
+// memory mapped with TraceFile instead of going through a TraceReader
+bool isBinaryTrace(const char* path);
+
+// Returns true if the file at path is an uncompressed compact trace, which can be
+// decoded with loadCompactTrace
+bool isCompactTrace(const char* path);
+
+// Maps the compact trace at path and decodes its blocks into records, split over threads
+// through the block index; the trace must not be compressed
+// Returns false (after printing the reason) if the file is not a usable compact trace
+bool loadCompactTrace(const char* path, int threads, std::vector<TraceRecord>& records);
+
+// A read-only, memory mapped binary trace
+class TraceFile {
+	public:
+		const TraceHeader* header;
+		const TraceRecord* records;
+
+		TraceFile();
+		~TraceFile();
+
+		// Maps the trace at path and validates its header and the op of every record
+		// Returns false (and prints the reason) if the file is not a usable trace
+		bool open(const char* path);
+
+		// Returns the number of records in the trace
+		uint64_t size();
+
+	private:
+		int fd;
+		void* base;
+		size_t length;
+};
@@ -0,0 +1,205 @@
+#include <cmath>
+#include <algorithm>
+#include "workload.h"
+
+static const char* PATTERN_NAMES[] = {"uniform", "producer-consumer", "migratory", "false-sharing", "read-mostly", "streaming", "zipfian"};
+
+// Write ratio of each pattern when none is given
+// Producer/consumer and migratory sharing have a fixed read/write structure and ignore it
+static const double DEFAULT_WRITE_RATIO[] = {0.3, 0.5, 0.5, 0.5, 0.01, 0.25, 0.2};
+
+// Blocks in one object of the migratory pattern
+#define MIGRATORY_OBJECT_BLOCKS 4
+
+// Streaming regions are this many bytes apart, so the cores never touch each other's data
+#define STREAM_REGION_BITS 36
+
+bool patternFromName(const std::string& name, WorkloadPattern& pattern) {
+	for (int i=0; i <= WorkloadPattern::Zipfian; i++) {
+		if (name == PATTERN_NAMES[i]) {
+			pattern = (WorkloadPattern) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* patternName(WorkloadPattern pattern) {
+	return PATTERN_NAMES[pattern];
+}
+
+WorkloadSpec::WorkloadSpec() {
+	pattern = WorkloadPattern::Uniform;
+	accesses = 1000000;
+	seed = 1;
+	cores = 1;
+	block_size = 64;
+	working_set = 4096;
+	write_ratio = -1;
+	shared_ratio = 0.1;
+	zipf_theta = 0.99;
+}
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadSpec& _spec) {
+	spec = _spec;
+	if (spec.working_set < 1) {
+		spec.working_set = 1;
+	}
+	write_ratio = (spec.write_ratio < 0) ? DEFAULT_WRITE_RATIO[spec.pattern] : spec.write_ratio;
+	generated = 0;
+	rng = spec.seed;
+	step = 0;
+	stream_position.assign(spec.cores, 0);
+	migratory_core = 0;
+	migratory_object = 0;
+
+	// Zipf sampling as in Gray et al., "Quickly Generating Billion-Record Synthetic Databases":
+	// zeta(n) is summed once here, then every sample costs a pow()
+	zipf_items = 0;
+	zipf_zetan = zipf_alpha = zipf_eta = 0;
+	if (spec.pattern == WorkloadPattern::Zipfian) {
+		double theta = spec.zipf_theta;
+		zipf_items = spec.working_set;
+		for (uint64_t i=1; i <= zipf_items; i++) {
+			zipf_zetan += 1.0 / pow((double) i, theta);
+		}
+		double zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+		zipf_alpha = 1.0 / (1.0 - theta);
+		zipf_eta = (1.0 - pow(2.0 / zipf_items, 1.0 - theta)) / (1.0 - zeta2 / zipf_zetan);
+	}
+}
+
+// splitmix64: small state, and good enough statistics for picking addresses
+uint64_t WorkloadGenerator::nextRandom() {
+	uint64_t z = (rng += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+double WorkloadGenerator::nextUnit() {
+	return (nextRandom() >> 11) * (1.0 / (1ULL << 53));
+}
+
+// Uniform in [0, n), by multiplying instead of the slower and biased modulo
+static inline uint64_t below(uint64_t random, uint64_t n) {
+	return (uint64_t) (((unsigned __int128) random * n) >> 64);
+}
+
+int WorkloadGenerator::randomCore() {
+	return below(nextRandom(), spec.cores);
+}
+
+// Rank in [0, zipf_items), rank 0 being the most popular
+uint64_t WorkloadGenerator::nextZipf() {
+	double u = nextUnit();
+	double uz = u * zipf_zetan;
+	if (uz < 1.0) {
+		return 0;
+	}
+	if (uz < 1.0 + pow(0.5, spec.zipf_theta)) {
+		return 1;
+	}
+	uint64_t rank = zipf_items * pow(zipf_eta * u - zipf_eta + 1.0, zipf_alpha);
+	return std::min(rank, zipf_items - 1);
+}
+
+void WorkloadGenerator::generate(TraceRecord& record) {
+	uint64_t working_set = spec.working_set;
+	uint64_t block_size = spec.block_size;
+	int core = 0;
+	bool write = false;
+	uint64_t block = 0;
+	uint64_t offset = 0;
+
+	switch (spec.pattern) {
+		case WorkloadPattern::Uniform:
+		{
+			// Private sets follow the shared one, which starts at block 0
+			core = step % spec.cores;
+			uint64_t base = (nextUnit() < spec.shared_ratio) ? 0 : (uint64_t) (core + 1) * working_set;
+			block = base + below(nextRandom(), working_set);
+			write = nextUnit() < write_ratio;
+			break;
+		}
+		case WorkloadPattern::ProducerConsumer:
+		{
+			// Each pair owns a slice of the working set; the producer writes a block and
+			// the consumer reads it right after, pairs taking turns
+			uint64_t pairs = std::max(1, spec.cores / 2);
+			uint64_t round = step >> 1;
+			uint64_t pair = round % pairs;
+			uint64_t slice = std::max<uint64_t>(1, working_set / pairs);
+			block = pair * slice + (round / pairs) % slice;
+			write = (step & 1) == 0;
+			core = write ? 2 * pair : (2 * pair + 1) % spec.cores;
+			break;
+		}
+		case WorkloadPattern::Migratory:
+		{
+			// A random core reads then writes every block of a random object, so objects
+			// keep moving from one cache to another
+			uint64_t position = step % (2 * MIGRATORY_OBJECT_BLOCKS);
+			if (position == 0) {
+				migratory_core = randomCore();
+				migratory_object = below(nextRandom(), std::max<uint64_t>(1, working_set / MIGRATORY_OBJECT_BLOCKS));
+			}
+			core = migratory_core;
+			block = migratory_object * MIGRATORY_OBJECT_BLOCKS + position / 2;
+			write = (position & 1) == 1;
+			break;
+		}
+		case WorkloadPattern::FalseSharing:
+		{
+			// Arrays of per-core 8-byte counters: the cores never share data, but up to
+			// block_size / 8 of them share every block
+			uint64_t words = std::max<uint64_t>(1, block_size / 8);
+			uint64_t array_blocks = (spec.cores + words - 1) / words;
+			uint64_t arrays = std::max<uint64_t>(1, working_set / array_blocks);
+			core = randomCore();
+			block = below(nextRandom(), arrays) * array_blocks + (uint64_t) core * 8 / block_size;
+			offset = (uint64_t) core * 8 % block_size;
+			write = nextUnit() < write_ratio;
+			break;
+		}
+		case WorkloadPattern::ReadMostly:
+			core = randomCore();
+			block = below(nextRandom(), working_set);
+			write = nextUnit() < write_ratio;
+			break;
+		case WorkloadPattern::Streaming:
+		{
+			// Cores take turns, each moving on to the next block of its own region
+			core = step % spec.cores;
+			uint64_t region_blocks = (1ULL << STREAM_REGION_BITS) / block_size;
+			block = (uint64_t) (core + 1) * region_blocks + stream_position[core]++ % region_blocks;
+			write = nextUnit() < write_ratio;
+			break;
+		}
+		case WorkloadPattern::Zipfian:
+		{
+			// Ranks are scattered over the working set so the hot blocks do not all map to the first sets
+			core = randomCore();
+			uint64_t rank = nextZipf();
+			block = below(rank * 0x9e3779b97f4a7c15ULL + 0x632be59bd9b4e019ULL, working_set);
+			write = nextUnit() < write_ratio;
+			break;
+		}
+	}
+
+	record.core = core;
+	record.op = write ? ProcRequest::ProcWr : ProcRequest::ProcRd;
+	record.address = block * block_size + offset;
+	step++;
+}
+
+size_t WorkloadGenerator::fill(TraceRecord* records, size_t max_records) {
+	uint64_t remaining = spec.accesses - generated;
+	size_t count = (remaining < max_records) ? remaining : max_records;
+	for (size_t i=0; i < count; i++) {
+		generate(records[i]);
+	}
+	generated += count;
+	return count;
+}
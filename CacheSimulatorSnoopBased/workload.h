@@ -0,0 +1,76 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "trace.h"
+
+typedef enum {
+	Uniform,          // private working set per core, plus a shared one used shared_ratio of the time
+	ProducerConsumer, // pairs of cores: one writes a buffer, the other reads it back
+	Migratory,        // objects read then written by one core at a time, moving between cores
+	FalseSharing,     // every core updates its own 8-byte word, packed into shared blocks
+	ReadMostly,       // all cores read a shared table that is rarely written
+	Streaming,        // every core sweeps sequentially through its own region, with no reuse
+	Zipfian           // all cores access a shared set with Zipf distributed popularity
+} WorkloadPattern;
+
+// Converts a pattern name ("uniform", "producer-consumer", ...) to the WorkloadPattern value
+// Returns false if the name is not a known pattern
+bool patternFromName(const std::string& name, WorkloadPattern& pattern);
+
+// Returns the name of the pattern
+const char* patternName(WorkloadPattern pattern);
+
+// Parameters of a synthetic workload; the same spec and seed always give the same accesses
+class WorkloadSpec {
+	public:
+		WorkloadPattern pattern;
+		uint64_t accesses;
+		uint64_t seed;
+		int cores;
+		int block_size;
+
+		// Blocks in the working set of the pattern (per core for the private sets)
+		uint64_t working_set;
+
+		// Fraction of writes; negative selects the default of the pattern
+		double write_ratio;
+
+		// Uniform: fraction of accesses that go to the shared working set
+		double shared_ratio;
+
+		// Zipfian: skew, between 0 (uniform) and 1 (exclusive)
+		double zipf_theta;
+
+		WorkloadSpec();
+};
+
+// Generates the accesses of a workload on the fly, so arbitrarily long runs need no trace
+class WorkloadGenerator {
+	public:
+		WorkloadGenerator(const WorkloadSpec& _spec);
+
+		// Fills up to max_records records with the next accesses
+		// Returns the number filled, 0 once all spec.accesses have been generated
+		size_t fill(TraceRecord* records, size_t max_records);
+
+	private:
+		WorkloadSpec spec;
+		double write_ratio;
+		uint64_t generated;
+		uint64_t rng;
+
+		// Pattern state
+		uint64_t step;
+		std::vector<uint64_t> stream_position;
+		int migratory_core;
+		uint64_t migratory_object;
+		uint64_t zipf_items;
+		double zipf_zetan, zipf_alpha, zipf_eta;
+
+		uint64_t nextRandom();
+		double nextUnit();
+		int randomCore();
+		uint64_t nextZipf();
+		void generate(TraceRecord& record);
+};